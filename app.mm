@@ -2,6 +2,7 @@
 #import "Cocoa/Cocoa.h"
 #include "window.h"
 #include <iostream>
+#include <utility>
 
 static NSAutoreleasePool *g_autoreleasepool = NULL;
 
@@ -26,8 +27,12 @@ static NSWindow *win;
     int width = w->width;
     int height = w->height;
     int bytesPerPixel = 4;
+    // The present thread swaps surfaces under this lock, surface is not
+    // written while it is drawn
+    std::lock_guard<std::mutex> lock(w->surface_mutex);
+    unsigned char *planes[1] = {w->surface};
     NSBitmapImageRep *rep = [[[NSBitmapImageRep alloc]
-            initWithBitmapDataPlanes:&w->surface
+            initWithBitmapDataPlanes:planes
                           pixelsWide:width
                           pixelsHigh:height
                        bitsPerSample:8
@@ -195,8 +200,21 @@ EventRecord Window::process_events() {
     return record;
 }
 
+void Window::swap_surfaces() {
+    std::lock_guard<std::mutex> lock(surface_mutex);
+    std::swap(surface, back_surface);
+    surface_changed = true;
+}
+
 void Window::present() {
-    [[win contentView] setNeedsDisplay:YES]; 
+    {
+        std::lock_guard<std::mutex> lock(surface_mutex);
+        if (!surface_changed) {
+            return;
+        }
+        surface_changed = false;
+    }
+    [[win contentView] setNeedsDisplay:YES];
 }
 
 void Window::reset_record() {
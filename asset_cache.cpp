@@ -0,0 +1,147 @@
+#include "asset_cache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+AssetCache &AssetCache::instance() {
+    static AssetCache cache;
+    return cache;
+}
+
+std::string AssetCache::path_key(const std::string &path) {
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    if (error) {
+        return path;
+    }
+    return canonical.string();
+}
+
+uint64_t AssetCache::hash(const void *data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string AssetCache::content_key(const void *data, size_t size) {
+    char key[64];
+    snprintf(key, sizeof(key), "content:%016llx:%zu", (unsigned long long)hash(data, size), size);
+    return key;
+}
+
+template <typename T>
+std::shared_ptr<const T> AssetCache::get(std::unordered_map<std::string, Entry<T>> &entries,
+                                         const std::string &key,
+                                         const std::function<std::shared_ptr<const T>()> &load) {
+    std::promise<std::shared_ptr<const T>> promise;
+    std::shared_future<std::shared_ptr<const T>> cached;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            cached = it->second.asset;
+        } else {
+            Entry<T> entry;
+            entry.asset = promise.get_future().share();
+            entries[key] = entry;
+        }
+    }
+    if (cached.valid()) {
+        // Waits if another thread is still loading this key
+        return cached.get();
+    }
+    std::shared_ptr<const T> asset;
+    try {
+        asset = load();
+    } catch (...) {
+        // Waiters rethrow too, and the next request for key loads again
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(key);
+            if (it != entries.end() && it->second.asset.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                entries.erase(it);
+            }
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            it->second.bytes = (asset != nullptr) ? asset->memory_size() : 0;
+            bytes += it->second.bytes;
+        }
+    }
+    promise.set_value(asset);
+    return asset;
+}
+
+std::shared_ptr<const Image> AssetCache::get_image(const std::string &key,
+                                                   const std::function<std::shared_ptr<const Image>()> &load) {
+    return get(images, key, load);
+}
+
+std::shared_ptr<const Mesh> AssetCache::get_mesh(const std::string &key,
+                                                 const std::function<std::shared_ptr<const Mesh>()> &load) {
+    return get(meshes, key, load);
+}
+
+void AssetCache::evict(const std::string &key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto image = images.find(key);
+    if (image != images.end()) {
+        bytes -= image->second.bytes;
+        images.erase(image);
+    }
+    auto mesh = meshes.find(key);
+    if (mesh != meshes.end()) {
+        bytes -= mesh->second.bytes;
+        meshes.erase(mesh);
+    }
+}
+
+template <typename T>
+size_t AssetCache::evict_unused(std::unordered_map<std::string, Entry<T>> &entries) {
+    size_t freed = 0;
+    for (auto it = entries.begin(); it != entries.end();) {
+        const auto &asset = it->second.asset;
+        bool loaded = asset.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        if (loaded && asset.get().use_count() == 1) {
+            freed += it->second.bytes;
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return freed;
+}
+
+size_t AssetCache::evict_unused() {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t freed = evict_unused(images) + evict_unused(meshes);
+    bytes -= freed;
+    return freed;
+}
+
+void AssetCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    images.clear();
+    meshes.clear();
+    bytes = 0;
+}
+
+size_t AssetCache::memory_usage() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytes;
+}
+
+size_t AssetCache::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return images.size() + meshes.size();
+}
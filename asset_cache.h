@@ -0,0 +1,65 @@
+#pragma once
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "mesh.h"
+#include "texture.h"
+
+// Process-wide cache of decoded, immutable assets. Assets are keyed by the
+// canonical path of the file they came from (plus a suffix for sub-assets
+// such as a glTF mesh) or by a hash of their bytes for embedded data, so
+// loading the same asset twice, from the same or another scene, is free.
+class AssetCache {
+    public:
+    static AssetCache &instance();
+
+    // Key for a file on disk, independent of how the path was spelled
+    static std::string path_key(const std::string &path);
+    // Key for data that is not backed by its own file (data URIs, GLB chunks)
+    static std::string content_key(const void *data, size_t size);
+    // 64 bit FNV-1a hash
+    static uint64_t hash(const void *data, size_t size);
+
+    // Returns the asset for key, calling load to create it on a miss.
+    // Concurrent requests for the same key wait for a single load. If load
+    // throws, the exception reaches every waiting caller and nothing is cached.
+    std::shared_ptr<const Image> get_image(const std::string &key,
+                                           const std::function<std::shared_ptr<const Image>()> &load);
+    std::shared_ptr<const Mesh> get_mesh(const std::string &key,
+                                         const std::function<std::shared_ptr<const Mesh>()> &load);
+
+    // Drop a single entry. Scenes still using the asset keep it alive.
+    void evict(const std::string &key);
+    // Drop every entry that nothing but the cache references, returns the
+    // number of bytes released
+    size_t evict_unused();
+    void clear();
+
+    // Bytes of decoded data held by the cache
+    size_t memory_usage();
+    // Number of cached assets
+    size_t size();
+
+    private:
+    AssetCache() = default;
+    template <typename T>
+    struct Entry {
+        std::shared_future<std::shared_ptr<const T>> asset;
+        size_t bytes = 0;
+    };
+    template <typename T>
+    std::shared_ptr<const T> get(std::unordered_map<std::string, Entry<T>> &entries, const std::string &key,
+                                 const std::function<std::shared_ptr<const T>()> &load);
+    template <typename T>
+    size_t evict_unused(std::unordered_map<std::string, Entry<T>> &entries);
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry<Image>> images;
+    std::unordered_map<std::string, Entry<Mesh>> meshes;
+    size_t bytes = 0;
+};
@@ -0,0 +1 @@
+clang++ -std=c++17 -O2 -pthread -I.. gltf_parse_bench.cpp ../gltf.cpp ../texture.cpp ../block_compression.cpp ../data_types.cpp ../mapped_file.cpp -o gltf_parse_bench
@@ -0,0 +1,116 @@
+// Compares the two ways of reading glTF JSON on every .gltf file under a
+// directory (by default the bundled sample models): json::parse followed by
+// ParseGltfDocument on the DOM, and the SAX parse that fills GltfDocument
+// directly. Reports time and peak heap usage of each.
+//
+// usage: gltf_parse_bench [dir] [repeats]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "gltf.h"
+#include "mapped_file.h"
+
+// Heap accounting: every allocation carries its size in a header
+static size_t heap_bytes = 0;
+static size_t heap_peak = 0;
+static const size_t HEADER = alignof(std::max_align_t);
+
+void *operator new(size_t size) {
+    char *ptr = static_cast<char *>(malloc(size + HEADER));
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    *reinterpret_cast<size_t *>(ptr) = size;
+    heap_bytes += size;
+    heap_peak = std::max(heap_peak, heap_bytes);
+    return ptr + HEADER;
+}
+
+void operator delete(void *p) noexcept {
+    if (p == nullptr) {
+        return;
+    }
+    char *ptr = static_cast<char *>(p) - HEADER;
+    heap_bytes -= *reinterpret_cast<size_t *>(ptr);
+    free(ptr);
+}
+
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+
+struct Result {
+    double ms = 0;
+    size_t peak = 0;
+    size_t elements = 0;
+};
+
+static size_t NumElements(const GltfDocument &doc) {
+    return doc.buffers.size() + doc.buffer_views.size() + doc.accessors.size() + doc.images.size() +
+           doc.samplers.size() + doc.textures.size() + doc.materials.size() + doc.meshes.size() +
+           doc.nodes.size() + doc.scenes.size();
+}
+
+template <typename F>
+static Result Measure(F parse, int repeats) {
+    Result result;
+    size_t base = heap_bytes;
+    heap_peak = heap_bytes;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < repeats; i++) {
+        GltfDocument doc = parse();
+        result.elements = NumElements(doc);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    result.ms = std::chrono::duration<double, std::milli>(end - start).count()/repeats;
+    result.peak = heap_peak - base;
+    return result;
+}
+
+int main(int argc, char **argv) {
+    std::string dir = (argc > 1) ? argv[1] : "../glTF-Sample-Models/2.0";
+    int repeats = (argc > 2) ? atoi(argv[2]) : 5;
+
+    std::vector<std::string> paths;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(dir)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".gltf") {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    Result dom_total, sax_total;
+    size_t total_size = 0;
+    std::cout << "file, size KB, dom ms, sax ms, dom peak KB, sax peak KB\n";
+    for (const std::string &path : paths) {
+        std::shared_ptr<MappedFile> file = MappedFile::open(path);
+        if (file == nullptr) {
+            std::cerr << "Unable to open " << path << "\n";
+            exit(-1);
+        }
+        const unsigned char *data = file->data();
+        size_t size = file->size();
+        Result dom = Measure([&]() { return ParseGltfDocument(json::parse(data, data + size)); }, repeats);
+        Result sax = Measure([&]() { return ParseGltfDocument(data, size); }, repeats);
+        if (dom.elements != sax.elements) {
+            std::cerr << path << ": DOM and SAX parse disagree\n";
+            exit(-1);
+        }
+        std::cout << path << ", " << size/1024 << ", " << dom.ms << ", " << sax.ms << ", "
+                  << dom.peak/1024 << ", " << sax.peak/1024 << "\n";
+        total_size += size;
+        dom_total.ms += dom.ms;
+        sax_total.ms += sax.ms;
+        dom_total.peak = std::max(dom_total.peak, dom.peak);
+        sax_total.peak = std::max(sax_total.peak, sax.peak);
+    }
+    std::cout << "\n" << paths.size() << " files, " << total_size/1024 << " KB of JSON\n";
+    std::cout << "dom: " << dom_total.ms << " ms total, " << dom_total.peak/1024 << " KB largest peak\n";
+    std::cout << "sax: " << sax_total.ms << " ms total, " << sax_total.peak/1024 << " KB largest peak\n";
+    return 0;
+}
@@ -0,0 +1,239 @@
+#include "block_compression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static uint16_t pack_565(float r, float g, float b) {
+    int r5 = std::clamp(int(r*31.0f/255.0f + 0.5f), 0, 31);
+    int g6 = std::clamp(int(g*63.0f/255.0f + 0.5f), 0, 63);
+    int b5 = std::clamp(int(b*31.0f/255.0f + 0.5f), 0, 31);
+    return uint16_t((r5 << 11) | (g6 << 5) | b5);
+}
+
+static RGBA8 unpack_565(uint16_t c) {
+    int r = (c >> 11) & 31;
+    int g = (c >> 5) & 63;
+    int b = c & 31;
+    return RGBA8{uint8_t((r << 3) | (r >> 2)), uint8_t((g << 2) | (g >> 4)), uint8_t((b << 3) | (b >> 2)), 255};
+}
+
+// Four color palette of a block with color0 > color1
+static void color_palette(uint16_t c0, uint16_t c1, RGBA8 palette[4]) {
+    palette[0] = unpack_565(c0);
+    palette[1] = unpack_565(c1);
+    palette[2] = RGBA8{uint8_t((2*palette[0].r + palette[1].r)/3), uint8_t((2*palette[0].g + palette[1].g)/3),
+                       uint8_t((2*palette[0].b + palette[1].b)/3), 255};
+    palette[3] = RGBA8{uint8_t((palette[0].r + 2*palette[1].r)/3), uint8_t((palette[0].g + 2*palette[1].g)/3),
+                       uint8_t((palette[0].b + 2*palette[1].b)/3), 255};
+}
+
+// Encodes the color part of a block, always in four color mode
+static void encode_color(const RGBA8 tile[16], uint8_t block[8]) {
+    // Endpoints are the extremes of the colors projected on their principal
+    // axis, found with a few power iterations on the covariance matrix
+    float mean[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+        mean[0] += tile[i].r;
+        mean[1] += tile[i].g;
+        mean[2] += tile[i].b;
+    }
+    for (float &m : mean) {
+        m /= 16;
+    }
+    float cov[6] = {0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+        float r = tile[i].r - mean[0];
+        float g = tile[i].g - mean[1];
+        float b = tile[i].b - mean[2];
+        cov[0] += r*r; cov[1] += r*g; cov[2] += r*b;
+        cov[3] += g*g; cov[4] += g*b; cov[5] += b*b;
+    }
+    float axis[3] = {1, 1, 1};
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float x = cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2];
+        float y = cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2];
+        float z = cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2];
+        float length = std::max({std::fabs(x), std::fabs(y), std::fabs(z)});
+        if (length == 0) {
+            break;
+        }
+        axis[0] = x/length;
+        axis[1] = y/length;
+        axis[2] = z/length;
+    }
+    float min_t = INFINITY;
+    float max_t = -INFINITY;
+    for (int i = 0; i < 16; i++) {
+        float t = (tile[i].r - mean[0])*axis[0] + (tile[i].g - mean[1])*axis[1] + (tile[i].b - mean[2])*axis[2];
+        min_t = std::min(min_t, t);
+        max_t = std::max(max_t, t);
+    }
+    float norm2 = axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2];
+    if (norm2 > 0) {
+        min_t /= norm2;
+        max_t /= norm2;
+    }
+    // Inset the endpoints slightly, the extremes are rarely worth a palette entry
+    float inset = (max_t - min_t)/16;
+    min_t += inset;
+    max_t -= inset;
+    uint16_t c0 = pack_565(mean[0] + max_t*axis[0], mean[1] + max_t*axis[1], mean[2] + max_t*axis[2]);
+    uint16_t c1 = pack_565(mean[0] + min_t*axis[0], mean[1] + min_t*axis[1], mean[2] + min_t*axis[2]);
+    if (c0 < c1) {
+        std::swap(c0, c1);
+    }
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        RGBA8 palette[4];
+        color_palette(c0, c1, palette);
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            int best_error = INT32_MAX;
+            for (int p = 0; p < 4; p++) {
+                int dr = tile[i].r - palette[p].r;
+                int dg = tile[i].g - palette[p].g;
+                int db = tile[i].b - palette[p].b;
+                int error = dr*dr + dg*dg + db*db;
+                if (error < best_error) {
+                    best = p;
+                    best_error = error;
+                }
+            }
+            indices |= uint32_t(best) << (2*i);
+        }
+    }
+    memcpy(block, &c0, 2);
+    memcpy(block + 2, &c1, 2);
+    memcpy(block + 4, &indices, 4);
+}
+
+static void decode_color(const uint8_t block[8], RGBA8 tile[16]) {
+    uint16_t c0, c1;
+    uint32_t indices;
+    memcpy(&c0, block, 2);
+    memcpy(&c1, block + 2, 2);
+    memcpy(&indices, block + 4, 4);
+    RGBA8 palette[4];
+    color_palette(c0, c1, palette);
+    if (c0 <= c1) {
+        // Three color mode, only written by other encoders
+        palette[2] = RGBA8{uint8_t((palette[0].r + palette[1].r)/2), uint8_t((palette[0].g + palette[1].g)/2),
+                           uint8_t((palette[0].b + palette[1].b)/2), 255};
+        palette[3] = RGBA8{0, 0, 0, 0};
+    }
+    for (int i = 0; i < 16; i++) {
+        tile[i] = palette[(indices >> (2*i)) & 3];
+    }
+}
+
+static void alpha_palette(uint8_t a0, uint8_t a1, uint8_t palette[8]) {
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1) {
+        for (int i = 1; i < 7; i++) {
+            palette[i + 1] = uint8_t(((7 - i)*a0 + i*a1 + 3)/7);
+        }
+    } else {
+        for (int i = 1; i < 5; i++) {
+            palette[i + 1] = uint8_t(((5 - i)*a0 + i*a1 + 2)/5);
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+void EncodeBC1Block(const RGBA8 tile[16], uint8_t block[8]) {
+    encode_color(tile, block);
+}
+
+void EncodeBC3Block(const RGBA8 tile[16], uint8_t block[16]) {
+    uint8_t a0 = 0;
+    uint8_t a1 = 255;
+    for (int i = 0; i < 16; i++) {
+        a0 = std::max(a0, tile[i].a);
+        a1 = std::min(a1, tile[i].a);
+    }
+    uint64_t indices = 0;
+    if (a0 != a1) {
+        uint8_t palette[8];
+        alpha_palette(a0, a1, palette);
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            for (int p = 1; p < 8; p++) {
+                if (std::abs(tile[i].a - palette[p]) < std::abs(tile[i].a - palette[best])) {
+                    best = p;
+                }
+            }
+            indices |= uint64_t(best) << (3*i);
+        }
+    }
+    block[0] = a0;
+    block[1] = a1;
+    for (int i = 0; i < 6; i++) {
+        block[2 + i] = uint8_t(indices >> (8*i));
+    }
+    encode_color(tile, block + 8);
+}
+
+void DecodeBC1Block(const uint8_t block[8], RGBA8 tile[16]) {
+    decode_color(block, tile);
+}
+
+void DecodeBC3Block(const uint8_t block[16], RGBA8 tile[16]) {
+    decode_color(block + 8, tile);
+    uint8_t palette[8];
+    alpha_palette(block[0], block[1], palette);
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++) {
+        indices |= uint64_t(block[2 + i]) << (8*i);
+    }
+    for (int i = 0; i < 16; i++) {
+        tile[i].a = palette[(indices >> (3*i)) & 7];
+    }
+}
+
+TexelFormat ChooseBlockFormat(const MipLevel &level) {
+    for (unsigned int y = 0; y < level.height; y++) {
+        for (unsigned int x = 0; x < level.width; x++) {
+            if (level.at(x, y).a != 255) {
+                return TexelFormat::BC3;
+            }
+        }
+    }
+    return TexelFormat::BC1;
+}
+
+MipLevel CompressLevel(const MipLevel &level, TexelFormat format) {
+    MipLevel compressed(level.width, level.height, format);
+    size_t block_size = MipLevel::block_size(format);
+    const unsigned int tile_texels = MipLevel::TILE_SIZE*MipLevel::TILE_SIZE;
+    for (size_t tile = 0; tile < level.num_tiles(); tile++) {
+        // Replicate edge texels into the padding so it doesn't pull the
+        // endpoints of partial tiles towards black
+        RGBA8 texels[16];
+        unsigned int tile_x = (tile % level.tiles_x)*MipLevel::TILE_SIZE;
+        unsigned int tile_y = (tile/level.tiles_x)*MipLevel::TILE_SIZE;
+        for (unsigned int i = 0; i < tile_texels; i++) {
+            unsigned int x = std::min(tile_x + i % MipLevel::TILE_SIZE, level.width - 1);
+            unsigned int y = std::min(tile_y + i/MipLevel::TILE_SIZE, level.height - 1);
+            texels[i] = level.at(x, y);
+        }
+        uint8_t *block = compressed.blocks.get() + tile*block_size;
+        if (format == TexelFormat::BC1) {
+            EncodeBC1Block(texels, block);
+        } else {
+            EncodeBC3Block(texels, block);
+        }
+    }
+    return compressed;
+}
+
+void DecodeTile(const MipLevel &level, size_t tile, RGBA8 texels[16]) {
+    const uint8_t *block = level.blocks.get() + tile*MipLevel::block_size(level.format);
+    if (level.format == TexelFormat::BC1) {
+        DecodeBC1Block(block, texels);
+    } else {
+        DecodeBC3Block(block, texels);
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+#include "texture.h"
+
+// BC1 (DXT1) and BC3 (DXT5) block encoding and decoding. A block holds one
+// 4x4 tile, texels in the same row-major order as a MipLevel tile.
+// https://learn.microsoft.com/en-us/windows/win32/direct3d10/d3d10-graphics-programming-guide-resources-block-compression
+
+void EncodeBC1Block(const RGBA8 tile[16], uint8_t block[8]);
+void EncodeBC3Block(const RGBA8 tile[16], uint8_t block[16]);
+void DecodeBC1Block(const uint8_t block[8], RGBA8 tile[16]);
+void DecodeBC3Block(const uint8_t block[16], RGBA8 tile[16]);
+
+// BC1 if every texel of level is opaque, BC3 otherwise
+TexelFormat ChooseBlockFormat(const MipLevel &level);
+// Encodes an RGBA8 level into format. Blocks are encoded in the stored
+// (possibly sRGB) encoding, so sampling decodes them like RGBA8 texels.
+MipLevel CompressLevel(const MipLevel &level, TexelFormat format);
+// Decodes the tile of a compressed level into 16 texels
+void DecodeTile(const MipLevel &level, size_t tile, RGBA8 texels[16]);
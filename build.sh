@@ -1 +1 @@
-clang++ -std=c++17 -g -framework Cocoa *.cpp app.mm -o basoon
+clang++ -std=c++17 -g -pthread -framework Cocoa *.cpp app.mm -o basoon
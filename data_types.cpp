@@ -178,6 +178,16 @@ float4x4 rotationMatrix() {
     return identity();
 }
 
+float4x4 rotationMatrix(const float4 &q) {
+    float xx = q.x*q.x, yy = q.y*q.y, zz = q.z*q.z;
+    float xy = q.x*q.y, xz = q.x*q.z, yz = q.y*q.z;
+    float wx = q.w*q.x, wy = q.w*q.y, wz = q.w*q.z;
+    return float4x4(float4(1 - 2*(yy + zz), 2*(xy - wz), 2*(xz + wy), 0),
+                    float4(2*(xy + wz), 1 - 2*(xx + zz), 2*(yz - wx), 0),
+                    float4(2*(xz - wy), 2*(yz + wx), 1 - 2*(xx + yy), 0),
+                    float4(0, 0, 0, 1));
+}
+
 //https://docs.microsoft.com/en-us/windows/win32/direct3d9/projection-transform#a-w-friendly-projection-matrix
 // Page 92 - Real-time rendering
 float4x4 perspectiveProjectionMatrix(const float near_plane, const float far_plane,
@@ -82,6 +82,8 @@ float4x4 identity();
 float4x4 translationMatrix(float x, float y, float z);
 float4x4 scalingMatrix(float x, float y, float z);
 float4x4 rotationMatrix();
+// Rotation by a unit quaternion (x, y, z, w)
+float4x4 rotationMatrix(const float4 &q);
 
 
 float4x4 perspectiveProjectionMatrix(const float near_plane, const float far_plane,
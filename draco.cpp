@@ -0,0 +1,50 @@
+#include "draco.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "draco_decoder.h"
+
+// Values of the Draco attribute mapped to semantic name, N floats per point
+template <typename T, int N>
+static bool ReadAttribute(const DracoMesh &draco_mesh, const GltfPrimitive &primitive, const char *name,
+                          std::vector<T> &values) {
+    auto it = primitive.draco_attributes.find(name);
+    if (it == primitive.draco_attributes.end()) {
+        return false;
+    }
+    const DracoAttribute *attribute = draco_mesh.attribute(it->second);
+    if (attribute == nullptr || attribute->num_components < N) {
+        return false;
+    }
+    values.resize(draco_mesh.num_points);
+    for (size_t i = 0; i < draco_mesh.num_points; i++) {
+        memcpy(&values[i], &attribute->values[i*attribute->num_components], sizeof(T));
+    }
+    return true;
+}
+
+std::shared_ptr<Mesh> DecodeDracoPrimitive(const BufferData &compressed, const GltfPrimitive &primitive) {
+    DracoMesh draco_mesh;
+    if (!DecodeDraco(compressed.data, compressed.size, draco_mesh)) {
+        std::cerr << "Unable to decode Draco mesh\n";
+        return nullptr;
+    }
+
+    std::vector<float3> positions;
+    if (!ReadAttribute<float3, 3>(draco_mesh, primitive, "POSITION", positions)) {
+        std::cerr << "Draco mesh has no positions\n";
+        return nullptr;
+    }
+    int num_triangles = int(draco_mesh.faces.size()/3);
+    auto mesh = std::make_shared<Mesh>(num_triangles, positions);
+    ReadAttribute<float3, 3>(draco_mesh, primitive, "NORMAL", mesh->normals);
+    ReadAttribute<float2, 2>(draco_mesh, primitive, "TEXCOORD_0", mesh->texcoords);
+
+    if (draco_mesh.num_points <= UINT16_MAX + 1) {
+        mesh->indices.assign(draco_mesh.faces.begin(), draco_mesh.faces.end());
+    } else {
+        mesh->indices32 = std::move(draco_mesh.faces);
+    }
+    return mesh;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <memory>
+
+#include "gltf_buffer.h"
+#include "mesh.h"
+
+// KHR_draco_mesh_compression, decoded with the bundled decoder in
+// draco_decoder.cpp.
+// https://github.com/KhronosGroup/glTF/tree/main/extensions/2.0/Khronos/KHR_draco_mesh_compression
+
+// Decode the mesh of a Draco compressed primitive from the bytes of its
+// compressed bufferView. Attributes are dequantized into the float vectors
+// of the mesh. Returns nullptr, after reporting why, if it can't be decoded.
+// Safe to call from any thread.
+std::shared_ptr<Mesh> DecodeDracoPrimitive(const BufferData &compressed, const GltfPrimitive &primitive);
@@ -0,0 +1,2410 @@
+#include "draco_decoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+
+// Bitstream layout and entropy coders follow the Draco reference decoder,
+// only the 2.2 bitstream is read
+
+// Reads little-endian values from a byte range. Any read past the end sets
+// failed and returns zero, so callers check failed once after a block.
+struct Buffer {
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+    size_t pos = 0;
+    bool failed = false;
+    // Least significant bit first bit reading, see start_bits
+    size_t bit_pos = 0;
+
+    Buffer() = default;
+    Buffer(const unsigned char *data, size_t size) : data(data), size(size) {}
+
+    size_t remaining() const {
+        return size - pos;
+    }
+
+    const unsigned char *head() const {
+        return data + pos;
+    }
+
+    bool advance(size_t bytes) {
+        if (bytes > remaining()) {
+            failed = true;
+            return false;
+        }
+        pos += bytes;
+        return true;
+    }
+
+    template <typename T>
+    T read() {
+        T value = 0;
+        if (sizeof(T) > remaining()) {
+            failed = true;
+            return value;
+        }
+        memcpy(&value, head(), sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    uint64_t read_varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            unsigned char byte = read<unsigned char>();
+            if (failed) {
+                return 0;
+            }
+            value |= uint64_t(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        failed = true;
+        return 0;
+    }
+
+    // Bits are read from the current position until end_bits, which skips
+    // the whole bytes they were read from
+    void start_bits() {
+        bit_pos = 0;
+    }
+
+    uint32_t read_bits(int count) {
+        uint32_t value = 0;
+        for (int i = 0; i < count; i++) {
+            // Like the reference decoder, bits past the end read as zero
+            size_t byte = pos + (bit_pos >> 3);
+            if (byte < size) {
+                value |= uint32_t((data[byte] >> (bit_pos & 7)) & 1) << i;
+            }
+            bit_pos++;
+        }
+        return value;
+    }
+
+    void end_bits() {
+        pos = std::min(size, pos + (bit_pos + 7)/8);
+        bit_pos = 0;
+    }
+};
+
+static const uint32_t ANS_IO_BASE = 256;
+
+// Reads the state stored at the end of size bytes of rANS data. Returns false
+// if the state is malformed.
+static bool AnsReadInit(const unsigned char *data, size_t size, uint32_t l_base, size_t &offset, uint32_t &state) {
+    if (size < 1) {
+        return false;
+    }
+    int x = data[size - 1] >> 6;
+    size_t bytes = x + 1;
+    if (bytes > size) {
+        return false;
+    }
+    offset = size - bytes;
+    state = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        state |= uint32_t(data[offset + i]) << (8*i);
+    }
+    state &= (1u << (8*bytes - 2)) - 1;
+    state += l_base;
+    return state < l_base*ANS_IO_BASE;
+}
+
+// Binary rANS decoder with a fixed probability of zero, 8 bits of precision
+class BitDecoder {
+    public:
+    bool start(Buffer &buffer) {
+        prob_zero = buffer.read<unsigned char>();
+        size_t bytes = buffer.read_varint();
+        if (buffer.failed || bytes > buffer.remaining()) {
+            return false;
+        }
+        data = buffer.head();
+        buffer.advance(bytes);
+        // Bit decoders store at most a 3 byte state
+        if (bytes > 0 && (data[bytes - 1] >> 6) == 3) {
+            return false;
+        }
+        return AnsReadInit(data, bytes, L_BASE, offset, state);
+    }
+
+    bool next() {
+        if (state < L_BASE && offset > 0) {
+            state = state*ANS_IO_BASE + data[--offset];
+        }
+        // Ones take the first 256 - prob_zero slots of each 256
+        uint32_t p = 256 - prob_zero;
+        uint32_t quotient = state/256;
+        uint32_t remainder = state % 256;
+        bool bit = remainder < p;
+        state = bit ? quotient*p + remainder : state - quotient*p - p;
+        return bit;
+    }
+
+    private:
+    static const uint32_t L_BASE = 4096;
+    const unsigned char *data = nullptr;
+    size_t offset = 0;
+    uint32_t state = 0;
+    unsigned char prob_zero = 0;
+};
+
+// rANS decoder for symbols with a table of probabilities summing to
+// 1 << precision_bits
+class SymbolDecoder {
+    public:
+    // Reads the probability table, then the encoded symbols
+    bool start(Buffer &buffer, int max_bit_length) {
+        int unclamped = (3*max_bit_length)/2;
+        precision_bits = std::min(std::max(unclamped, 12), 20);
+        uint32_t precision = 1u << precision_bits;
+        uint64_t num_symbols = buffer.read_varint();
+        if (buffer.failed || num_symbols == 0 || num_symbols > buffer.remaining()*64 + 64) {
+            return false;
+        }
+        probabilities.assign(num_symbols, 0);
+        for (size_t i = 0; i < num_symbols; i++) {
+            unsigned char prob_data = buffer.read<unsigned char>();
+            int token = prob_data & 3;
+            if (token == 3) {
+                // Run of zero probabilities
+                size_t run = prob_data >> 2;
+                if (i + run >= num_symbols) {
+                    return false;
+                }
+                i += run;
+            } else {
+                uint32_t prob = prob_data >> 2;
+                for (int b = 0; b < token; b++) {
+                    prob |= uint32_t(buffer.read<unsigned char>()) << (8*(b + 1) - 2);
+                }
+                probabilities[i] = prob;
+            }
+        }
+        if (buffer.failed) {
+            return false;
+        }
+        cumulative.resize(num_symbols);
+        lookup.resize(precision);
+        uint32_t sum = 0;
+        for (size_t i = 0; i < num_symbols; i++) {
+            cumulative[i] = sum;
+            if (probabilities[i] > precision - sum) {
+                return false;
+            }
+            std::fill(lookup.begin() + sum, lookup.begin() + sum + probabilities[i], uint32_t(i));
+            sum += probabilities[i];
+        }
+        if (sum != precision) {
+            return false;
+        }
+
+        uint64_t bytes = buffer.read_varint();
+        if (buffer.failed || bytes > buffer.remaining()) {
+            return false;
+        }
+        data = buffer.head();
+        buffer.advance(bytes);
+        return AnsReadInit(data, bytes, 4*precision, offset, state);
+    }
+
+    uint32_t next() {
+        uint32_t l_base = 4u << precision_bits;
+        while (state < l_base && offset > 0) {
+            state = state*ANS_IO_BASE + data[--offset];
+        }
+        uint32_t quotient = state >> precision_bits;
+        uint32_t remainder = state & ((1u << precision_bits) - 1);
+        uint32_t symbol = lookup[remainder];
+        state = quotient*probabilities[symbol] + remainder - cumulative[symbol];
+        return symbol;
+    }
+
+    private:
+    int precision_bits = 12;
+    std::vector<uint32_t> probabilities;
+    std::vector<uint32_t> cumulative;
+    std::vector<uint32_t> lookup;
+    const unsigned char *data = nullptr;
+    size_t offset = 0;
+    uint32_t state = 0;
+};
+
+static const int SYMBOL_CODING_TAGGED = 0;
+static const int SYMBOL_CODING_RAW = 1;
+
+// Decodes count unsigned symbols written by Draco's EncodeSymbols, components
+// values at a time
+static bool DecodeSymbols(Buffer &buffer, size_t count, int components, uint32_t *out) {
+    if (count == 0) {
+        return true;
+    }
+    int scheme = buffer.read<unsigned char>();
+    if (scheme == SYMBOL_CODING_TAGGED) {
+        // Each group of components stores its bit length as a symbol, the
+        // values follow as raw bits
+        SymbolDecoder tags;
+        if (components <= 0 || !tags.start(buffer, 5)) {
+            return false;
+        }
+        buffer.start_bits();
+        for (size_t i = 0; i < count; i += components) {
+            int bit_length = tags.next();
+            if (bit_length > 32) {
+                return false;
+            }
+            for (int c = 0; c < components && i + c < count; c++) {
+                out[i + c] = buffer.read_bits(bit_length);
+            }
+        }
+        buffer.end_bits();
+        return !buffer.failed;
+    } else if (scheme == SYMBOL_CODING_RAW) {
+        int max_bit_length = buffer.read<unsigned char>();
+        SymbolDecoder symbols;
+        if (max_bit_length < 1 || max_bit_length > 18 || !symbols.start(buffer, max_bit_length)) {
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            out[i] = symbols.next();
+        }
+        return true;
+    }
+    return false;
+}
+
+static int32_t SymbolToSigned(uint32_t symbol) {
+    if ((symbol & 1) == 0) {
+        return int32_t(symbol >> 1);
+    }
+    return -int32_t(symbol >> 1) - 1;
+}
+
+static const uint32_t INVALID = 0xffffffff;
+
+// Triangle connectivity as corners, three per face. Attributes with seams get
+// their own table where edges on a seam have no opposite corner.
+struct CornerTable {
+    std::vector<uint32_t> corner_vertex;
+    std::vector<uint32_t> opposite_corner;
+    // A corner of each vertex, the first one counter-clockwise if the vertex
+    // is on a boundary
+    std::vector<uint32_t> vertex_corner;
+
+    void reset(size_t num_faces) {
+        corner_vertex.assign(num_faces*3, INVALID);
+        opposite_corner.assign(num_faces*3, INVALID);
+        vertex_corner.clear();
+    }
+
+    size_t num_corners() const {
+        return corner_vertex.size();
+    }
+
+    size_t num_faces() const {
+        return corner_vertex.size()/3;
+    }
+
+    size_t num_vertices() const {
+        return vertex_corner.size();
+    }
+
+    uint32_t add_vertex() {
+        vertex_corner.push_back(INVALID);
+        return uint32_t(vertex_corner.size() - 1);
+    }
+
+    static uint32_t next(uint32_t c) {
+        if (c == INVALID) {
+            return INVALID;
+        }
+        return (c % 3 == 2) ? c - 2 : c + 1;
+    }
+
+    static uint32_t previous(uint32_t c) {
+        if (c == INVALID) {
+            return INVALID;
+        }
+        return (c % 3 == 0) ? c + 2 : c - 1;
+    }
+
+    uint32_t opposite(uint32_t c) const {
+        return (c == INVALID) ? INVALID : opposite_corner[c];
+    }
+
+    uint32_t vertex(uint32_t c) const {
+        return (c == INVALID) ? INVALID : corner_vertex[c];
+    }
+
+    uint32_t left_most(uint32_t v) const {
+        return (v < vertex_corner.size()) ? vertex_corner[v] : INVALID;
+    }
+
+    uint32_t swing_left(uint32_t c) const {
+        return next(opposite(next(c)));
+    }
+
+    uint32_t swing_right(uint32_t c) const {
+        return previous(opposite(previous(c)));
+    }
+
+    uint32_t left_corner(uint32_t c) const {
+        return opposite(previous(c));
+    }
+
+    uint32_t right_corner(uint32_t c) const {
+        return opposite(next(c));
+    }
+
+    bool on_boundary(uint32_t v) const {
+        uint32_t c = left_most(v);
+        return c == INVALID || swing_left(c) == INVALID;
+    }
+
+    void set_opposite(uint32_t a, uint32_t b) {
+        opposite_corner[a] = b;
+        opposite_corner[b] = a;
+    }
+};
+
+// Order in which an attribute's values were encoded
+struct EncodingData {
+    // Corner each value was first reached from
+    std::vector<uint32_t> value_corner;
+    // Index of the value of each vertex of the corner table the values were
+    // traversed on
+    std::vector<uint32_t> vertex_value;
+};
+
+// Connectivity of one attribute that has seams, for example texture
+// coordinates split along UV islands
+struct AttributeConnectivity {
+    CornerTable table;
+    std::vector<bool> edge_on_seam;
+    std::vector<bool> vertex_on_seam;
+    std::vector<uint32_t> seam_corners;
+    int decoder_id = -1;
+    // False if the attribute's values are traversed on the position
+    // connectivity instead
+    bool used = true;
+    EncodingData encoding;
+
+    void add_seam(const CornerTable &base, uint32_t c) {
+        edge_on_seam[c] = true;
+        vertex_on_seam[base.vertex(CornerTable::next(c))] = true;
+        vertex_on_seam[base.vertex(CornerTable::previous(c))] = true;
+        uint32_t opposite = base.opposite(c);
+        if (opposite != INVALID) {
+            edge_on_seam[opposite] = true;
+            vertex_on_seam[base.vertex(CornerTable::next(opposite))] = true;
+            vertex_on_seam[base.vertex(CornerTable::previous(opposite))] = true;
+        }
+    }
+
+    // Splits the vertices of base along the seams
+    bool build(const CornerTable &base) {
+        table.corner_vertex.assign(base.num_corners(), INVALID);
+        table.opposite_corner = base.opposite_corner;
+        for (size_t c = 0; c < base.num_corners(); c++) {
+            if (edge_on_seam[c]) {
+                table.opposite_corner[c] = INVALID;
+            }
+        }
+        table.vertex_corner.clear();
+        for (uint32_t v = 0; v < base.num_vertices(); v++) {
+            uint32_t c = base.left_most(v);
+            if (c == INVALID) {
+                continue;
+            }
+            uint32_t vertex = table.add_vertex();
+            uint32_t first = c;
+            if (vertex_on_seam[v]) {
+                // Start from the first seam counter-clockwise
+                uint32_t act = table.swing_left(first);
+                while (act != INVALID) {
+                    first = act;
+                    act = table.swing_left(act);
+                    if (act == c) {
+                        return false;
+                    }
+                }
+            }
+            table.corner_vertex[first] = vertex;
+            table.vertex_corner[vertex] = first;
+            uint32_t act = base.swing_right(first);
+            while (act != INVALID && act != first) {
+                if (edge_on_seam[CornerTable::next(act)]) {
+                    vertex = table.add_vertex();
+                    table.vertex_corner[vertex] = act;
+                }
+                table.corner_vertex[act] = vertex;
+                act = base.swing_right(act);
+            }
+        }
+        return true;
+    }
+};
+
+// Edgebreaker symbols, as read from the standard traversal
+enum Topology : uint32_t {
+    TOPOLOGY_C = 0,
+    TOPOLOGY_S = 1,
+    TOPOLOGY_L = 3,
+    TOPOLOGY_R = 5,
+    TOPOLOGY_E = 7,
+    TOPOLOGY_INVALID = 8
+};
+
+static const int TRAVERSAL_STANDARD = 0;
+static const int TRAVERSAL_VALENCE = 2;
+
+// Source of the edgebreaker symbols, start face configurations and attribute
+// seams. The valence traversal predicts each symbol from the valence of the
+// vertex it continues from.
+struct Traversal {
+    int type = TRAVERSAL_STANDARD;
+    Buffer symbols;
+    BitDecoder start_faces;
+    std::vector<BitDecoder> seams;
+
+    static constexpr int MIN_VALENCE = 2;
+    static constexpr int MAX_VALENCE = 7;
+    std::vector<int> valences;
+    std::vector<std::vector<uint32_t>> context_symbols;
+    std::vector<int> context_counters;
+    int active_context = -1;
+    uint32_t last_symbol = TOPOLOGY_INVALID;
+
+    // Reads everything but the symbols from buffer, leaving it after the
+    // traversal data
+    bool start(Buffer &buffer, size_t num_vertices, size_t num_faces, size_t num_attribute_data) {
+        if (type == TRAVERSAL_STANDARD) {
+            uint64_t bytes = buffer.read_varint();
+            if (buffer.failed || bytes > buffer.remaining()) {
+                return false;
+            }
+            symbols = buffer;
+            symbols.start_bits();
+            buffer.advance(bytes);
+        }
+        if (!start_faces.start(buffer)) {
+            return false;
+        }
+        seams.resize(num_attribute_data);
+        for (BitDecoder &seam : seams) {
+            if (!seam.start(buffer)) {
+                return false;
+            }
+        }
+        if (type == TRAVERSAL_VALENCE) {
+            valences.assign(num_vertices, 0);
+            context_symbols.resize(MAX_VALENCE - MIN_VALENCE + 1);
+            context_counters.assign(context_symbols.size(), 0);
+            for (size_t i = 0; i < context_symbols.size(); i++) {
+                uint64_t count = buffer.read_varint();
+                if (buffer.failed || count > num_faces) {
+                    return false;
+                }
+                context_symbols[i].resize(count);
+                if (!DecodeSymbols(buffer, count, 1, context_symbols[i].data())) {
+                    return false;
+                }
+                context_counters[i] = int(count);
+            }
+        }
+        return !buffer.failed;
+    }
+
+    uint32_t next_symbol() {
+        if (type == TRAVERSAL_STANDARD) {
+            uint32_t symbol = symbols.read_bits(1);
+            if (symbol != TOPOLOGY_C) {
+                symbol |= symbols.read_bits(2) << 1;
+            }
+            return symbol;
+        }
+        static const uint32_t CONTEXT_TOPOLOGY[] = {TOPOLOGY_C, TOPOLOGY_S, TOPOLOGY_L, TOPOLOGY_R, TOPOLOGY_E};
+        if (active_context < 0) {
+            // The first symbol is always E
+            last_symbol = TOPOLOGY_E;
+            return last_symbol;
+        }
+        int counter = --context_counters[active_context];
+        if (counter < 0) {
+            return TOPOLOGY_INVALID;
+        }
+        uint32_t symbol = context_symbols[active_context][counter];
+        last_symbol = (symbol < 5) ? CONTEXT_TOPOLOGY[symbol] : TOPOLOGY_INVALID;
+        return last_symbol;
+    }
+
+    void corner_reached(const CornerTable &table, uint32_t corner) {
+        if (type != TRAVERSAL_VALENCE) {
+            return;
+        }
+        uint32_t v = table.vertex(corner);
+        uint32_t next = table.vertex(CornerTable::next(corner));
+        uint32_t previous = table.vertex(CornerTable::previous(corner));
+        switch (last_symbol) {
+        case TOPOLOGY_C:
+        case TOPOLOGY_S:
+            valences[next] += 1;
+            valences[previous] += 1;
+            break;
+        case TOPOLOGY_R:
+            valences[v] += 1;
+            valences[next] += 1;
+            valences[previous] += 2;
+            break;
+        case TOPOLOGY_L:
+            valences[v] += 1;
+            valences[next] += 2;
+            valences[previous] += 1;
+            break;
+        case TOPOLOGY_E:
+            valences[v] += 2;
+            valences[next] += 2;
+            valences[previous] += 2;
+            break;
+        default:
+            break;
+        }
+        int valence = std::min(std::max(valences[next], MIN_VALENCE), MAX_VALENCE);
+        active_context = valence - MIN_VALENCE;
+    }
+
+    void merge_vertices(uint32_t dest, uint32_t source) {
+        if (type == TRAVERSAL_VALENCE) {
+            valences[dest] += valences[source];
+        }
+    }
+};
+
+enum DataType {
+    DT_INVALID,
+    DT_INT8,
+    DT_UINT8,
+    DT_INT16,
+    DT_UINT16,
+    DT_INT32,
+    DT_UINT32,
+    DT_INT64,
+    DT_UINT64,
+    DT_FLOAT32,
+    DT_FLOAT64,
+    DT_BOOL,
+    DT_TYPES_COUNT
+};
+
+enum AttributeType {
+    ATTRIBUTE_POSITION,
+    ATTRIBUTE_NORMAL,
+    ATTRIBUTE_COLOR,
+    ATTRIBUTE_TEX_COORD,
+    ATTRIBUTE_GENERIC,
+    ATTRIBUTE_TYPES_COUNT
+};
+
+// How each attribute's values are coded
+enum ValueCoding {
+    CODING_GENERIC,
+    CODING_INTEGER,
+    CODING_QUANTIZATION,
+    CODING_NORMALS
+};
+
+struct Attribute {
+    int type = ATTRIBUTE_GENERIC;
+    int data_type = DT_INVALID;
+    int num_components = 0;
+    bool normalized = false;
+    int unique_id = 0;
+    int coding = CODING_GENERIC;
+    int decoder = 0;
+    // Integer values before dequantization, in encoding order. Normals have
+    // two octahedral coordinates per value.
+    std::vector<int32_t> portable;
+    int portable_components = 0;
+    // Value of each point
+    std::vector<uint32_t> point_value;
+    // num_components floats per value
+    std::vector<float> values;
+};
+
+static const int MESH_VERTEX_ATTRIBUTE = 0;
+static const int MESH_CORNER_ATTRIBUTE = 1;
+
+static const int TRAVERSAL_DEPTH_FIRST = 0;
+static const int TRAVERSAL_PREDICTION_DEGREE = 1;
+
+// A group of attributes decoded in the same point order
+struct AttributesDecoder {
+    // AttributeConnectivity the values were traversed on, -1 for the
+    // position connectivity
+    int connectivity = -1;
+    int type = MESH_VERTEX_ATTRIBUTE;
+    int traversal = TRAVERSAL_DEPTH_FIRST;
+    std::vector<int> attributes;
+    // Point of each value in encoding order
+    std::vector<uint32_t> point_ids;
+};
+
+// Edgebreaker symbol that continues on an edge of an earlier one, which
+// would otherwise look like the start of a new component
+struct TopologySplit {
+    uint32_t source_symbol = 0;
+    uint32_t split_symbol = 0;
+    // 0 for the left edge, 1 for the right edge
+    uint32_t source_edge = 0;
+};
+
+class Decoder {
+    public:
+    Decoder(const unsigned char *data, size_t size) : buffer(data, size) {}
+
+    bool decode(DracoMesh &mesh);
+
+    private:
+    Buffer buffer;
+    bool edgebreaker = false;
+    Traversal traversal;
+    size_t num_points = 0;
+    std::vector<uint32_t> faces;
+
+    // Edgebreaker connectivity
+    CornerTable corners;
+    std::vector<bool> vertex_hole;
+    std::vector<AttributeConnectivity> connectivity;
+    EncodingData position_encoding;
+
+    std::vector<AttributesDecoder> decoders;
+    std::vector<Attribute> attributes;
+
+    bool decode_sequential_connectivity();
+    bool decode_edgebreaker_connectivity();
+    int decode_faces(size_t num_symbols, size_t max_vertices, std::vector<TopologySplit> &splits);
+    bool decode_seams(uint32_t corner);
+    bool assign_points(size_t num_vertices);
+
+    bool decode_attributes_decoder(AttributesDecoder &decoder);
+    bool generate_sequence(AttributesDecoder &decoder);
+    bool decode_values(Attribute &attribute, const AttributesDecoder &decoder);
+    bool decode_transform(Attribute &attribute);
+    bool predict(Attribute &attribute, const AttributesDecoder &decoder, int method, int transform);
+
+    const CornerTable *attribute_table(int attribute) const;
+    const EncodingData *attribute_encoding(int attribute) const;
+};
+
+bool Decoder::decode_sequential_connectivity() {
+    uint64_t num_faces = buffer.read_varint();
+    num_points = buffer.read_varint();
+    int method = buffer.read<unsigned char>();
+    if (buffer.failed || num_faces > buffer.remaining()*8 || num_points > UINT32_MAX) {
+        return false;
+    }
+    faces.resize(num_faces*3);
+    if (method == 0) {
+        // Entropy coded index deltas, sign in the lowest bit
+        if (!DecodeSymbols(buffer, faces.size(), 1, faces.data())) {
+            return false;
+        }
+        int32_t last = 0;
+        for (uint32_t &index : faces) {
+            int32_t delta = int32_t(index >> 1);
+            last += (index & 1) ? -delta : delta;
+            index = uint32_t(last);
+        }
+    } else {
+        for (uint32_t &index : faces) {
+            if (num_points < 256) {
+                index = buffer.read<uint8_t>();
+            } else if (num_points < (1 << 16)) {
+                index = buffer.read<uint16_t>();
+            } else if (num_points < (1 << 21)) {
+                index = uint32_t(buffer.read_varint());
+            } else {
+                index = buffer.read<uint32_t>();
+            }
+        }
+    }
+    if (buffer.failed) {
+        return false;
+    }
+    for (uint32_t index : faces) {
+        if (index >= num_points) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Decoder::decode_edgebreaker_connectivity() {
+    uint64_t num_encoded_vertices = buffer.read_varint();
+    uint64_t num_faces = buffer.read_varint();
+    size_t num_attribute_data = buffer.read<unsigned char>();
+    uint64_t num_symbols = buffer.read_varint();
+    uint64_t num_split_symbols = buffer.read_varint();
+    if (buffer.failed || num_faces > (1u << 28) || num_symbols > num_faces || num_split_symbols > num_symbols ||
+        num_encoded_vertices > 3*num_faces) {
+        return false;
+    }
+    size_t max_vertices = num_encoded_vertices + num_split_symbols;
+    corners.reset(num_faces);
+    vertex_hole.assign(max_vertices, true);
+    connectivity.resize(num_attribute_data);
+
+    // Topology splits, symbol ids are delta coded and count from the end
+    std::vector<TopologySplit> splits;
+    uint64_t num_splits = buffer.read_varint();
+    if (buffer.failed || num_splits > num_faces) {
+        return false;
+    }
+    if (num_splits > 0) {
+        splits.resize(num_splits);
+        uint32_t last_source = 0;
+        for (TopologySplit &split : splits) {
+            uint64_t source = last_source + buffer.read_varint();
+            uint64_t delta = buffer.read_varint();
+            if (source > UINT32_MAX || delta > source) {
+                return false;
+            }
+            split.source_symbol = uint32_t(source);
+            split.split_symbol = uint32_t(source - delta);
+            last_source = split.source_symbol;
+        }
+        buffer.start_bits();
+        for (TopologySplit &split : splits) {
+            split.source_edge = buffer.read_bits(1);
+        }
+        buffer.end_bits();
+    }
+    if (buffer.failed) {
+        return false;
+    }
+
+    if (!traversal.start(buffer, max_vertices, num_faces, num_attribute_data)) {
+        return false;
+    }
+    int num_vertices = decode_faces(num_symbols, max_vertices, splits);
+    if (num_vertices < 0) {
+        return false;
+    }
+
+    if (!connectivity.empty()) {
+        for (AttributeConnectivity &data : connectivity) {
+            data.edge_on_seam.assign(corners.num_corners(), false);
+            data.vertex_on_seam.assign(corners.num_vertices(), false);
+        }
+        for (uint32_t c = 0; c < corners.num_corners(); c += 3) {
+            decode_seams(c);
+        }
+        for (AttributeConnectivity &data : connectivity) {
+            for (uint32_t c : data.seam_corners) {
+                data.add_seam(corners, c);
+            }
+            if (!data.build(corners)) {
+                return false;
+            }
+        }
+    }
+    position_encoding.vertex_value.assign(corners.num_vertices(), INVALID);
+    for (AttributeConnectivity &data : connectivity) {
+        size_t vertices = std::max(data.table.num_vertices(), corners.num_vertices());
+        data.encoding.vertex_value.assign(vertices, INVALID);
+    }
+    return assign_points(num_vertices);
+}
+
+// Seam flags of the edges of a face, edges on a boundary are always seams
+bool Decoder::decode_seams(uint32_t corner) {
+    uint32_t face_corners[3] = {corner, CornerTable::next(corner), CornerTable::previous(corner)};
+    for (uint32_t c : face_corners) {
+        uint32_t opposite = corners.opposite(c);
+        if (opposite == INVALID) {
+            for (AttributeConnectivity &data : connectivity) {
+                data.seam_corners.push_back(c);
+            }
+            continue;
+        }
+        if (opposite/3 < c/3) {
+            continue;
+        }
+        for (size_t i = 0; i < connectivity.size(); i++) {
+            if (traversal.seams[i].next()) {
+                connectivity[i].seam_corners.push_back(c);
+            }
+        }
+    }
+    return true;
+}
+
+// Rebuilds the faces from the edgebreaker symbols, which are stored in
+// reverse. Returns the number of vertices, or -1 if the symbols are invalid.
+int Decoder::decode_faces(size_t num_symbols, size_t max_vertices, std::vector<TopologySplit> &splits) {
+    // Open boundary edges, identified by their opposite corner
+    std::vector<uint32_t> active;
+    // Boundary edges a later S symbol continues on, keyed by its symbol id
+    std::unordered_map<uint32_t, uint32_t> split_active;
+    // Vertices merged away by S symbols, only removed if no attribute has its
+    // own connectivity
+    std::vector<uint32_t> invalid_vertices;
+    bool remove_invalid_vertices = connectivity.empty();
+
+    CornerTable &table = corners;
+    size_t num_faces = 0;
+    for (size_t symbol_id = 0; symbol_id < num_symbols; symbol_id++) {
+        uint32_t corner = uint32_t(3*num_faces++);
+        bool check_split = false;
+        uint32_t symbol = traversal.next_symbol();
+        if (symbol == TOPOLOGY_C) {
+            // New face between the active edge and the boundary edge next to
+            // it around vertex x
+            if (active.empty()) {
+                return -1;
+            }
+            uint32_t corner_a = active.back();
+            uint32_t vertex_x = table.vertex(CornerTable::next(corner_a));
+            uint32_t corner_b = CornerTable::next(table.left_most(vertex_x));
+            if (corner_b == INVALID || corner_a == corner_b || table.opposite(corner_a) != INVALID ||
+                table.opposite(corner_b) != INVALID) {
+                return -1;
+            }
+            table.set_opposite(corner_a, corner + 1);
+            table.set_opposite(corner_b, corner + 2);
+            uint32_t vertex_a_prev = table.vertex(CornerTable::previous(corner_a));
+            uint32_t vertex_b_next = table.vertex(CornerTable::next(corner_b));
+            if (vertex_x == vertex_a_prev || vertex_x == vertex_b_next) {
+                return -1;
+            }
+            table.corner_vertex[corner] = vertex_x;
+            table.corner_vertex[corner + 1] = vertex_b_next;
+            table.corner_vertex[corner + 2] = vertex_a_prev;
+            table.vertex_corner[vertex_a_prev] = corner + 2;
+            vertex_hole[vertex_x] = false;
+            active.back() = corner;
+        } else if (symbol == TOPOLOGY_R || symbol == TOPOLOGY_L) {
+            // New face on the active edge with a new vertex
+            if (active.empty()) {
+                return -1;
+            }
+            uint32_t corner_a = active.back();
+            if (table.opposite(corner_a) != INVALID) {
+                return -1;
+            }
+            uint32_t opposite, corner_l, corner_r;
+            if (symbol == TOPOLOGY_R) {
+                opposite = corner + 2;
+                corner_l = corner + 1;
+                corner_r = corner;
+            } else {
+                opposite = corner + 1;
+                corner_l = corner;
+                corner_r = corner + 2;
+            }
+            table.set_opposite(opposite, corner_a);
+            uint32_t vertex = table.add_vertex();
+            if (table.num_vertices() > max_vertices) {
+                return -1;
+            }
+            table.corner_vertex[opposite] = vertex;
+            table.vertex_corner[vertex] = opposite;
+            uint32_t vertex_r = table.vertex(CornerTable::previous(corner_a));
+            table.corner_vertex[corner_r] = vertex_r;
+            table.vertex_corner[vertex_r] = corner_r;
+            table.corner_vertex[corner_l] = table.vertex(CornerTable::next(corner_a));
+            active.back() = corner;
+            check_split = true;
+        } else if (symbol == TOPOLOGY_S) {
+            // New face joining the two last active edges, their vertices p
+            // and n are merged
+            if (active.empty()) {
+                return -1;
+            }
+            uint32_t corner_b = active.back();
+            active.pop_back();
+            auto split = split_active.find(uint32_t(symbol_id));
+            if (split != split_active.end()) {
+                active.push_back(split->second);
+            }
+            if (active.empty()) {
+                return -1;
+            }
+            uint32_t corner_a = active.back();
+            if (corner_a == corner_b || table.opposite(corner_a) != INVALID || table.opposite(corner_b) != INVALID) {
+                return -1;
+            }
+            table.set_opposite(corner_a, corner + 2);
+            table.set_opposite(corner_b, corner + 1);
+            uint32_t vertex_p = table.vertex(CornerTable::previous(corner_a));
+            table.corner_vertex[corner] = vertex_p;
+            table.corner_vertex[corner + 1] = table.vertex(CornerTable::next(corner_a));
+            uint32_t vertex_b_prev = table.vertex(CornerTable::previous(corner_b));
+            table.corner_vertex[corner + 2] = vertex_b_prev;
+            table.vertex_corner[vertex_b_prev] = corner + 2;
+            uint32_t corner_n = CornerTable::next(corner_b);
+            uint32_t vertex_n = table.vertex(corner_n);
+            traversal.merge_vertices(vertex_p, vertex_n);
+            table.vertex_corner[vertex_p] = table.left_most(vertex_n);
+            uint32_t first = corner_n;
+            while (corner_n != INVALID) {
+                table.corner_vertex[corner_n] = vertex_p;
+                corner_n = table.swing_left(corner_n);
+                if (corner_n == first) {
+                    return -1;
+                }
+            }
+            table.vertex_corner[vertex_n] = INVALID;
+            if (remove_invalid_vertices) {
+                invalid_vertices.push_back(vertex_n);
+            }
+            active.back() = corner;
+        } else if (symbol == TOPOLOGY_E) {
+            // New isolated face with three new vertices
+            uint32_t first = table.add_vertex();
+            table.add_vertex();
+            table.add_vertex();
+            if (table.num_vertices() > max_vertices) {
+                return -1;
+            }
+            for (uint32_t i = 0; i < 3; i++) {
+                table.corner_vertex[corner + i] = first + i;
+                table.vertex_corner[first + i] = corner + i;
+            }
+            active.push_back(corner);
+            check_split = true;
+        } else {
+            return -1;
+        }
+        traversal.corner_reached(table, active.back());
+
+        if (check_split) {
+            // The face may own an edge a later S symbol continues on
+            uint32_t encoder_symbol_id = uint32_t(num_symbols - symbol_id - 1);
+            while (!splits.empty()) {
+                const TopologySplit &split = splits.back();
+                if (split.source_symbol > encoder_symbol_id) {
+                    return -1;
+                }
+                if (split.source_symbol != encoder_symbol_id) {
+                    break;
+                }
+                uint32_t top = active.back();
+                uint32_t edge = (split.source_edge == 1) ? CornerTable::next(top) : CornerTable::previous(top);
+                uint32_t decoder_split_symbol = uint32_t(num_symbols - split.split_symbol - 1);
+                split_active[decoder_split_symbol] = edge;
+                splits.pop_back();
+            }
+        }
+    }
+    if (table.num_vertices() > max_vertices) {
+        return -1;
+    }
+
+    // Start faces close the remaining boundaries, either with one more face
+    // for components without a boundary or none
+    while (!active.empty()) {
+        uint32_t corner = active.back();
+        active.pop_back();
+        if (!traversal.start_faces.next()) {
+            continue;
+        }
+        if (num_faces >= table.num_faces()) {
+            return -1;
+        }
+        uint32_t vertex_n = table.vertex(CornerTable::next(corner));
+        uint32_t corner_b = CornerTable::next(table.left_most(vertex_n));
+        uint32_t vertex_x = table.vertex(CornerTable::next(corner_b));
+        uint32_t corner_c = CornerTable::next(table.left_most(vertex_x));
+        if (corner_b == INVALID || corner_c == INVALID || corner == corner_b || corner == corner_c ||
+            corner_b == corner_c || table.opposite(corner) != INVALID || table.opposite(corner_b) != INVALID ||
+            table.opposite(corner_c) != INVALID) {
+            return -1;
+        }
+        uint32_t vertex_p = table.vertex(CornerTable::next(corner_c));
+        uint32_t new_corner = uint32_t(3*num_faces++);
+        table.set_opposite(new_corner, corner);
+        table.set_opposite(new_corner + 1, corner_b);
+        table.set_opposite(new_corner + 2, corner_c);
+        table.corner_vertex[new_corner] = vertex_x;
+        table.corner_vertex[new_corner + 1] = vertex_p;
+        table.corner_vertex[new_corner + 2] = vertex_n;
+        for (uint32_t i = 0; i < 3; i++) {
+            vertex_hole[table.vertex(new_corner + i)] = false;
+        }
+    }
+    if (num_faces != table.num_faces()) {
+        return -1;
+    }
+
+    // Move the last valid vertices into the holes left by merged ones so all
+    // vertices below the returned count are used
+    int num_vertices = int(table.num_vertices());
+    for (uint32_t invalid : invalid_vertices) {
+        while (num_vertices > 0 && table.left_most(num_vertices - 1) == INVALID) {
+            num_vertices--;
+        }
+        if (num_vertices == 0) {
+            return -1;
+        }
+        uint32_t source = uint32_t(num_vertices - 1);
+        if (source < invalid) {
+            continue;
+        }
+        // Corners of source, counter-clockwise and then clockwise from its
+        // left-most corner
+        uint32_t start = table.left_most(source);
+        uint32_t c = start;
+        bool left = true;
+        while (c != INVALID) {
+            if (table.vertex(c) != source) {
+                return -1;
+            }
+            table.corner_vertex[c] = invalid;
+            if (left) {
+                c = table.swing_left(c);
+                if (c == INVALID) {
+                    c = table.swing_right(start);
+                    left = false;
+                } else if (c == start) {
+                    c = INVALID;
+                }
+            } else {
+                c = table.swing_right(c);
+            }
+        }
+        table.vertex_corner[invalid] = start;
+        table.vertex_corner[source] = INVALID;
+        vertex_hole[invalid] = vertex_hole[source];
+        vertex_hole[source] = false;
+        num_vertices--;
+    }
+    return num_vertices;
+}
+
+// One point per vertex, split further wherever any attribute has a seam
+bool Decoder::assign_points(size_t num_vertices) {
+    size_t num_corners = corners.num_corners();
+    faces.assign(num_corners, INVALID);
+    if (connectivity.empty()) {
+        for (size_t c = 0; c < num_corners; c++) {
+            faces[c] = corners.vertex(uint32_t(c));
+            if (faces[c] >= num_vertices) {
+                return false;
+            }
+        }
+        num_points = num_vertices;
+        return true;
+    }
+
+    num_points = 0;
+    for (uint32_t v = 0; v < corners.num_vertices(); v++) {
+        uint32_t c = corners.left_most(v);
+        if (c == INVALID) {
+            continue;
+        }
+        // Interior vertices start at the first seam of any attribute
+        uint32_t first = c;
+        if (!vertex_hole[v]) {
+            for (const AttributeConnectivity &data : connectivity) {
+                if (!data.vertex_on_seam[corners.vertex(c)]) {
+                    continue;
+                }
+                uint32_t vertex = data.table.vertex(c);
+                uint32_t act = corners.swing_right(c);
+                bool found = false;
+                while (act != c) {
+                    if (act == INVALID) {
+                        return false;
+                    }
+                    if (data.table.vertex(act) != vertex) {
+                        first = act;
+                        found = true;
+                        break;
+                    }
+                    act = corners.swing_right(act);
+                }
+                if (found) {
+                    break;
+                }
+            }
+        }
+        // Clockwise from there, with a new point whenever an attribute changes
+        faces[first] = uint32_t(num_points++);
+        uint32_t previous = first;
+        c = corners.swing_right(first);
+        while (c != INVALID && c != first) {
+            bool seam = false;
+            for (const AttributeConnectivity &data : connectivity) {
+                if (data.table.vertex(c) != data.table.vertex(previous)) {
+                    seam = true;
+                    break;
+                }
+            }
+            faces[c] = seam ? uint32_t(num_points++) : faces[previous];
+            previous = c;
+            c = corners.swing_right(c);
+        }
+    }
+    return std::find(faces.begin(), faces.end(), INVALID) == faces.end();
+}
+
+static size_t DataTypeSize(int data_type) {
+    switch (data_type) {
+    case DT_INT8:
+    case DT_UINT8:
+    case DT_BOOL:
+        return 1;
+    case DT_INT16:
+    case DT_UINT16:
+        return 2;
+    case DT_INT32:
+    case DT_UINT32:
+    case DT_FLOAT32:
+        return 4;
+    case DT_INT64:
+    case DT_UINT64:
+    case DT_FLOAT64:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+bool Decoder::decode_attributes_decoder(AttributesDecoder &decoder) {
+    uint64_t count = buffer.read_varint();
+    if (buffer.failed || count == 0 || count > buffer.remaining()) {
+        return false;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        Attribute attribute;
+        attribute.type = buffer.read<unsigned char>();
+        attribute.data_type = buffer.read<unsigned char>();
+        attribute.num_components = buffer.read<unsigned char>();
+        attribute.normalized = buffer.read<unsigned char>() > 0;
+        attribute.unique_id = int(buffer.read_varint());
+        if (buffer.failed || attribute.type >= ATTRIBUTE_TYPES_COUNT || attribute.data_type == DT_INVALID ||
+            attribute.data_type >= DT_TYPES_COUNT || attribute.num_components == 0) {
+            return false;
+        }
+        attribute.decoder = int(&decoder - decoders.data());
+        decoder.attributes.push_back(int(attributes.size()));
+        attributes.push_back(attribute);
+    }
+    for (int id : decoder.attributes) {
+        Attribute &attribute = attributes[id];
+        attribute.coding = buffer.read<unsigned char>();
+        bool is_float = attribute.data_type == DT_FLOAT32 || attribute.data_type == DT_FLOAT64;
+        switch (attribute.coding) {
+        case CODING_GENERIC:
+        case CODING_INTEGER:
+            attribute.portable_components = attribute.num_components;
+            break;
+        case CODING_QUANTIZATION:
+            if (attribute.data_type != DT_FLOAT32) {
+                return false;
+            }
+            attribute.portable_components = attribute.num_components;
+            break;
+        case CODING_NORMALS:
+            if (!is_float || attribute.num_components != 3) {
+                return false;
+            }
+            attribute.portable_components = 2;
+            break;
+        default:
+            return false;
+        }
+    }
+    return !buffer.failed;
+}
+
+bool Decoder::decode(DracoMesh &mesh) {
+    if (buffer.remaining() < 11 || memcmp(buffer.head(), "DRACO", 5) != 0) {
+        return false;
+    }
+    buffer.advance(5);
+    int major = buffer.read<unsigned char>();
+    int minor = buffer.read<unsigned char>();
+    int encoder_type = buffer.read<unsigned char>();
+    int method = buffer.read<unsigned char>();
+    uint16_t flags = buffer.read<uint16_t>();
+    static const int TRIANGULAR_MESH = 1;
+    static const uint16_t METADATA_FLAG = 0x8000;
+    if (major != 2 || minor != 2 || encoder_type != TRIANGULAR_MESH || method > 1 || (flags & METADATA_FLAG) != 0) {
+        return false;
+    }
+    edgebreaker = method == 1;
+    if (edgebreaker) {
+        traversal.type = buffer.read<unsigned char>();
+        if (traversal.type != TRAVERSAL_STANDARD && traversal.type != TRAVERSAL_VALENCE) {
+            return false;
+        }
+        if (!decode_edgebreaker_connectivity()) {
+            return false;
+        }
+    } else if (!decode_sequential_connectivity()) {
+        return false;
+    }
+
+    size_t num_decoders = buffer.read<unsigned char>();
+    decoders.resize(num_decoders);
+    for (size_t i = 0; i < num_decoders && edgebreaker; i++) {
+        AttributesDecoder &decoder = decoders[i];
+        decoder.connectivity = buffer.read<int8_t>();
+        decoder.type = buffer.read<unsigned char>();
+        decoder.traversal = buffer.read<unsigned char>();
+        if (decoder.connectivity >= int(connectivity.size()) || decoder.connectivity < -1 ||
+            decoder.traversal > TRAVERSAL_PREDICTION_DEGREE) {
+            return false;
+        }
+        if (decoder.type == MESH_VERTEX_ATTRIBUTE) {
+            if (decoder.connectivity >= 0) {
+                connectivity[decoder.connectivity].used = false;
+            }
+        } else if (decoder.type != MESH_CORNER_ATTRIBUTE || decoder.traversal != TRAVERSAL_DEPTH_FIRST ||
+                   decoder.connectivity < 0) {
+            return false;
+        }
+        if (decoder.connectivity >= 0) {
+            connectivity[decoder.connectivity].decoder_id = int(i);
+        }
+    }
+    for (AttributesDecoder &decoder : decoders) {
+        if (buffer.failed || !decode_attributes_decoder(decoder)) {
+            return false;
+        }
+    }
+
+    // Each decoder stores the values of all its attributes, then the
+    // parameters to convert them back to floats
+    for (AttributesDecoder &decoder : decoders) {
+        if (!generate_sequence(decoder)) {
+            return false;
+        }
+        for (int id : decoder.attributes) {
+            if (!decode_values(attributes[id], decoder)) {
+                return false;
+            }
+        }
+        for (int id : decoder.attributes) {
+            if (!decode_transform(attributes[id])) {
+                return false;
+            }
+        }
+    }
+
+    mesh.num_points = num_points;
+    mesh.faces = std::move(faces);
+    mesh.attributes.clear();
+    for (const Attribute &attribute : attributes) {
+        DracoAttribute out;
+        out.unique_id = attribute.unique_id;
+        out.num_components = attribute.num_components;
+        out.values.resize(num_points*attribute.num_components);
+        size_t num_values = attribute.values.size()/attribute.num_components;
+        for (size_t p = 0; p < num_points; p++) {
+            uint32_t value = attribute.point_value[p];
+            if (value >= num_values) {
+                return false;
+            }
+            memcpy(&out.values[p*out.num_components], &attribute.values[value*out.num_components],
+                   out.num_components*sizeof(float));
+        }
+        mesh.attributes.push_back(std::move(out));
+    }
+    return true;
+}
+
+// Visits the vertices of table in the order the encoder traversed them,
+// calling visit(vertex, corner) the first time each is reached
+template <typename Visit>
+static bool TraverseDepthFirst(const CornerTable &table, Visit visit) {
+    std::vector<bool> face_visited(table.num_faces(), false);
+    std::vector<bool> vertex_visited(table.num_vertices(), false);
+    auto visited_face = [&](uint32_t c) {
+        return c == INVALID || face_visited[c/3];
+    };
+    auto visit_vertex = [&](uint32_t v, uint32_t c) {
+        if (v == INVALID || v >= vertex_visited.size()) {
+            return false;
+        }
+        if (!vertex_visited[v]) {
+            vertex_visited[v] = true;
+            visit(v, c);
+        }
+        return true;
+    };
+    std::vector<uint32_t> stack;
+    for (uint32_t start = 0; start < table.num_corners(); start += 3) {
+        if (visited_face(start)) {
+            continue;
+        }
+        stack.assign(1, start);
+        if (!visit_vertex(table.vertex(CornerTable::next(start)), CornerTable::next(start)) ||
+            !visit_vertex(table.vertex(CornerTable::previous(start)), CornerTable::previous(start))) {
+            return false;
+        }
+        while (!stack.empty()) {
+            uint32_t c = stack.back();
+            if (visited_face(c)) {
+                stack.pop_back();
+                continue;
+            }
+            while (true) {
+                face_visited[c/3] = true;
+                uint32_t v = table.vertex(c);
+                if (v == INVALID || v >= vertex_visited.size()) {
+                    return false;
+                }
+                if (!vertex_visited[v]) {
+                    bool boundary = table.on_boundary(v);
+                    visit_vertex(v, c);
+                    if (!boundary) {
+                        c = table.right_corner(c);
+                        continue;
+                    }
+                }
+                uint32_t right = table.right_corner(c);
+                uint32_t left = table.left_corner(c);
+                if (visited_face(right)) {
+                    if (visited_face(left)) {
+                        stack.pop_back();
+                        break;
+                    }
+                    c = left;
+                } else if (visited_face(left)) {
+                    c = right;
+                } else {
+                    // Left is continued after everything reached on the right
+                    stack.back() = left;
+                    stack.push_back(right);
+                    break;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Like TraverseDepthFirst, but prefers faces whose new vertex is already
+// surrounded by decoded ones, for better parallelogram predictions
+template <typename Visit>
+static bool TraversePredictionDegree(const CornerTable &table, Visit visit) {
+    static const int MAX_PRIORITY = 3;
+    std::vector<bool> face_visited(table.num_faces(), false);
+    std::vector<bool> vertex_visited(table.num_vertices(), false);
+    std::vector<int> degree(table.num_vertices(), 0);
+    std::vector<uint32_t> stacks[MAX_PRIORITY];
+    int best_priority = 0;
+    auto visited_face = [&](uint32_t c) {
+        return c == INVALID || face_visited[c/3];
+    };
+    auto visit_vertex = [&](uint32_t v, uint32_t c) {
+        if (v == INVALID || v >= vertex_visited.size()) {
+            return false;
+        }
+        if (!vertex_visited[v]) {
+            vertex_visited[v] = true;
+            visit(v, c);
+        }
+        return true;
+    };
+    auto priority = [&](uint32_t c) {
+        uint32_t v = table.vertex(c);
+        if (v == INVALID || v >= vertex_visited.size() || vertex_visited[v]) {
+            return 0;
+        }
+        return (++degree[v] > 1) ? 1 : 2;
+    };
+    auto push = [&](uint32_t c, int p) {
+        stacks[p].push_back(c);
+        best_priority = std::min(best_priority, p);
+    };
+    auto pop = [&]() {
+        for (int i = best_priority; i < MAX_PRIORITY; i++) {
+            if (!stacks[i].empty()) {
+                uint32_t c = stacks[i].back();
+                stacks[i].pop_back();
+                best_priority = i;
+                return c;
+            }
+        }
+        return INVALID;
+    };
+    for (uint32_t start = 0; start < table.num_corners(); start += 3) {
+        stacks[0].push_back(start);
+        best_priority = 0;
+        if (!visit_vertex(table.vertex(CornerTable::next(start)), CornerTable::next(start)) ||
+            !visit_vertex(table.vertex(CornerTable::previous(start)), CornerTable::previous(start)) ||
+            !visit_vertex(table.vertex(start), start)) {
+            return false;
+        }
+        uint32_t c;
+        while ((c = pop()) != INVALID) {
+            if (visited_face(c)) {
+                continue;
+            }
+            while (true) {
+                face_visited[c/3] = true;
+                if (!visit_vertex(table.vertex(c), c)) {
+                    return false;
+                }
+                uint32_t right = table.right_corner(c);
+                uint32_t left = table.left_corner(c);
+                bool right_visited = visited_face(right);
+                bool left_visited = visited_face(left);
+                if (!left_visited) {
+                    int p = priority(left);
+                    if (right_visited && p <= best_priority) {
+                        c = left;
+                        continue;
+                    }
+                    push(left, p);
+                }
+                if (!right_visited) {
+                    int p = priority(right);
+                    if (p <= best_priority) {
+                        c = right;
+                        continue;
+                    }
+                    push(right, p);
+                }
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+bool Decoder::generate_sequence(AttributesDecoder &decoder) {
+    if (!edgebreaker) {
+        decoder.point_ids.resize(num_points);
+        for (size_t p = 0; p < num_points; p++) {
+            decoder.point_ids[p] = uint32_t(p);
+        }
+        for (int id : decoder.attributes) {
+            attributes[id].point_value = decoder.point_ids;
+        }
+        return true;
+    }
+
+    const CornerTable &table =
+        (decoder.type == MESH_CORNER_ATTRIBUTE) ? connectivity[decoder.connectivity].table : corners;
+    EncodingData &encoding =
+        (decoder.connectivity >= 0) ? connectivity[decoder.connectivity].encoding : position_encoding;
+    encoding.value_corner.clear();
+    auto visit = [&](uint32_t v, uint32_t c) {
+        decoder.point_ids.push_back(faces[c]);
+        encoding.value_corner.push_back(c);
+        encoding.vertex_value[v] = uint32_t(encoding.value_corner.size() - 1);
+    };
+    if (table.num_vertices() > encoding.vertex_value.size()) {
+        return false;
+    }
+    bool traversed = (decoder.traversal == TRAVERSAL_PREDICTION_DEGREE) ? TraversePredictionDegree(table, visit)
+                                                                        : TraverseDepthFirst(table, visit);
+    if (!traversed) {
+        return false;
+    }
+
+    std::vector<uint32_t> point_value(num_points, INVALID);
+    for (uint32_t c = 0; c < table.num_corners(); c++) {
+        uint32_t v = table.vertex(c);
+        if (v == INVALID || v >= encoding.vertex_value.size() || encoding.vertex_value[v] >= num_points) {
+            return false;
+        }
+        point_value[faces[c]] = encoding.vertex_value[v];
+    }
+    for (int id : decoder.attributes) {
+        attributes[id].point_value = point_value;
+    }
+    return true;
+}
+
+// Normals are stored as integer coordinates on an octahedron unfolded into a
+// square, center_value at the middle
+struct Octahedron {
+    int bits = 0;
+    int32_t max_quantized = 0;
+    int32_t max_value = 0;
+    int32_t center = 0;
+
+    bool set_bits(int quantization_bits) {
+        if (quantization_bits < 2 || quantization_bits > 30) {
+            return false;
+        }
+        bits = quantization_bits;
+        max_quantized = (1 << bits) - 1;
+        max_value = max_quantized - 1;
+        center = max_value/2;
+        return true;
+    }
+
+    bool in_diamond(int32_t s, int32_t t) const {
+        return std::abs(s) + std::abs(t) <= center;
+    }
+
+    // Mirrors a point, relative to the center, between the inner diamond
+    // and the outer triangles
+    void invert_diamond(int32_t &s, int32_t &t) const {
+        int32_t sign_s, sign_t;
+        if (s >= 0 && t >= 0) {
+            sign_s = 1;
+            sign_t = 1;
+        } else if (s <= 0 && t <= 0) {
+            sign_s = -1;
+            sign_t = -1;
+        } else {
+            sign_s = (s > 0) ? 1 : -1;
+            sign_t = (t > 0) ? 1 : -1;
+        }
+        // Unsigned to wrap instead of overflowing on bad data
+        uint32_t corner_s = uint32_t(sign_s*center);
+        uint32_t corner_t = uint32_t(sign_t*center);
+        uint32_t us = uint32_t(s);
+        uint32_t ut = uint32_t(t);
+        us = us + us - corner_s;
+        ut = ut + ut - corner_t;
+        if (sign_s*sign_t >= 0) {
+            uint32_t temp = us;
+            us = 0 - ut;
+            ut = 0 - temp;
+        } else {
+            std::swap(us, ut);
+        }
+        us = us + corner_s;
+        ut = ut + corner_t;
+        s = int32_t(us)/2;
+        t = int32_t(ut)/2;
+    }
+
+    int32_t mod_max(int32_t x) const {
+        if (x > center) {
+            return x - max_quantized;
+        }
+        if (x < -center) {
+            return x + max_quantized;
+        }
+        return x;
+    }
+
+    void canonicalize_coords(int32_t &s, int32_t &t) const {
+        if ((s == 0 && t == 0) || (s == 0 && t == max_value) || (s == max_value && t == 0)) {
+            s = max_value;
+            t = max_value;
+        } else if (s == 0 && t > center) {
+            t = center - (t - center);
+        } else if (s == max_value && t < center) {
+            t = center + (center - t);
+        } else if (t == max_value && s < center) {
+            s = center + (center - s);
+        } else if (t == 0 && s > center) {
+            s = center - (s - center);
+        }
+    }
+
+    // Scales v so its absolute components sum to center
+    void canonicalize_vector(int32_t *v) const {
+        int64_t abs_sum = int64_t(std::abs(v[0])) + std::abs(v[1]) + std::abs(v[2]);
+        if (abs_sum == 0) {
+            v[0] = center;
+            return;
+        }
+        v[0] = int32_t(int64_t(v[0])*center/abs_sum);
+        v[1] = int32_t(int64_t(v[1])*center/abs_sum);
+        int32_t z = center - std::abs(v[0]) - std::abs(v[1]);
+        v[2] = (v[2] >= 0) ? z : -z;
+    }
+
+    void vector_to_coords(const int32_t *v, int32_t &s, int32_t &t) const {
+        if (v[0] >= 0) {
+            s = v[1] + center;
+            t = v[2] + center;
+        } else {
+            s = (v[1] < 0) ? std::abs(v[2]) : max_value - std::abs(v[2]);
+            t = (v[2] < 0) ? std::abs(v[1]) : max_value - std::abs(v[1]);
+        }
+        canonicalize_coords(s, t);
+    }
+
+    void to_unit_vector(int32_t s, int32_t t, float *out) const {
+        float scale = 2.0f/max_value;
+        float y = s*scale - 1.0f;
+        float z = t*scale - 1.0f;
+        float x = 1.0f - std::abs(y) - std::abs(z);
+        // Points outside the diamond wrap around to the back half
+        float offset = std::max(-x, 0.0f);
+        y += (y < 0) ? offset : -offset;
+        z += (z < 0) ? offset : -offset;
+        float norm_squared = x*x + y*y + z*z;
+        if (norm_squared < 1e-6f) {
+            out[0] = out[1] = out[2] = 0.0f;
+            return;
+        }
+        float d = 1.0f/std::sqrt(norm_squared);
+        out[0] = x*d;
+        out[1] = y*d;
+        out[2] = z*d;
+    }
+};
+
+enum PredictionTransformType {
+    TRANSFORM_NONE = -1,
+    TRANSFORM_DELTA = 0,
+    TRANSFORM_WRAP = 1,
+    TRANSFORM_NORMAL_OCTAHEDRON = 2,
+    TRANSFORM_NORMAL_OCTAHEDRON_CANONICALIZED = 3
+};
+
+// Combines predicted values with the decoded corrections
+struct PredictionTransform {
+    int type = TRANSFORM_WRAP;
+    int32_t min_value = 0;
+    int32_t max_value = 0;
+    int32_t max_dif = 0;
+    Octahedron octahedron;
+
+    bool corrections_positive() const {
+        return type == TRANSFORM_NORMAL_OCTAHEDRON || type == TRANSFORM_NORMAL_OCTAHEDRON_CANONICALIZED;
+    }
+
+    bool read(Buffer &buffer) {
+        if (type == TRANSFORM_WRAP) {
+            min_value = buffer.read<int32_t>();
+            max_value = buffer.read<int32_t>();
+            int64_t dif = int64_t(max_value) - min_value;
+            if (buffer.failed || dif < 0 || dif >= INT32_MAX) {
+                return false;
+            }
+            max_dif = int32_t(dif + 1);
+            return true;
+        }
+        int32_t max_quantized = buffer.read<int32_t>();
+        if (type == TRANSFORM_NORMAL_OCTAHEDRON_CANONICALIZED) {
+            // Center value, implied by max_quantized
+            buffer.read<int32_t>();
+        }
+        if (buffer.failed || max_quantized <= 0 || max_quantized % 2 == 0) {
+            return false;
+        }
+        int bits = 0;
+        while ((max_quantized >> bits) != 0) {
+            bits++;
+        }
+        return octahedron.set_bits(bits);
+    }
+
+    void original(const int32_t *predicted, const int32_t *correction, int32_t *out, int components) const {
+        if (type == TRANSFORM_WRAP) {
+            for (int i = 0; i < components; i++) {
+                int32_t p = std::min(std::max(predicted[i], min_value), max_value);
+                int32_t value = int32_t(uint32_t(p) + uint32_t(correction[i]));
+                if (value > max_value) {
+                    value -= max_dif;
+                } else if (value < min_value) {
+                    value += max_dif;
+                }
+                out[i] = value;
+            }
+            return;
+        }
+        const Octahedron &o = octahedron;
+        int32_t s = predicted[0] - o.center;
+        int32_t t = predicted[1] - o.center;
+        bool in_diamond = o.in_diamond(s, t);
+        if (!in_diamond) {
+            o.invert_diamond(s, t);
+        }
+        if (type == TRANSFORM_NORMAL_OCTAHEDRON) {
+            s = o.mod_max(s + correction[0]);
+            t = o.mod_max(t + correction[1]);
+        } else {
+            // Rotated so the prediction is in the bottom left quadrant
+            bool bottom_left = (s == 0 && t == 0) || (s < 0 && t <= 0);
+            int rotation = 0;
+            if (s == 0) {
+                rotation = (t == 0) ? 0 : (t > 0) ? 3 : 1;
+            } else if (s > 0) {
+                rotation = (t >= 0) ? 2 : 1;
+            } else {
+                rotation = (t <= 0) ? 0 : 3;
+            }
+            auto rotate = [](int32_t &x, int32_t &y, int count) {
+                int32_t ox = x, oy = y;
+                switch (count) {
+                case 1:
+                    x = oy;
+                    y = -ox;
+                    break;
+                case 2:
+                    x = -ox;
+                    y = -oy;
+                    break;
+                case 3:
+                    x = -oy;
+                    y = ox;
+                    break;
+                default:
+                    break;
+                }
+            };
+            if (!bottom_left) {
+                rotate(s, t, rotation);
+            }
+            s = o.mod_max(int32_t(uint32_t(s) + uint32_t(correction[0])));
+            t = o.mod_max(int32_t(uint32_t(t) + uint32_t(correction[1])));
+            if (!bottom_left) {
+                rotate(s, t, (4 - rotation) % 4);
+            }
+        }
+        if (!in_diamond) {
+            o.invert_diamond(s, t);
+        }
+        out[0] = s + o.center;
+        out[1] = t + o.center;
+    }
+};
+
+enum PredictionMethod {
+    PREDICTION_NONE = -2,
+    PREDICTION_UNDEFINED = -1,
+    PREDICTION_DIFFERENCE = 0,
+    PREDICTION_PARALLELOGRAM = 1,
+    PREDICTION_MULTI_PARALLELOGRAM = 2,
+    PREDICTION_TEX_COORDS_DEPRECATED = 3,
+    PREDICTION_CONSTRAINED_MULTI_PARALLELOGRAM = 4,
+    PREDICTION_TEX_COORDS_PORTABLE = 5,
+    PREDICTION_GEOMETRIC_NORMAL = 6,
+    PREDICTION_METHODS_COUNT
+};
+
+// Predicts the value at the tip of corner c from the triangle on the other
+// side of its opposite edge. False if that triangle isn't decoded yet.
+static bool ParallelogramPrediction(uint32_t entry, uint32_t c, const CornerTable &table,
+                                    const std::vector<uint32_t> &vertex_value, const int32_t *data, int components,
+                                    int32_t *out) {
+    uint32_t o = table.opposite(c);
+    if (o == INVALID) {
+        return false;
+    }
+    uint32_t opposite = vertex_value[table.vertex(o)];
+    uint32_t next = vertex_value[table.vertex(CornerTable::next(o))];
+    uint32_t previous = vertex_value[table.vertex(CornerTable::previous(o))];
+    if (opposite >= entry || next >= entry || previous >= entry) {
+        return false;
+    }
+    for (int i = 0; i < components; i++) {
+        int64_t value = int64_t(data[next*components + i]) + data[previous*components + i] -
+                        data[opposite*components + i];
+        out[i] = int32_t(value);
+    }
+    return true;
+}
+
+static uint64_t IntSqrt(uint64_t number) {
+    if (number == 0) {
+        return 0;
+    }
+    uint64_t act = number;
+    uint64_t root = 1;
+    while (act >= 2) {
+        root *= 2;
+        act /= 4;
+    }
+    do {
+        root = (root + number/root)/2;
+    } while (root*root > number);
+    return root;
+}
+
+typedef int64_t Vec3[3];
+
+// Connectivity and value order a mesh prediction works on
+struct PredictionMesh {
+    const CornerTable *table = nullptr;
+    const EncodingData *encoding = nullptr;
+    const std::vector<uint32_t> *point_ids = nullptr;
+    // Quantized positions, used by predictions that need the geometry
+    const Attribute *position = nullptr;
+
+    bool position_at(uint32_t entry, Vec3 &out) const {
+        if (position == nullptr || entry >= point_ids->size()) {
+            return false;
+        }
+        uint32_t value = position->point_value[(*point_ids)[entry]];
+        if (size_t(value)*3 + 3 > position->portable.size()) {
+            return false;
+        }
+        for (int i = 0; i < 3; i++) {
+            out[i] = position->portable[value*3 + i];
+        }
+        return true;
+    }
+
+    bool corner_position(uint32_t c, Vec3 &out) const {
+        return position_at(encoding->vertex_value[table->vertex(c)], out);
+    }
+};
+
+// Predicts texture coordinates by unfolding the triangle's positions onto
+// the coordinates already decoded on its other two corners
+static bool PredictTexCoord(const PredictionMesh &mesh, uint32_t c, uint32_t entry, const int32_t *data,
+                            std::vector<bool> &orientations, int32_t *predicted) {
+    const CornerTable &table = *mesh.table;
+    uint32_t next = mesh.encoding->vertex_value[table.vertex(CornerTable::next(c))];
+    uint32_t previous = mesh.encoding->vertex_value[table.vertex(CornerTable::previous(c))];
+    if (previous < entry && next < entry) {
+        int64_t n_uv[2] = {data[next*2], data[next*2 + 1]};
+        int64_t p_uv[2] = {data[previous*2], data[previous*2 + 1]};
+        if (n_uv[0] == p_uv[0] && n_uv[1] == p_uv[1]) {
+            predicted[0] = int32_t(p_uv[0]);
+            predicted[1] = int32_t(p_uv[1]);
+            return true;
+        }
+        Vec3 tip, next_pos, previous_pos;
+        if (!mesh.position_at(entry, tip) || !mesh.position_at(next, next_pos) ||
+            !mesh.position_at(previous, previous_pos)) {
+            return false;
+        }
+        Vec3 pn, cn;
+        uint64_t pn_norm2 = 0;
+        int64_t cn_dot_pn = 0;
+        for (int i = 0; i < 3; i++) {
+            pn[i] = previous_pos[i] - next_pos[i];
+            cn[i] = tip[i] - next_pos[i];
+            pn_norm2 += uint64_t(pn[i]*pn[i]);
+            cn_dot_pn += pn[i]*cn[i];
+        }
+        if (pn_norm2 != 0) {
+            int64_t pn_uv[2] = {p_uv[0] - n_uv[0], p_uv[1] - n_uv[1]};
+            int64_t n_uv_max = std::max(std::abs(n_uv[0]), std::abs(n_uv[1]));
+            int64_t pn_uv_max = std::max(std::abs(pn_uv[0]), std::abs(pn_uv[1]));
+            int64_t pn_max = std::max(std::max(std::abs(pn[0]), std::abs(pn[1])), std::abs(pn[2]));
+            if (n_uv_max > int64_t(INT64_MAX/pn_norm2) || cn_dot_pn > INT64_MAX/pn_uv_max ||
+                cn_dot_pn > INT64_MAX/pn_max) {
+                return false;
+            }
+            int64_t norm2 = int64_t(pn_norm2);
+            int64_t x_uv[2] = {n_uv[0]*norm2 + cn_dot_pn*pn_uv[0], n_uv[1]*norm2 + cn_dot_pn*pn_uv[1]};
+            // Squared distance of the tip from its projection onto PN
+            uint64_t cx_norm2 = 0;
+            for (int i = 0; i < 3; i++) {
+                int64_t x_pos = next_pos[i] + (cn_dot_pn*pn[i])/norm2;
+                int64_t cx = tip[i] - x_pos;
+                cx_norm2 += uint64_t(cx*cx);
+            }
+            int64_t scale = int64_t(IntSqrt(cx_norm2*pn_norm2));
+            int64_t cx_uv[2] = {pn_uv[1]*scale, -pn_uv[0]*scale};
+            if (orientations.empty()) {
+                return false;
+            }
+            bool orientation = orientations.back();
+            orientations.pop_back();
+            for (int i = 0; i < 2; i++) {
+                uint64_t sum = orientation ? uint64_t(x_uv[i]) + uint64_t(cx_uv[i])
+                                           : uint64_t(x_uv[i]) - uint64_t(cx_uv[i]);
+                predicted[i] = int32_t(int64_t(sum)/norm2);
+            }
+            return true;
+        }
+    }
+    // Falls back to a neighbouring or the last decoded value
+    uint32_t source;
+    if (next < entry) {
+        source = next;
+    } else if (entry > 0) {
+        source = entry - 1;
+    } else {
+        predicted[0] = predicted[1] = 0;
+        return true;
+    }
+    predicted[0] = data[source*2];
+    predicted[1] = data[source*2 + 1];
+    return true;
+}
+
+// Predicts a normal as the area weighted sum of the normals of the faces
+// around the corner's vertex
+static bool PredictNormal(const PredictionMesh &mesh, uint32_t c, int32_t *predicted) {
+    const CornerTable &table = *mesh.table;
+    Vec3 center;
+    if (!mesh.corner_position(c, center)) {
+        return false;
+    }
+    uint64_t normal[3] = {0, 0, 0};
+    uint32_t corner = c;
+    bool left = true;
+    while (corner != INVALID) {
+        Vec3 next, previous;
+        if (!mesh.corner_position(CornerTable::next(corner), next) ||
+            !mesh.corner_position(CornerTable::previous(corner), previous)) {
+            return false;
+        }
+        Vec3 a, b;
+        for (int i = 0; i < 3; i++) {
+            a[i] = next[i] - center[i];
+            b[i] = previous[i] - center[i];
+        }
+        // Unsigned so bad data wraps instead of overflowing
+        normal[0] += uint64_t(a[1]*b[2] - a[2]*b[1]);
+        normal[1] += uint64_t(a[2]*b[0] - a[0]*b[2]);
+        normal[2] += uint64_t(a[0]*b[1] - a[1]*b[0]);
+        if (left) {
+            corner = table.swing_left(corner);
+            if (corner == INVALID) {
+                corner = table.swing_right(c);
+                left = false;
+            } else if (corner == c) {
+                corner = INVALID;
+            }
+        } else {
+            corner = table.swing_right(corner);
+        }
+    }
+    int64_t n[3] = {int64_t(normal[0]), int64_t(normal[1]), int64_t(normal[2])};
+    const int64_t upper_bound = 1 << 29;
+    int64_t abs_sum = std::abs(n[0]) + std::abs(n[1]) + std::abs(n[2]);
+    if (abs_sum > upper_bound) {
+        int64_t quotient = abs_sum/upper_bound;
+        for (int64_t &value : n) {
+            value /= quotient;
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        predicted[i] = int32_t(n[i]);
+    }
+    return true;
+}
+
+const CornerTable *Decoder::attribute_table(int attribute) const {
+    const AttributesDecoder &decoder = decoders[attributes[attribute].decoder];
+    if (decoder.connectivity >= 0 && connectivity[decoder.connectivity].used) {
+        return &connectivity[decoder.connectivity].table;
+    }
+    return &corners;
+}
+
+const EncodingData *Decoder::attribute_encoding(int attribute) const {
+    const AttributesDecoder &decoder = decoders[attributes[attribute].decoder];
+    if (decoder.connectivity >= 0) {
+        return &connectivity[decoder.connectivity].encoding;
+    }
+    return &position_encoding;
+}
+
+// Reads the prediction's own data and reverts it, in place, on the
+// corrections in attribute.portable
+bool Decoder::predict(Attribute &attribute, const AttributesDecoder &decoder, int method, int transform_type) {
+    int components = attribute.portable_components;
+    int32_t *data = attribute.portable.data();
+    size_t num_values = decoder.point_ids.size();
+    PredictionTransform transform;
+    transform.type = transform_type;
+
+    PredictionMesh mesh;
+    if (method != PREDICTION_DIFFERENCE) {
+        int id = int(&attribute - attributes.data());
+        mesh.table = attribute_table(id);
+        mesh.encoding = attribute_encoding(id);
+        mesh.point_ids = &decoder.point_ids;
+        if (mesh.encoding->value_corner.size() != num_values) {
+            return false;
+        }
+        for (const Attribute &other : attributes) {
+            if (other.type == ATTRIBUTE_POSITION) {
+                // Predictions use the first position attribute, which must be
+                // decoded already
+                if (other.portable_components == 3 && !other.portable.empty()) {
+                    mesh.position = &other;
+                }
+                break;
+            }
+        }
+        if ((method == PREDICTION_TEX_COORDS_PORTABLE || method == PREDICTION_GEOMETRIC_NORMAL) &&
+            mesh.position == nullptr) {
+            return false;
+        }
+    }
+
+    if (method == PREDICTION_GEOMETRIC_NORMAL) {
+        if (!transform.read(buffer) || components != 2) {
+            return false;
+        }
+        BitDecoder flips;
+        if (!flips.start(buffer)) {
+            return false;
+        }
+        Octahedron octahedron;
+        octahedron.set_bits(transform.octahedron.bits);
+        for (size_t i = 0; i < num_values; i++) {
+            int32_t normal[3];
+            if (!PredictNormal(mesh, mesh.encoding->value_corner[i], normal)) {
+                return false;
+            }
+            octahedron.canonicalize_vector(normal);
+            if (flips.next()) {
+                for (int32_t &value : normal) {
+                    value = -value;
+                }
+            }
+            int32_t predicted[2];
+            octahedron.vector_to_coords(normal, predicted[0], predicted[1]);
+            transform.original(predicted, data + i*2, data + i*2, 2);
+        }
+        return true;
+    }
+
+    if (method == PREDICTION_TEX_COORDS_PORTABLE) {
+        int32_t count = buffer.read<int32_t>();
+        if (buffer.failed || count < 0 || size_t(count) > num_values || components != 2) {
+            return false;
+        }
+        std::vector<bool> orientations(count);
+        BitDecoder bits;
+        if (!bits.start(buffer)) {
+            return false;
+        }
+        // Delta coded, a set bit keeps the previous orientation
+        bool last = true;
+        for (int32_t i = 0; i < count; i++) {
+            if (!bits.next()) {
+                last = !last;
+            }
+            orientations[i] = last;
+        }
+        if (!transform.read(buffer)) {
+            return false;
+        }
+        for (size_t i = 0; i < num_values; i++) {
+            int32_t predicted[2];
+            if (!PredictTexCoord(mesh, mesh.encoding->value_corner[i], uint32_t(i), data, orientations, predicted)) {
+                return false;
+            }
+            transform.original(predicted, data + i*2, data + i*2, 2);
+        }
+        return true;
+    }
+
+    // Constrained multi-parallelogram marks which of up to four
+    // parallelograms around each vertex to leave out of the average
+    static const int MAX_PARALLELOGRAMS = 4;
+    std::vector<bool> creases[MAX_PARALLELOGRAMS];
+    if (method == PREDICTION_CONSTRAINED_MULTI_PARALLELOGRAM) {
+        for (std::vector<bool> &crease : creases) {
+            uint64_t count = buffer.read_varint();
+            if (buffer.failed || count > corners.num_corners()) {
+                return false;
+            }
+            if (count > 0) {
+                crease.resize(count);
+                BitDecoder bits;
+                if (!bits.start(buffer)) {
+                    return false;
+                }
+                for (size_t i = 0; i < count; i++) {
+                    crease[i] = bits.next();
+                }
+            }
+        }
+    }
+    if (!transform.read(buffer)) {
+        return false;
+    }
+    if (num_values == 0) {
+        return true;
+    }
+
+    std::vector<int32_t> zero(components, 0);
+    transform.original(zero.data(), data, data, components);
+    std::vector<int32_t> predicted(components*MAX_PARALLELOGRAMS);
+    std::vector<int64_t> sum(components);
+    size_t crease_pos[MAX_PARALLELOGRAMS] = {0, 0, 0, 0};
+    for (size_t i = 1; i < num_values; i++) {
+        int32_t *out = data + i*components;
+        const int32_t *previous = data + (i - 1)*components;
+        if (method == PREDICTION_DIFFERENCE) {
+            transform.original(previous, out, out, components);
+            continue;
+        }
+        const CornerTable &table = *mesh.table;
+        const std::vector<uint32_t> &vertex_value = mesh.encoding->vertex_value;
+        uint32_t start = mesh.encoding->value_corner[i];
+        if (method == PREDICTION_PARALLELOGRAM) {
+            bool found = ParallelogramPrediction(uint32_t(i), start, table, vertex_value, data, components,
+                                                 predicted.data());
+            transform.original(found ? predicted.data() : previous, out, out, components);
+            continue;
+        }
+
+        int count = 0;
+        int used = 0;
+        std::fill(sum.begin(), sum.end(), 0);
+        if (method == PREDICTION_MULTI_PARALLELOGRAM) {
+            // Average of every parallelogram around the vertex
+            for (uint32_t c = start; c != INVALID;) {
+                if (ParallelogramPrediction(uint32_t(i), c, table, vertex_value, data, components,
+                                            predicted.data())) {
+                    for (int k = 0; k < components; k++) {
+                        sum[k] += predicted[k];
+                    }
+                    used++;
+                }
+                c = table.swing_right(c);
+                if (c == start) {
+                    break;
+                }
+            }
+        } else {
+            bool first_pass = true;
+            for (uint32_t c = start; c != INVALID;) {
+                if (ParallelogramPrediction(uint32_t(i), c, table, vertex_value, data, components,
+                                            predicted.data() + count*components)) {
+                    if (++count == MAX_PARALLELOGRAMS) {
+                        break;
+                    }
+                }
+                c = first_pass ? table.swing_left(c) : table.swing_right(c);
+                if (c == start) {
+                    break;
+                }
+                if (c == INVALID && first_pass) {
+                    first_pass = false;
+                    c = table.swing_right(start);
+                }
+            }
+            for (int p = 0; p < count; p++) {
+                std::vector<bool> &crease = creases[count - 1];
+                size_t pos = crease_pos[count - 1]++;
+                if (pos >= crease.size()) {
+                    return false;
+                }
+                if (!crease[pos]) {
+                    for (int k = 0; k < components; k++) {
+                        sum[k] += predicted[p*components + k];
+                    }
+                    used++;
+                }
+            }
+        }
+        if (used == 0) {
+            transform.original(previous, out, out, components);
+            continue;
+        }
+        for (int k = 0; k < components; k++) {
+            predicted[k] = int32_t(sum[k]/used);
+        }
+        transform.original(predicted.data(), out, out, components);
+    }
+    return true;
+}
+
+template <typename T>
+static float ReadComponent(Buffer &buffer, bool normalized) {
+    T value = buffer.read<T>();
+    if (normalized && std::is_integral<T>::value) {
+        return float(value)/float(std::numeric_limits<T>::max());
+    }
+    return float(value);
+}
+
+static float ReadComponent(Buffer &buffer, int data_type, bool normalized) {
+    switch (data_type) {
+    case DT_INT8:
+        return ReadComponent<int8_t>(buffer, normalized);
+    case DT_UINT8:
+    case DT_BOOL:
+        return ReadComponent<uint8_t>(buffer, normalized);
+    case DT_INT16:
+        return ReadComponent<int16_t>(buffer, normalized);
+    case DT_UINT16:
+        return ReadComponent<uint16_t>(buffer, normalized);
+    case DT_INT32:
+        return ReadComponent<int32_t>(buffer, normalized);
+    case DT_UINT32:
+        return ReadComponent<uint32_t>(buffer, normalized);
+    case DT_INT64:
+        return ReadComponent<int64_t>(buffer, normalized);
+    case DT_UINT64:
+        return ReadComponent<uint64_t>(buffer, normalized);
+    case DT_FLOAT32:
+        return buffer.read<float>();
+    case DT_FLOAT64:
+        return float(buffer.read<double>());
+    default:
+        buffer.failed = true;
+        return 0.0f;
+    }
+}
+
+bool Decoder::decode_values(Attribute &attribute, const AttributesDecoder &decoder) {
+    size_t num_values = decoder.point_ids.size();
+    if (attribute.coding == CODING_GENERIC) {
+        // Raw values in the attribute's own type
+        size_t count = num_values*attribute.num_components;
+        if (count*DataTypeSize(attribute.data_type) > buffer.remaining()) {
+            return false;
+        }
+        attribute.values.resize(count);
+        for (float &value : attribute.values) {
+            value = ReadComponent(buffer, attribute.data_type, attribute.normalized);
+        }
+        return !buffer.failed;
+    }
+
+    int method = buffer.read<int8_t>();
+    int transform = TRANSFORM_NONE;
+    if (method != PREDICTION_NONE) {
+        transform = buffer.read<int8_t>();
+    }
+    if (buffer.failed || method < PREDICTION_NONE || method >= PREDICTION_METHODS_COUNT ||
+        transform < TRANSFORM_NONE || transform > TRANSFORM_NORMAL_OCTAHEDRON_CANONICALIZED) {
+        return false;
+    }
+    // Normals only predict with the octahedron transforms, other attributes
+    // with wrapping. Any other combination is stored without prediction.
+    bool normal_transform =
+        transform == TRANSFORM_NORMAL_OCTAHEDRON || transform == TRANSFORM_NORMAL_OCTAHEDRON_CANONICALIZED;
+    bool predicted = false;
+    if (method != PREDICTION_NONE) {
+        predicted = (attribute.coding == CODING_NORMALS) ? normal_transform : transform == TRANSFORM_WRAP;
+    }
+    // Mesh predictions need edgebreaker connectivity and fall back to
+    // differences, like unsupported method and transform pairs
+    bool mesh_method = false;
+    if (normal_transform) {
+        mesh_method = method == PREDICTION_GEOMETRIC_NORMAL;
+    } else {
+        mesh_method = method == PREDICTION_PARALLELOGRAM || method == PREDICTION_MULTI_PARALLELOGRAM ||
+                      method == PREDICTION_CONSTRAINED_MULTI_PARALLELOGRAM || method == PREDICTION_TEX_COORDS_PORTABLE;
+    }
+    if (!edgebreaker || !mesh_method) {
+        method = PREDICTION_DIFFERENCE;
+    }
+
+    int components = attribute.portable_components;
+    size_t count = num_values*components;
+    attribute.portable.assign(count, 0);
+    bool compressed = buffer.read<unsigned char>() > 0;
+    if (compressed) {
+        if (!DecodeSymbols(buffer, count, components, reinterpret_cast<uint32_t *>(attribute.portable.data()))) {
+            return false;
+        }
+    } else {
+        size_t bytes = buffer.read<unsigned char>();
+        if (buffer.failed || bytes == 0 || bytes > 4 || count*bytes > buffer.remaining()) {
+            return false;
+        }
+        for (int32_t &value : attribute.portable) {
+            memcpy(&value, buffer.head(), bytes);
+            buffer.advance(bytes);
+        }
+    }
+    if (buffer.failed) {
+        return false;
+    }
+    PredictionTransform corrections;
+    corrections.type = transform;
+    if (!predicted || !corrections.corrections_positive()) {
+        for (int32_t &value : attribute.portable) {
+            value = SymbolToSigned(uint32_t(value));
+        }
+    }
+    if (predicted) {
+        return predict(attribute, decoder, method, transform);
+    }
+    return true;
+}
+
+// Reads the dequantization parameters and converts the values to floats
+bool Decoder::decode_transform(Attribute &attribute) {
+    const std::vector<int32_t> &portable = attribute.portable;
+    int components = attribute.num_components;
+    if (attribute.coding == CODING_GENERIC) {
+        return true;
+    }
+    if (attribute.coding == CODING_INTEGER) {
+        attribute.values.resize(portable.size());
+        for (size_t i = 0; i < portable.size(); i++) {
+            attribute.values[i] = float(portable[i]);
+        }
+        if (attribute.normalized) {
+            // Scaled by the largest value of the attribute's own type
+            float max = 1.0f;
+            switch (attribute.data_type) {
+            case DT_INT8:
+                max = INT8_MAX;
+                break;
+            case DT_UINT8:
+                max = UINT8_MAX;
+                break;
+            case DT_INT16:
+                max = INT16_MAX;
+                break;
+            case DT_UINT16:
+                max = UINT16_MAX;
+                break;
+            case DT_INT32:
+                max = float(INT32_MAX);
+                break;
+            case DT_UINT32:
+                max = float(UINT32_MAX);
+                break;
+            default:
+                break;
+            }
+            for (float &value : attribute.values) {
+                value /= max;
+            }
+        }
+        return true;
+    }
+    if (attribute.coding == CODING_QUANTIZATION) {
+        std::vector<float> min_values(components);
+        for (float &value : min_values) {
+            value = buffer.read<float>();
+        }
+        float range = buffer.read<float>();
+        int bits = buffer.read<unsigned char>();
+        if (buffer.failed || bits < 1 || bits > 31) {
+            return false;
+        }
+        float delta = range/float((1u << bits) - 1);
+        attribute.values.resize(portable.size());
+        for (size_t i = 0; i < portable.size(); i++) {
+            attribute.values[i] = float(portable[i])*delta + min_values[i % components];
+        }
+        return true;
+    }
+    Octahedron octahedron;
+    if (buffer.failed || !octahedron.set_bits(buffer.read<unsigned char>())) {
+        return false;
+    }
+    size_t num_values = portable.size()/2;
+    attribute.values.resize(num_values*3);
+    for (size_t i = 0; i < num_values; i++) {
+        octahedron.to_unit_vector(portable[i*2], portable[i*2 + 1], &attribute.values[i*3]);
+    }
+    return true;
+}
+
+const DracoAttribute *DracoMesh::attribute(int unique_id) const {
+    for (const DracoAttribute &attribute : attributes) {
+        if (attribute.unique_id == unique_id) {
+            return &attribute;
+        }
+    }
+    return nullptr;
+}
+
+bool DecodeDraco(const unsigned char *data, size_t size, DracoMesh &mesh) {
+    Decoder decoder(data, size);
+    return decoder.decode(mesh);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Decoder for Draco 2.2 mesh bitstreams, the version written by the Draco
+// encoder for KHR_draco_mesh_compression. Supports sequential and edgebreaker
+// (standard and valence) connectivity and the attribute prediction schemes
+// the encoder uses for triangle meshes. Point clouds are not supported.
+// https://google.github.io/draco/spec/
+
+struct DracoAttribute {
+    // Id referenced by the glTF extension's attributes map
+    int unique_id = 0;
+    int num_components = 0;
+    // num_components floats per point, dequantized or converted from integers
+    std::vector<float> values;
+};
+
+struct DracoMesh {
+    size_t num_points = 0;
+    // Three point indices per triangle
+    std::vector<uint32_t> faces;
+    std::vector<DracoAttribute> attributes;
+
+    const DracoAttribute *attribute(int unique_id) const;
+};
+
+// Decodes a Draco mesh from size bytes at data. Returns false if data is
+// malformed or uses features this decoder doesn't support.
+bool DecodeDraco(const unsigned char *data, size_t size, DracoMesh &mesh);
@@ -9,11 +9,11 @@ void FrameBuffer::clear() {
     }
 }
 
-Color FrameBuffer::readColor(Coord2D coord) {
+Color FrameBuffer::readColor(Coord2D coord) const {
     return color_buffer[coord.y*width + coord.x];
 }
 
-float FrameBuffer::readDepth(Coord2D coord) {
+float FrameBuffer::readDepth(Coord2D coord) const {
     return depth_buffer[coord.y*width + coord.x];
 }
 
@@ -75,15 +75,15 @@ void FrameBuffer::DumpDepthPPMFile(std::string filename) {
     }
 }
 
-void FrameBuffer::update_surface(unsigned char *surface) {
-    for (int x = 0; x < width; x++) {
-        for (int y = 0; y < height; y++) {
-            int y1 = height-y; // Flip Y
-            int x1 = x;
-            surface[4*(width*y1 + x1) + 0] = readColor(Coord2D(x, y)).r;
-            surface[4*(width*y1 + x1) + 1] = readColor(Coord2D(x, y)).g;
-            surface[4*(width*y1 + x1) + 2] = readColor(Coord2D(x, y)).b;
-            surface[4*(width*y1 + x1) + 3] = 0;
+void FrameBuffer::update_surface(unsigned char *surface) const {
+    for (int y = 0; y < height; y++) {
+        int y1 = height-1-y; // Flip Y
+        for (int x = 0; x < width; x++) {
+            Color c = readColor(Coord2D(x, y));
+            surface[4*(width*y1 + x) + 0] = c.r;
+            surface[4*(width*y1 + x) + 1] = c.g;
+            surface[4*(width*y1 + x) + 2] = c.b;
+            surface[4*(width*y1 + x) + 3] = 0;
         }
     }
 }
\ No newline at end of file
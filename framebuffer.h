@@ -11,9 +11,9 @@ class FrameBuffer {
     void DumpDepthPPMFile(std::string filename);
     void writeColor(Coord2D coord, Color c);
     void writeDepth(Coord2D coord, float depth);
-    float readDepth(Coord2D coord);
-    Color readColor(Coord2D coord);
-    void update_surface(unsigned char *surface);
+    float readDepth(Coord2D coord) const;
+    Color readColor(Coord2D coord) const;
+    void update_surface(unsigned char *surface) const;
     int width;
     int height;
     int max_component_value = 255;
@@ -0,0 +1,435 @@
+#include "gltf.h"
+
+#include <iostream>
+
+static int texture_index(const json &object, const char *key) {
+    auto it = object.find(key);
+    if (it == object.end()) {
+        return -1;
+    }
+    return it->value("index", -1);
+}
+
+template <size_t N>
+static void read_floats(const json &object, const char *key, float (&values)[N]) {
+    auto it = object.find(key);
+    if (it == object.end()) {
+        return;
+    }
+    for (size_t i = 0; i < N && i < it->size(); i++) {
+        values[i] = (*it)[i];
+    }
+}
+
+// KHR_texture_transform of the textureInfo called key, if any
+static TextureTransform texture_transform(const json &object, const char *key) {
+    TextureTransform transform;
+    auto it = object.find(key);
+    if (it == object.end() || !it->contains("extensions")) {
+        return transform;
+    }
+    const json &extensions = (*it)["extensions"];
+    auto extension = extensions.find("KHR_texture_transform");
+    if (extension == extensions.end()) {
+        return transform;
+    }
+    float offset[2] = {0, 0};
+    float scale[2] = {1, 1};
+    read_floats(*extension, "offset", offset);
+    read_floats(*extension, "scale", scale);
+    transform.offset = float2(offset[0], offset[1]);
+    transform.scale = float2(scale[0], scale[1]);
+    transform.rotation = extension->value("rotation", 0.0f);
+    return transform;
+}
+
+static int num_components(const std::string &type) {
+    static const std::map<std::string, int> components = {
+        {"SCALAR", 1}, {"VEC2", 2}, {"VEC3", 3}, {"VEC4", 4}, {"MAT2", 4}, {"MAT3", 9}, {"MAT4", 16}};
+    auto it = components.find(type);
+    if (it == components.end()) {
+        std::cerr << "Unknown accessor type " << type << "\n";
+        exit(-1);
+    }
+    return it->second;
+}
+
+// Moves string value key out of object, data URIs can be megabytes long
+static std::string take_string(json &object, const char *key) {
+    auto it = object.find(key);
+    if (it == object.end() || !it->is_string()) {
+        return std::string();
+    }
+    return std::move(it->get_ref<std::string &>());
+}
+
+static GltfBuffer ParseBuffer(json &buffer_j) {
+    GltfBuffer buffer;
+    buffer.uri = take_string(buffer_j, "uri");
+    buffer.byte_length = buffer_j.value("byteLength", size_t(0));
+    return buffer;
+}
+
+static GltfMeshoptCompression ParseMeshoptCompression(const json &meshopt_j) {
+    static const std::map<std::string, MeshoptMode> modes = {
+        {"ATTRIBUTES", MeshoptMode::ATTRIBUTES}, {"TRIANGLES", MeshoptMode::TRIANGLES},
+        {"INDICES", MeshoptMode::INDICES}};
+    static const std::map<std::string, MeshoptFilter> filters = {
+        {"NONE", MeshoptFilter::NONE}, {"OCTAHEDRAL", MeshoptFilter::OCTAHEDRAL},
+        {"QUATERNION", MeshoptFilter::QUATERNION}, {"EXPONENTIAL", MeshoptFilter::EXPONENTIAL}};
+    GltfMeshoptCompression meshopt;
+    meshopt.buffer = meshopt_j.value("buffer", -1);
+    meshopt.byte_offset = meshopt_j.value("byteOffset", size_t(0));
+    meshopt.byte_length = meshopt_j.value("byteLength", size_t(0));
+    meshopt.byte_stride = meshopt_j.value("byteStride", size_t(0));
+    meshopt.count = meshopt_j.value("count", size_t(0));
+    auto mode = modes.find(meshopt_j.value("mode", "ATTRIBUTES"));
+    auto filter = filters.find(meshopt_j.value("filter", "NONE"));
+    if (mode == modes.end() || filter == filters.end()) {
+        std::cerr << "Unknown EXT_meshopt_compression mode or filter\n";
+        exit(-1);
+    }
+    meshopt.mode = mode->second;
+    meshopt.filter = filter->second;
+    return meshopt;
+}
+
+static GltfBufferView ParseBufferView(const json &buffer_view_j) {
+    GltfBufferView buffer_view;
+    buffer_view.buffer = buffer_view_j.value("buffer", -1);
+    buffer_view.byte_offset = buffer_view_j.value("byteOffset", size_t(0));
+    buffer_view.byte_length = buffer_view_j.value("byteLength", size_t(0));
+    buffer_view.byte_stride = buffer_view_j.value("byteStride", size_t(0));
+    auto extensions = buffer_view_j.find("extensions");
+    if (extensions != buffer_view_j.end()) {
+        auto meshopt = extensions->find("EXT_meshopt_compression");
+        if (meshopt != extensions->end()) {
+            buffer_view.meshopt = ParseMeshoptCompression(*meshopt);
+        }
+    }
+    return buffer_view;
+}
+
+static GltfAccessor ParseAccessor(const json &accessor_j) {
+    GltfAccessor accessor;
+    accessor.buffer_view = accessor_j.value("bufferView", -1);
+    accessor.byte_offset = accessor_j.value("byteOffset", size_t(0));
+    accessor.component_type = accessor_j.value("componentType", 0);
+    accessor.normalized = accessor_j.value("normalized", false);
+    accessor.count = accessor_j.value("count", size_t(0));
+    accessor.num_components = num_components(accessor_j.value("type", "SCALAR"));
+    auto sparse = accessor_j.find("sparse");
+    if (sparse != accessor_j.end()) {
+        accessor.sparse.count = sparse->value("count", size_t(0));
+        auto indices = sparse->find("indices");
+        auto values = sparse->find("values");
+        if (indices != sparse->end() && values != sparse->end()) {
+            accessor.sparse.indices_buffer_view = indices->value("bufferView", -1);
+            accessor.sparse.indices_byte_offset = indices->value("byteOffset", size_t(0));
+            accessor.sparse.indices_component_type = indices->value("componentType", 0);
+            accessor.sparse.values_buffer_view = values->value("bufferView", -1);
+            accessor.sparse.values_byte_offset = values->value("byteOffset", size_t(0));
+        } else {
+            accessor.sparse.count = 0;
+        }
+    }
+    return accessor;
+}
+
+static GltfImage ParseImage(json &image_j) {
+    GltfImage image;
+    image.uri = take_string(image_j, "uri");
+    image.buffer_view = image_j.value("bufferView", -1);
+    image.mime_type = image_j.value("mimeType", "");
+    return image;
+}
+
+static Sampler ParseSampler(const json &sampler_j) {
+    // Missing filters mean "auto", missing wrap modes default to REPEAT
+    return Sampler(sampler_j.value("magFilter", GL_LINEAR), sampler_j.value("minFilter", GL_LINEAR_MIPMAP_LINEAR),
+                   sampler_j.value("wrapS", GL_REPEAT), sampler_j.value("wrapT", GL_REPEAT));
+}
+
+static GltfTexture ParseTexture(const json &texture_j) {
+    GltfTexture texture;
+    texture.sampler = texture_j.value("sampler", -1);
+    texture.source = texture_j.value("source", -1);
+    return texture;
+}
+
+static GltfMaterial ParseMaterial(const json &material_j) {
+    GltfMaterial material;
+    material.name = material_j.value("name", "");
+    auto pbr = material_j.find("pbrMetallicRoughness");
+    if (pbr != material_j.end()) {
+        float base_color[4] = {1, 1, 1, 1};
+        read_floats(*pbr, "baseColorFactor", base_color);
+        material.base_color_factor = float4(base_color[0], base_color[1], base_color[2], base_color[3]);
+        material.metallic_factor = pbr->value("metallicFactor", 1.0f);
+        material.roughness_factor = pbr->value("roughnessFactor", 1.0f);
+        material.base_color_texture = texture_index(*pbr, "baseColorTexture");
+        material.base_color_transform = texture_transform(*pbr, "baseColorTexture");
+        material.metallic_roughness_texture = texture_index(*pbr, "metallicRoughnessTexture");
+    }
+    float emissive[3] = {0, 0, 0};
+    read_floats(material_j, "emissiveFactor", emissive);
+    material.emissive_factor = float3(emissive[0], emissive[1], emissive[2]);
+    material.normal_texture = texture_index(material_j, "normalTexture");
+    material.occlusion_texture = texture_index(material_j, "occlusionTexture");
+    material.emissive_texture = texture_index(material_j, "emissiveTexture");
+    return material;
+}
+
+static GltfPrimitive ParsePrimitive(const json &primitive_j) {
+    GltfPrimitive primitive;
+    auto attributes = primitive_j.find("attributes");
+    if (attributes != primitive_j.end()) {
+        for (auto it = attributes->begin(); it != attributes->end(); ++it) {
+            primitive.attributes[it.key()] = it.value();
+        }
+    }
+    primitive.indices = primitive_j.value("indices", -1);
+    primitive.material = primitive_j.value("material", -1);
+    primitive.mode = primitive_j.value("mode", 4);
+    auto targets = primitive_j.find("targets");
+    if (targets != primitive_j.end()) {
+        for (const json &target_j : *targets) {
+            std::map<std::string, int> target;
+            for (auto it = target_j.begin(); it != target_j.end(); ++it) {
+                target[it.key()] = it.value();
+            }
+            primitive.targets.push_back(std::move(target));
+        }
+    }
+    auto extensions = primitive_j.find("extensions");
+    if (extensions != primitive_j.end()) {
+        auto draco = extensions->find("KHR_draco_mesh_compression");
+        if (draco != extensions->end()) {
+            primitive.draco_buffer_view = draco->value("bufferView", -1);
+            auto draco_attributes = draco->find("attributes");
+            if (draco_attributes != draco->end()) {
+                for (auto it = draco_attributes->begin(); it != draco_attributes->end(); ++it) {
+                    primitive.draco_attributes[it.key()] = it.value();
+                }
+            }
+        }
+    }
+    return primitive;
+}
+
+static GltfMesh ParseMesh(const json &mesh_j) {
+    GltfMesh mesh;
+    mesh.name = mesh_j.value("name", "");
+    auto primitives = mesh_j.find("primitives");
+    if (primitives != mesh_j.end()) {
+        for (const json &primitive_j : *primitives) {
+            mesh.primitives.push_back(ParsePrimitive(primitive_j));
+        }
+    }
+    auto weights = mesh_j.find("weights");
+    if (weights != mesh_j.end()) {
+        mesh.weights = weights->get<std::vector<float>>();
+    }
+    return mesh;
+}
+
+static GltfNode ParseNode(const json &node_j) {
+    GltfNode node;
+    node.name = node_j.value("name", "");
+    auto children = node_j.find("children");
+    if (children != node_j.end()) {
+        node.children = children->get<std::vector<int>>();
+    }
+    node.mesh = node_j.value("mesh", -1);
+    node.camera = node_j.value("camera", -1);
+    node.skin = node_j.value("skin", -1);
+    node.has_matrix = node_j.contains("matrix");
+    read_floats(node_j, "matrix", node.matrix);
+    read_floats(node_j, "translation", node.translation);
+    read_floats(node_j, "rotation", node.rotation);
+    read_floats(node_j, "scale", node.scale);
+    auto weights = node_j.find("weights");
+    if (weights != node_j.end()) {
+        node.weights = weights->get<std::vector<float>>();
+    }
+    auto extensions = node_j.find("extensions");
+    if (extensions != node_j.end()) {
+        auto instancing = extensions->find("EXT_mesh_gpu_instancing");
+        if (instancing != extensions->end()) {
+            auto attributes = instancing->find("attributes");
+            if (attributes != instancing->end()) {
+                for (auto it = attributes->begin(); it != attributes->end(); ++it) {
+                    node.instancing_attributes[it.key()] = it.value();
+                }
+            }
+        }
+    }
+    return node;
+}
+
+static GltfScene ParseScene(const json &scene_j) {
+    GltfScene scene;
+    auto nodes = scene_j.find("nodes");
+    if (nodes != scene_j.end()) {
+        scene.nodes = nodes->get<std::vector<int>>();
+    }
+    return scene;
+}
+
+void AddGltfElement(GltfDocument &doc, const std::string &name, json &element) {
+    if (name == "buffers") {
+        doc.buffers.push_back(ParseBuffer(element));
+    } else if (name == "bufferViews") {
+        doc.buffer_views.push_back(ParseBufferView(element));
+    } else if (name == "accessors") {
+        doc.accessors.push_back(ParseAccessor(element));
+    } else if (name == "images") {
+        doc.images.push_back(ParseImage(element));
+    } else if (name == "samplers") {
+        doc.samplers.push_back(ParseSampler(element));
+    } else if (name == "textures") {
+        doc.textures.push_back(ParseTexture(element));
+    } else if (name == "materials") {
+        doc.materials.push_back(ParseMaterial(element));
+    } else if (name == "meshes") {
+        doc.meshes.push_back(ParseMesh(element));
+    } else if (name == "nodes") {
+        doc.nodes.push_back(ParseNode(element));
+    } else if (name == "scenes") {
+        doc.scenes.push_back(ParseScene(element));
+    } else if (name == "extensionsUsed") {
+        doc.extensions_used.push_back(element);
+    } else if (name == "extensionsRequired") {
+        doc.extensions_required.push_back(element);
+    }
+}
+
+GltfDocument ParseGltfDocument(json j) {
+    GltfDocument doc;
+    for (auto it = j.begin(); it != j.end(); ++it) {
+        if (it.value().is_array()) {
+            for (json &element : it.value()) {
+                AddGltfElement(doc, it.key(), element);
+            }
+        }
+    }
+    doc.scene = j.value("scene", -1);
+    return doc;
+}
+
+// SAX handler that builds a DOM for one element of a top-level array at a
+// time and converts it with AddGltfElement as soon as it is complete.
+// Everything outside of the top-level arrays, except for "scene", is skipped.
+class GltfSaxHandler : public json::json_sax_t {
+    public:
+    GltfSaxHandler(GltfDocument &_doc) : doc(_doc) {}
+
+    bool null() override { return value(json()); }
+    bool boolean(bool val) override { return value(json(val)); }
+    bool number_integer(number_integer_t val) override { return value(json(val)); }
+    bool number_unsigned(number_unsigned_t val) override { return value(json(val)); }
+    bool number_float(number_float_t val, const string_t &) override { return value(json(val)); }
+    bool string(string_t &val) override { return value(json(std::move(val))); }
+    bool binary(binary_t &) override { return true; }
+
+    bool start_object(size_t) override { return start(json::object()); }
+    bool end_object() override { return end(); }
+    bool start_array(size_t) override {
+        if (depth == 1 && stack.empty()) {
+            in_array = true;
+            depth++;
+            return true;
+        }
+        return start(json::array());
+    }
+    bool end_array() override {
+        if (depth == 2 && stack.empty()) {
+            in_array = false;
+            depth--;
+            return true;
+        }
+        return end();
+    }
+
+    bool key(string_t &val) override {
+        if (!stack.empty()) {
+            object_value = &(*stack.back())[val];
+        } else if (depth == 1) {
+            name = val;
+        }
+        return true;
+    }
+
+    bool parse_error(size_t position, const std::string &, const nlohmann::detail::exception &ex) override {
+        std::cerr << "Unable to parse glTF JSON at byte " << position << ": " << ex.what() << "\n";
+        return false;
+    }
+
+    private:
+    // True for a value that is (part of) an element of a top-level array
+    bool capturing() const { return !stack.empty() || (depth == 2 && in_array); }
+
+    json *add(json &&val) {
+        if (stack.empty()) {
+            element = std::move(val);
+            return &element;
+        }
+        if (stack.back()->is_array()) {
+            stack.back()->push_back(std::move(val));
+            return &stack.back()->back();
+        }
+        *object_value = std::move(val);
+        return object_value;
+    }
+
+    bool value(json &&val) {
+        if (!stack.empty()) {
+            add(std::move(val));
+        } else if (depth == 2 && in_array) {
+            AddGltfElement(doc, name, val);
+        } else if (depth == 1 && name == "scene" && val.is_number_integer()) {
+            doc.scene = val;
+        }
+        return true;
+    }
+
+    bool start(json &&val) {
+        if (capturing()) {
+            stack.push_back(add(std::move(val)));
+        }
+        depth++;
+        return true;
+    }
+
+    bool end() {
+        depth--;
+        if (!stack.empty()) {
+            stack.pop_back();
+            if (stack.empty()) {
+                AddGltfElement(doc, name, element);
+                element = json();
+            }
+        }
+        return true;
+    }
+
+    GltfDocument &doc;
+    // Nesting depth of the skipped containers, the root object is depth 1
+    int depth = 0;
+    // Current top-level key
+    std::string name;
+    bool in_array = false;
+    // DOM of the element being read and the containers open inside it
+    json element;
+    std::vector<json *> stack;
+    json *object_value = nullptr;
+};
+
+GltfDocument ParseGltfDocument(const unsigned char *data, size_t size) {
+    GltfDocument doc;
+    GltfSaxHandler handler(doc);
+    if (!json::sax_parse(data, data + size, &handler)) {
+        exit(-1);
+    }
+    return doc;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+#include "data_types.h"
+#include "texture.h"
+#include "meshopt.h"
+
+using json = nlohmann::json;
+
+// Typed glTF document. The JSON is converted in one pass and everything
+// after that (buffers, materials, scene nodes) reads these structures.
+// Objects refer to each other by index, -1 means absent.
+// https://registry.khronos.org/glTF/specs/2.0/glTF-2.0.html#properties-reference
+
+struct GltfBuffer {
+    // Empty for the BIN chunk of a GLB
+    std::string uri;
+    size_t byte_length = 0;
+};
+
+// EXT_meshopt_compression of a bufferView: the compressed bytes and how to
+// decode them into count elements of byte_stride bytes
+struct GltfMeshoptCompression {
+    // -1 if the bufferView isn't compressed
+    int buffer = -1;
+    size_t byte_offset = 0;
+    size_t byte_length = 0;
+    size_t byte_stride = 0;
+    size_t count = 0;
+    MeshoptMode mode = MeshoptMode::ATTRIBUTES;
+    MeshoptFilter filter = MeshoptFilter::NONE;
+};
+
+struct GltfBufferView {
+    int buffer = -1;
+    size_t byte_offset = 0;
+    size_t byte_length = 0;
+    // 0 means tightly packed
+    size_t byte_stride = 0;
+    GltfMeshoptCompression meshopt;
+};
+
+// Elements of a sparse accessor that differ from its base: count increasing
+// element indices and their values, each in a bufferView of its own
+// https://registry.khronos.org/glTF/specs/2.0/glTF-2.0.html#sparse-accessors
+struct GltfAccessorSparse {
+    // 0 if the accessor isn't sparse
+    size_t count = 0;
+    int indices_buffer_view = -1;
+    size_t indices_byte_offset = 0;
+    int indices_component_type = 0;
+    int values_buffer_view = -1;
+    size_t values_byte_offset = 0;
+};
+
+struct GltfAccessor {
+    // -1 means all elements are zero, apart from sparse ones
+    int buffer_view = -1;
+    size_t byte_offset = 0;
+    int component_type = 0;
+    bool normalized = false;
+    size_t count = 0;
+    // 1 for SCALAR up to 16 for MAT4
+    int num_components = 1;
+    GltfAccessorSparse sparse;
+};
+
+struct GltfImage {
+    std::string uri;
+    int buffer_view = -1;
+    std::string mime_type;
+};
+
+struct GltfTexture {
+    int sampler = -1;
+    int source = -1;
+};
+
+struct GltfMaterial {
+    std::string name;
+    float4 base_color_factor = float4(1, 1, 1, 1);
+    float metallic_factor = 1;
+    float roughness_factor = 1;
+    float3 emissive_factor = float3(0, 0, 0);
+    int base_color_texture = -1;
+    TextureTransform base_color_transform;
+    int metallic_roughness_texture = -1;
+    int normal_texture = -1;
+    int occlusion_texture = -1;
+    int emissive_texture = -1;
+};
+
+struct GltfPrimitive {
+    // Attribute semantic (POSITION, TEXCOORD_0, ...) to accessor
+    std::map<std::string, int> attributes;
+    int indices = -1;
+    int material = -1;
+    int mode = 4;
+    // KHR_draco_mesh_compression: bufferView of the compressed mesh and
+    // attribute semantic to Draco attribute id, -1 if not compressed
+    int draco_buffer_view = -1;
+    std::map<std::string, int> draco_attributes;
+    // Morph targets, attribute semantic to accessor of displacements
+    std::vector<std::map<std::string, int>> targets;
+    int attribute(const std::string &name) const {
+        auto it = attributes.find(name);
+        return (it == attributes.end()) ? -1 : it->second;
+    }
+};
+
+struct GltfMesh {
+    std::string name;
+    std::vector<GltfPrimitive> primitives;
+    // Default morph target weights
+    std::vector<float> weights;
+};
+
+struct GltfNode {
+    std::string name;
+    std::vector<int> children;
+    int mesh = -1;
+    int camera = -1;
+    int skin = -1;
+    // Either matrix (column-major, as stored in glTF) or TRS
+    bool has_matrix = false;
+    float matrix[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    float translation[3] = {0, 0, 0};
+    float rotation[4] = {0, 0, 0, 1};
+    float scale[3] = {1, 1, 1};
+    // Morph target weights overriding those of the mesh, empty if none
+    std::vector<float> weights;
+    // EXT_mesh_gpu_instancing: TRANSLATION, ROTATION and SCALE accessors
+    // with one element per instance of the mesh, empty if not instanced
+    std::map<std::string, int> instancing_attributes;
+};
+
+struct GltfScene {
+    std::vector<int> nodes;
+};
+
+struct GltfDocument {
+    std::vector<GltfBuffer> buffers;
+    std::vector<GltfBufferView> buffer_views;
+    std::vector<GltfAccessor> accessors;
+    std::vector<GltfImage> images;
+    std::vector<Sampler> samplers;
+    std::vector<GltfTexture> textures;
+    std::vector<GltfMaterial> materials;
+    std::vector<GltfMesh> meshes;
+    std::vector<GltfNode> nodes;
+    std::vector<GltfScene> scenes;
+    int scene = -1;
+    std::vector<std::string> extensions_used;
+    std::vector<std::string> extensions_required;
+};
+
+// Convert a parsed glTF JSON document
+GltfDocument ParseGltfDocument(json j);
+// Parse glTF JSON text without building a DOM of the whole document, only
+// one element of a top-level array (a node, an accessor, ...) is held as
+// json at a time
+GltfDocument ParseGltfDocument(const unsigned char *data, size_t size);
+// Convert one element of the top-level array called name (e.g. "nodes")
+// and append it to doc. Unknown arrays are ignored. Long strings (URIs) are
+// moved out of element.
+void AddGltfElement(GltfDocument &doc, const std::string &name, json &element);
@@ -0,0 +1,241 @@
+#include "gltf_buffer.h"
+#include "mapped_file.h"
+#include "uri.h"
+
+#include <algorithm>
+
+static const uint32_t GLB_MAGIC = 0x46546c67;       // "glTF"
+static const uint32_t GLB_CHUNK_JSON = 0x4e4f534a;  // "JSON"
+static const uint32_t GLB_CHUNK_BIN = 0x004e4942;   // "BIN\0"
+
+static uint32_t read_u32(const unsigned char *data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+void ReadGltfFile(const std::string &path, GltfDocument &doc, BufferData &glb_bin) {
+    std::shared_ptr<MappedFile> file = MappedFile::open(path);
+    if (file == nullptr) {
+        std::cerr << "Unable to open " << path << "\n";
+        exit(-1);
+    }
+    const unsigned char *data = file->data();
+    size_t size = file->size();
+    if (size < 12 || read_u32(data) != GLB_MAGIC) {
+        doc = ParseGltfDocument(data, size);
+        return;
+    }
+    uint32_t version = read_u32(data + 4);
+    uint32_t length = read_u32(data + 8);
+    if (version != 2 || length > size) {
+        std::cerr << "Unsupported or truncated GLB " << path << "\n";
+        exit(-1);
+    }
+    bool has_json = false;
+    size_t offset = 12;
+    while (offset + 8 <= length) {
+        uint32_t chunk_length = read_u32(data + offset);
+        uint32_t chunk_type = read_u32(data + offset + 4);
+        const unsigned char *chunk = data + offset + 8;
+        if (offset + 8 + chunk_length > length) {
+            std::cerr << "Truncated GLB chunk in " << path << "\n";
+            exit(-1);
+        }
+        if (chunk_type == GLB_CHUNK_JSON && !has_json) {
+            doc = ParseGltfDocument(chunk, chunk_length);
+            has_json = true;
+        } else if (chunk_type == GLB_CHUNK_BIN && glb_bin.storage == nullptr) {
+            glb_bin.data = chunk;
+            glb_bin.size = chunk_length;
+            glb_bin.storage = file;
+        }
+        // Unknown chunks are skipped, chunks are 4 byte aligned
+        offset += 8 + ((chunk_length + 3) & ~size_t(3));
+    }
+    if (!has_json) {
+        std::cerr << "GLB without JSON chunk " << path << "\n";
+        exit(-1);
+    }
+}
+
+std::vector<std::string> GltfReferencedFiles(const GltfDocument &doc, const std::string &base_path) {
+    std::vector<std::string> uris;
+    for (const GltfBuffer &buffer : doc.buffers) {
+        uris.push_back(buffer.uri);
+    }
+    for (const GltfImage &image : doc.images) {
+        uris.push_back(image.uri);
+    }
+    std::vector<std::string> files;
+    for (const std::string &uri : uris) {
+        if (uri.empty() || is_data_uri(uri)) {
+            continue;
+        }
+        std::string path = base_path + uri;
+        if (std::find(files.begin(), files.end(), path) == files.end()) {
+            files.push_back(path);
+        }
+    }
+    return files;
+}
+
+const BufferData &GltfBuffers::buffer(int buffer_id) {
+    BufferData &buffer = buffers[buffer_id];
+    if (buffer.storage != nullptr) {
+        return buffer;
+    }
+    const std::string &uri = doc.buffers[buffer_id].uri;
+    if (uri.empty()) {
+        if (glb_bin.storage == nullptr) {
+            std::cerr << "Buffer " << buffer_id << " has no uri and there is no GLB BIN chunk\n";
+            exit(-1);
+        }
+        buffer = glb_bin;
+        return buffer;
+    }
+    if (is_data_uri(uri)) {
+        auto bytes = std::make_shared<std::vector<unsigned char>>(decode_data_uri(uri));
+        buffer.data = bytes->data();
+        buffer.size = bytes->size();
+        buffer.storage = bytes;
+        return buffer;
+    }
+    std::shared_ptr<MappedFile> file = MappedFile::open(base_path + uri);
+    if (file == nullptr) {
+        std::cerr << "Unable to open buffer " << base_path + uri << "\n";
+        exit(-1);
+    }
+    buffer.data = file->data();
+    buffer.size = file->size();
+    buffer.storage = file;
+    return buffer;
+}
+
+BufferData GltfBuffers::buffer_view(int buffer_view_id) {
+    if (buffer_view_id < 0 || size_t(buffer_view_id) >= doc.buffer_views.size()) {
+        std::cerr << "Buffer view " << buffer_view_id << " doesn't exist\n";
+        exit(-1);
+    }
+    const GltfBufferView &buffer_view = doc.buffer_views[buffer_view_id];
+    const GltfMeshoptCompression &meshopt = buffer_view.meshopt;
+    if (meshopt.buffer != -1) {
+        BufferData &decoded = decoded_views[buffer_view_id];
+        if (decoded.storage == nullptr) {
+            const BufferData &compressed = buffer(meshopt.buffer);
+            auto bytes = std::make_shared<std::vector<unsigned char>>(meshopt.count*meshopt.byte_stride);
+            if (meshopt.byte_offset + meshopt.byte_length > compressed.size ||
+                !DecodeMeshopt(bytes->data(), meshopt.count, meshopt.byte_stride, meshopt.mode, meshopt.filter,
+                               compressed.data + meshopt.byte_offset, meshopt.byte_length)) {
+                std::cerr << "Unable to decode EXT_meshopt_compression buffer view " << buffer_view_id << "\n";
+                exit(-1);
+            }
+            decoded.data = bytes->data();
+            decoded.size = bytes->size();
+            decoded.storage = bytes;
+        }
+        return decoded;
+    }
+    const BufferData &data = buffer(buffer_view.buffer);
+    size_t offset = buffer_view.byte_offset;
+    size_t length = buffer_view.byte_length;
+    if (offset + length > data.size) {
+        std::cerr << "Buffer view " << buffer_view_id << " is out of bounds of its buffer\n";
+        exit(-1);
+    }
+    BufferData view;
+    view.data = data.data + offset;
+    view.size = length;
+    view.storage = data.storage;
+    return view;
+}
+
+const unsigned char *GltfBuffers::element_data(int accessor_id, size_t &stride, std::shared_ptr<const void> &storage) {
+    const GltfAccessor &accessor = doc.accessors[accessor_id];
+    size_t element_size = ComponentSize(accessor.component_type)*accessor.num_components;
+    if (accessor.buffer_view == -1) {
+        stride = element_size;
+        return nullptr;
+    }
+    const GltfBufferView &buffer_view = doc.buffer_views[accessor.buffer_view];
+    BufferData data = this->buffer_view(accessor.buffer_view);
+    stride = (buffer_view.byte_stride != 0) ? buffer_view.byte_stride : element_size;
+    size_t offset = accessor.byte_offset;
+    if (accessor.count > 0 && offset + (accessor.count - 1)*stride + element_size > data.size) {
+        std::cerr << "Accessor " << accessor_id << " is out of bounds of its buffer view\n";
+        exit(-1);
+    }
+    storage = data.storage;
+    return data.data + offset;
+}
+
+std::vector<uint32_t> GltfBuffers::sparse_indices(int accessor_id) {
+    const GltfAccessor &accessor = doc.accessors[accessor_id];
+    const GltfAccessorSparse &sparse = accessor.sparse;
+    BufferData data = buffer_view(sparse.indices_buffer_view);
+    size_t index_size = ComponentSize(sparse.indices_component_type);
+    if (sparse.indices_byte_offset + sparse.count*index_size > data.size) {
+        std::cerr << "Sparse indices of accessor " << accessor_id << " are out of bounds of their buffer view\n";
+        exit(-1);
+    }
+    const unsigned char *bytes = data.data + sparse.indices_byte_offset;
+    std::vector<uint32_t> indices(sparse.count);
+    for (size_t i = 0; i < sparse.count; i++) {
+        if (sparse.indices_component_type == GL_UNSIGNED_BYTE) {
+            indices[i] = bytes[i];
+        } else if (sparse.indices_component_type == GL_UNSIGNED_SHORT) {
+            uint16_t index;
+            memcpy(&index, bytes + i*sizeof(index), sizeof(index));
+            indices[i] = index;
+        } else {
+            memcpy(&indices[i], bytes + i*sizeof(uint32_t), sizeof(uint32_t));
+        }
+        if (indices[i] >= accessor.count || (i > 0 && indices[i] <= indices[i - 1])) {
+            std::cerr << "Sparse indices of accessor " << accessor_id << " are not increasing or out of range\n";
+            exit(-1);
+        }
+    }
+    return indices;
+}
+
+const unsigned char *GltfBuffers::sparse_values(int accessor_id) {
+    const GltfAccessor &accessor = doc.accessors[accessor_id];
+    const GltfAccessorSparse &sparse = accessor.sparse;
+    BufferData data = buffer_view(sparse.values_buffer_view);
+    size_t element_size = ComponentSize(accessor.component_type)*accessor.num_components;
+    if (sparse.values_byte_offset + sparse.count*element_size > data.size) {
+        std::cerr << "Sparse values of accessor " << accessor_id << " are out of bounds of their buffer view\n";
+        exit(-1);
+    }
+    return data.data + sparse.values_byte_offset;
+}
+
+VertexAttribute GltfBuffers::attribute(int accessor_id) {
+    const GltfAccessor &accessor = doc.accessors[accessor_id];
+    VertexAttribute attribute;
+    attribute.component_type = accessor.component_type;
+    attribute.normalized = accessor.normalized;
+    attribute.num_components = accessor.num_components;
+    size_t stride;
+    std::shared_ptr<const void> storage;
+    const unsigned char *data = element_data(accessor_id, stride, storage);
+    // Quantized attributes are usually padded to 4 bytes, the padding is
+    // dropped
+    size_t element_size = attribute.element_size();
+    attribute.data.resize(accessor.count*element_size);
+    if (data == nullptr) {
+        memset(attribute.data.data(), 0, attribute.data.size());
+    } else {
+        for (size_t i = 0; i < accessor.count; i++) {
+            memcpy(attribute.data.data() + i*element_size, data + i*stride, element_size);
+        }
+    }
+    if (accessor.sparse.count > 0) {
+        std::vector<uint32_t> indices = sparse_indices(accessor_id);
+        const unsigned char *values = sparse_values(accessor_id);
+        for (size_t i = 0; i < indices.size(); i++) {
+            memcpy(attribute.data.data() + indices[i]*element_size, values + i*element_size, element_size);
+        }
+    }
+    return attribute;
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gltf.h"
+#include "mesh.h"
+
+// Bytes of one glTF buffer. storage keeps them alive: a mapping of the .bin
+// file, or the decoded payload of a data URI.
+struct BufferData {
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+    std::shared_ptr<const void> storage;
+};
+
+// Typed view of an accessor's elements inside a buffer, stride bytes apart.
+// Elements are read with memcpy so views don't depend on the alignment of
+// the data.
+// A sparse accessor is kept as its base view plus the elements that differ
+// from it, so memory stays proportional to the number of changed elements
+// until to_vector() materializes it.
+template <typename T>
+struct AccessorView {
+    // Null if the accessor has no bufferView, its base elements are zero
+    const unsigned char *data = nullptr;
+    size_t count = 0;
+    size_t stride = sizeof(T);
+    // Keeps the buffer alive for as long as the view
+    std::shared_ptr<const void> storage;
+    // Element sparse_indices[i] is sparse_values[i], indices are increasing
+    std::vector<uint32_t> sparse_indices;
+    std::vector<T> sparse_values;
+
+    size_t size() const { return count; }
+    bool sparse() const { return !sparse_indices.empty(); }
+    // Element i ignoring the sparse values
+    T base(size_t i) const {
+        T value;
+        if (data == nullptr) {
+            memset(&value, 0, sizeof(T));
+        } else {
+            memcpy(&value, data + i*stride, sizeof(T));
+        }
+        return value;
+    }
+    T operator[](size_t i) const {
+        if (sparse()) {
+            auto it = std::lower_bound(sparse_indices.begin(), sparse_indices.end(), i);
+            if (it != sparse_indices.end() && *it == i) {
+                return sparse_values[it - sparse_indices.begin()];
+            }
+        }
+        return base(i);
+    }
+    // Copy into a vector, a single memcpy for tightly packed accessors
+    std::vector<T> to_vector() const {
+        std::vector<T> values(count);
+        if (data == nullptr) {
+            memset(values.data(), 0, count*sizeof(T));
+        } else if (stride == sizeof(T)) {
+            memcpy(values.data(), data, count*sizeof(T));
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                values[i] = base(i);
+            }
+        }
+        for (size_t i = 0; i < sparse_indices.size(); i++) {
+            values[sparse_indices[i]] = sparse_values[i];
+        }
+        return values;
+    }
+};
+
+// Reads a .gltf or .glb file into doc. The JSON is parsed straight from the
+// file mapping without building a DOM. A GLB's BIN chunk, if present, is
+// returned in glb_bin without copying.
+// https://registry.khronos.org/glTF/specs/2.0/glTF-2.0.html#binary-gltf-layout
+void ReadGltfFile(const std::string &path, GltfDocument &doc, BufferData &glb_bin);
+
+// Paths of the external files doc references, i.e. buffers and images that
+// are neither data URIs nor stored in a GLB, relative to base_path
+std::vector<std::string> GltfReferencedFiles(const GltfDocument &doc, const std::string &base_path);
+
+// The buffers of one glTF file. Each buffer is mapped (or decoded) at most
+// once, the first time one of its accessors is read, and shared by all
+// views into it. A buffer without a uri is the BIN chunk of a GLB.
+// Not thread safe.
+class GltfBuffers {
+    public:
+    GltfBuffers(const GltfDocument &_doc, const std::string &_base_path, BufferData _glb_bin = BufferData()) :
+        doc(_doc), base_path(_base_path), glb_bin(_glb_bin), buffers(_doc.buffers.size()),
+        decoded_views(_doc.buffer_views.size()) {}
+
+    const BufferData &buffer(int buffer_id);
+    // Bytes of a bufferView, e.g. an image stored in a GLB. Views compressed
+    // with EXT_meshopt_compression are decoded the first time they are read.
+    BufferData buffer_view(int buffer_view_id);
+
+    // View of accessor_id, whose elements must be sizeof(T) bytes
+    template <typename T>
+    AccessorView<T> accessor(int accessor_id) {
+        const GltfAccessor &accessor = doc.accessors[accessor_id];
+        if (ComponentSize(accessor.component_type)*accessor.num_components != sizeof(T)) {
+            std::cerr << "Accessor " << accessor_id << " elements are not " << sizeof(T) << " bytes\n";
+            exit(-1);
+        }
+        AccessorView<T> view;
+        view.data = element_data(accessor_id, view.stride, view.storage);
+        view.count = accessor.count;
+        if (accessor.sparse.count > 0) {
+            view.sparse_indices = sparse_indices(accessor_id);
+            const unsigned char *values = sparse_values(accessor_id);
+            view.sparse_values.resize(accessor.sparse.count);
+            memcpy(view.sparse_values.data(), values, accessor.sparse.count*sizeof(T));
+        }
+        return view;
+    }
+
+    // Elements of accessor_id, tightly packed in their own component type.
+    // Sparse accessors are materialized.
+    VertexAttribute attribute(int accessor_id);
+
+    private:
+    // First element of accessor_id, sets stride and the buffer's storage.
+    // Null if the accessor has no bufferView.
+    const unsigned char *element_data(int accessor_id, size_t &stride, std::shared_ptr<const void> &storage);
+    // Indices of the sparse elements of accessor_id, checked to be
+    // increasing and in range
+    std::vector<uint32_t> sparse_indices(int accessor_id);
+    // Tightly packed values of the sparse elements of accessor_id, valid as
+    // long as the buffers
+    const unsigned char *sparse_values(int accessor_id);
+
+    const GltfDocument &doc;
+    std::string base_path;
+    BufferData glb_bin;
+    std::vector<BufferData> buffers;
+    std::vector<BufferData> decoded_views;
+};
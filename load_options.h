@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+class TextureStreamer;
+
+// Settings for create_scene_from_gltf and the loaders it calls
+struct LoadOptions {
+    // Directory of the persistent decoded-texture cache, empty disables it
+    std::string texture_cache_dir = ".texture_cache";
+    // Store textures as BC1 (opaque) or BC3 blocks, 8x/4x smaller than
+    // RGBA8. Encoding happens once per image, the disk cache keeps the blocks.
+    bool compress_textures = false;
+    // When set, textures are registered with the streamer and start out on
+    // a placeholder instead of being loaded before the scene is returned.
+    // Streamed images bypass the AssetCache so dropped levels are released.
+    TextureStreamer *texture_streamer = nullptr;
+    // Deduplicate vertices and reorder triangles and vertices for the vertex
+    // cache, overdraw and fetch locality (see mesh_optimizer.h). Done once
+    // per mesh, optimized meshes are cached under their own keys.
+    bool optimize_meshes = false;
+    // Split meshes into meshlets so whole clusters of triangles off screen
+    // or facing away are culled before their vertices are transformed
+    bool build_meshlets = false;
+};
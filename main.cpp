@@ -15,6 +15,23 @@
 #include "mesh.h"
 #include "model.h"
 #include "scene.h"
+#include "asset_cache.h"
+#include "swapchain.h"
+#include "texture_streamer.h"
+#include "scene_bake.h"
+
+// Written by running with --bake, loaded instead of the glTF files while
+// they and the buffers and images they reference are unchanged
+static const char *BAKED_SCENE = "scene.bsn";
+
+// Start loading the files of the scene, each placed by its root node. The
+// Duck's own nodes scale it down to the size of the box.
+void load_scene(Scene &scn, SceneLoader &loader, const LoadOptions &options) {
+    int box = loader.load("glTF-Sample-Models/2.0/BoxTextured/glTF/", "BoxTextured.gltf", options);
+    scn.graph.set_translation(box, float3(-0.5, 0.0, 0.0));
+    int duck = loader.load("glTF-Sample-Models/2.0/Duck/glTF/", "Duck.gltf", options);
+    scn.graph.set_translation(duck, float3(0.5, -2.0, 0.0));
+}
 
 void game_loop() {
     int width = 500;
@@ -23,21 +40,38 @@ void game_loop() {
     // Create Scene
     Camera cam;
 
-    Scene scn0 = create_scene_from_gltf("glTF-Sample-Models/2.0/BoxTextured/glTF/", "BoxTextured.gltf");
-    scn0.models[0]->transform = translationMatrix(-0.5, 0.0, 0.0)*scalingMatrix(1.0, 1.0, 1.0);
-    Scene scn1 = create_scene_from_gltf("glTF-Sample-Models/2.0/Duck/glTF/", "Duck.gltf");
-    scn1.models[0]->transform = translationMatrix(0.5, -2.0, 0.0)*scalingMatrix(0.01, 0.01, 0.01);
+    // Textures start with their coarse mips and stream in finer ones as needed
+    TextureStreamer texture_streamer(256 << 20);
+    LoadOptions options;
+    options.texture_streamer = &texture_streamer;
+    options.optimize_meshes = true;
+    options.build_meshlets = true;
+
+    // A baked scene has fully resident textures mapped from the file, they
+    // are not streamed. Otherwise the scene loads in the background and
+    // models show up as they are ready.
     Scene scn;
-    scn.models.insert(scn.models.end(), scn0.models.begin(), scn0.models.end());
-    scn.models.insert(scn.models.end(), scn1.models.begin(), scn1.models.end());
+    SceneLoader loader(scn);
+    if (LoadBakedScene(BAKED_SCENE, scn)) {
+        std::cout << "Loaded baked scene " << BAKED_SCENE << "\n";
+    } else {
+        load_scene(scn, loader, options);
+    }
+    std::cout << "Asset cache holds " << AssetCache::instance().size() << " assets, "
+              << AssetCache::instance().memory_usage() << " bytes\n";
     scn.projection_matrix = perspectiveProjectionMatrix(0.1, 10.0, M_PI_2*3/2, M_PI_2*3/2);
     // scn.projection_matrix = orthographicProjectionMatrix(5.0, 5.0, 0, 5.0);
     
-    FrameBuffer fb = FrameBuffer(width, height);
-
     Window w(width, height);
     w.create();
 
+    // Present thread copies finished frames into the window's back surface
+    // while the next frame is being rendered, then swaps it in for the view
+    SwapChain swapchain(width, height, 3, PresentMode::MAILBOX, [&w](const FrameBuffer &fb) {
+        fb.update_surface(w.back_surface);
+        w.swap_surfaces();
+    });
+
     auto start_time = std::chrono::system_clock::now();
     auto curr_time = std::chrono::system_clock::now();
     int num_frames = 0;
@@ -46,13 +80,18 @@ void game_loop() {
         EventRecord e = w.process_events();
         // Send record of events to camera to update
         cam.update(e);
+        // Add whatever finished loading since the last frame
+        loader.update();
         // update scene using updated camera
         scn.update(cam);
-        // render scene
-        scn.Render(fb);
-        // Update the window surface with new contents from the fb
-        fb.update_surface(w.surface);
-        // Tell view to present the new surface
+        // Apply last frame's texture feedback before rendering the next one
+        texture_streamer.update();
+        // render scene into a free buffer of the swapchain
+        scn.Render(swapchain.acquire());
+        // Queue it to be copied into the window surface
+        swapchain.submit();
+        // Tell view to present the newest surface the present thread
+        // finished copying, if there is one
         w.present();
         // Reset the record to process new keyboard events
         w.reset_record();
@@ -66,9 +105,21 @@ void game_loop() {
             start_time = std::chrono::system_clock::now();
         }
     }    
+    swapchain.flush();
     w.destroy();
 }
 
-int main() {
+int main(int argc, char **argv) {
+    // --bake loads the scene without streaming and writes it for later runs
+    if (argc > 1 && std::string(argv[1]) == "--bake") {
+        LoadOptions options;
+        options.optimize_meshes = true;
+        options.build_meshlets = true;
+        Scene scn;
+        SceneLoader loader(scn);
+        load_scene(scn, loader, options);
+        loader.flush();
+        return BakeScene(scn, BAKED_SCENE, loader.sources()) ? 0 : -1;
+    }
     game_loop();
 } 
\ No newline at end of file
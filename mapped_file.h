@@ -0,0 +1,23 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages are only read from disk
+// when they are first touched.
+class MappedFile {
+    public:
+    // Returns nullptr if the file can't be opened or mapped
+    static std::shared_ptr<MappedFile> open(const std::string &path);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const unsigned char *data() const { return bytes; }
+    size_t size() const { return length; }
+
+    private:
+    MappedFile(const unsigned char *_bytes, size_t _length) : bytes(_bytes), length(_length) {}
+    const unsigned char *bytes;
+    size_t length;
+};
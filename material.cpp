@@ -1,112 +1,280 @@
 #include "material.h"
+#include "asset_cache.h"
+#include "block_compression.h"
+#include "texture_cache.h"
+#include "texture_streamer.h"
+#include "thread_pool.h"
+#include "uri.h"
 
-using json = nlohmann::json; 
+#include <stdexcept>
 
-// Create all samplers from json
-std::vector<std::shared_ptr<Sampler>> CreateSamplers(const json &j) {
-    std::vector<std::shared_ptr<Sampler>> samplers;
-    if (j["samplers"] == nullptr) {
-        return samplers;
-    }
-    for (auto sampler_j : j["samplers"]) {
-        std::cout << "Processing sampler " << sampler_j << "\n";
-        int mag_filter = sampler_j["magFilter"];   
-        int min_filter = sampler_j["minFilter"];   
-        int wrap_s = sampler_j["wrapS"];   
-        int wrap_t = sampler_j["wrapT"];
-        auto sampler = std::make_shared<Sampler>(mag_filter, min_filter, wrap_s, wrap_t);
-        samplers.push_back(sampler);  
-    }
-    return samplers;
+// Decode a PNG held in memory into an image with a full mip chain, block
+// compressed if requested. Images are decoded on the thread pool, so
+// failures throw instead of exiting on a worker.
+static std::shared_ptr<const Image> DecodeImage(const unsigned char *png, size_t png_size, const std::string &name,
+                                                bool compress) {
+    unsigned int width;
+    unsigned int height;
+    std::vector<unsigned char> bytes;
+    unsigned error = lodepng::decode(bytes, width, height, png, png_size);
+    if (error) {
+        throw std::runtime_error("Unable to decode image " + name + ": " + lodepng_error_text(error));
+    }
+    // lodepng decodes to tightly packed row-major RGBA
+    MipLevel base(width, height, reinterpret_cast<const RGBA8 *>(bytes.data()));
+    std::vector<MipLevel> levels = GenerateMipChain(std::move(base), false);
+    if (compress) {
+        // One format for the whole chain, chosen from the base level
+        TexelFormat format = ChooseBlockFormat(levels[0]);
+        for (MipLevel &level : levels) {
+            level = CompressLevel(level, format);
+        }
+    }
+    return std::make_shared<Image>(std::move(levels), false);
+}
+
+// Returns the decoded image from the disk cache if it has an up to date
+// entry, otherwise decodes it and stores the result for the next run. Cached
+// images start at first_level. A decoded image is the full chain, unless it
+// could be stored and mapped back from first_level on.
+static std::shared_ptr<const Image> LoadOrDecode(const std::string &key,
+                                                 const TextureDiskCache::SourceStamp &stamp,
+                                                 const TextureDiskCache *disk_cache,
+                                                 const std::function<std::shared_ptr<const Image>()> &decode,
+                                                 int first_level = 0) {
+    if (disk_cache != nullptr) {
+        std::shared_ptr<const Image> image = disk_cache->load(key, stamp, first_level);
+        if (image != nullptr) {
+            return image;
+        }
+    }
+    std::shared_ptr<const Image> image = decode();
+    if (disk_cache != nullptr) {
+        disk_cache->store(key, stamp, *image);
+        if (first_level > 0) {
+            // The finer levels are released with the decoded chain
+            std::shared_ptr<const Image> stored = disk_cache->load(key, stamp, first_level);
+            if (stored != nullptr) {
+                return stored;
+            }
+        }
+    }
+    return image;
+}
+
+// Where the encoded bytes of an image are: a file or data URI, or (for GLB)
+// a bufferView that has already been resolved to memory
+struct ImageLocation {
+    std::string uri;
+    BufferData bytes;
+};
+
+static ImageLocation LocateImage(const GltfImage &image, GltfBuffers &buffers) {
+    ImageLocation location;
+    if (image.buffer_view != -1) {
+        location.bytes = buffers.buffer_view(image.buffer_view);
+    } else {
+        location.uri = image.uri;
+    }
+    return location;
+}
+
+// Cache key of an image and a function decoding it, by path for files and
+// by content for embedded images. Compressed images get their own keys.
+struct ImageSource {
+    std::string key;
+    TextureDiskCache::SourceStamp stamp;
+    std::function<std::shared_ptr<const Image>()> decode;
+};
+
+static ImageSource GetImageSource(const ImageLocation &location, const std::string &base_path, bool compress) {
+    std::string suffix = compress ? "#bc" : "";
+    ImageSource source;
+    if (location.bytes.storage != nullptr) {
+        // Decoded straight from the buffer, which the lambda keeps mapped
+        BufferData bytes = location.bytes;
+        source.key = AssetCache::content_key(bytes.data, bytes.size) + suffix;
+        source.decode = [bytes, compress]() {
+            return DecodeImage(bytes.data, bytes.size, "<buffer view>", compress);
+        };
+        return source;
+    }
+    if (is_data_uri(location.uri)) {
+        auto png = std::make_shared<std::vector<unsigned char>>(decode_data_uri(location.uri));
+        source.key = AssetCache::content_key(png->data(), png->size()) + suffix;
+        source.decode = [png, compress]() {
+            return DecodeImage(png->data(), png->size(), "<data uri>", compress);
+        };
+        return source;
+    }
+    std::string image_path = base_path + location.uri;
+    source.key = AssetCache::path_key(image_path) + suffix;
+    source.stamp = TextureDiskCache::stamp_file(image_path);
+    source.decode = [image_path, compress]() {
+        std::vector<unsigned char> png;
+        unsigned error = lodepng::load_file(png, image_path);
+        if (error) {
+            throw std::runtime_error("Unable to open file " + image_path + ": " + lodepng_error_text(error));
+        }
+        return DecodeImage(png.data(), png.size(), image_path, compress);
+    };
+    return source;
+}
+
+// Load an image through the asset cache and the disk cache
+static std::shared_ptr<const Image> LoadImage(const ImageLocation &location, const std::string &base_path,
+                                              const TextureDiskCache *disk_cache, bool compress) {
+    ImageSource source = GetImageSource(location, base_path, compress);
+    return AssetCache::instance().get_image(source.key, [&]() {
+        return LoadOrDecode(source.key, source.stamp, disk_cache, source.decode);
+    });
+}
+
+// Size of a PNG from its header, without decoding it. Throws like
+// DecodeImage, it runs on the pool when a SceneLoader creates the materials.
+static void ReadImageSize(const ImageLocation &location, const std::string &base_path,
+                          unsigned int &width, unsigned int &height) {
+    std::vector<unsigned char> png;
+    if (location.bytes.storage != nullptr) {
+        png.assign(location.bytes.data, location.bytes.data + std::min(location.bytes.size, size_t(33)));
+    } else if (is_data_uri(location.uri)) {
+        png = decode_data_uri(location.uri);
+    } else {
+        // Signature and IHDR chunk
+        png.resize(33);
+        std::ifstream file(base_path + location.uri, std::ios::binary);
+        file.read(reinterpret_cast<char *>(png.data()), png.size());
+        png.resize(file.gcount());
+    }
+    lodepng::State state;
+    unsigned error = lodepng_inspect(&width, &height, &state, png.data(), png.size());
+    if (error) {
+        throw std::runtime_error("Unable to read image header " + location.uri + ": " + lodepng_error_text(error));
+    }
 }
 
-// Create all textures from json
-std::vector<std::shared_ptr<Texture>> CreateTextures(const json &j, const std::string &base_path) {
+// Create all textures of doc, see CreateMaterials for pending_images
+std::vector<std::shared_ptr<Texture>> CreateTextures(const GltfDocument &doc, const std::string &base_path,
+                                                     GltfBuffers &buffers, const LoadOptions &options,
+                                                     std::vector<PendingImage> *pending_images) {
     std::vector<std::shared_ptr<Texture>> textures;
-    if (j["textures"] == nullptr) {
-        return textures;
+    std::vector<std::shared_ptr<Sampler>> samplers;
+    for (const Sampler &sampler : doc.samplers) {
+        samplers.push_back(std::make_shared<Sampler>(sampler));
     }
-    auto samplers = CreateSamplers(j);
     std::shared_ptr<Sampler> default_sampler = std::make_shared<Sampler>();
-    auto images_j = j["images"];
-    for (auto texture_j : j["textures"]) {
-        std::cout << "Processing texture - " << texture_j << "\n";
-        // Find sampler
-        std::shared_ptr<Sampler> sampler(nullptr);
-        if (texture_j["sampler"] != nullptr) {
-            int sampler_id = texture_j["sampler"];
-            sampler = samplers[sampler_id];
-        } else {
-            sampler = default_sampler;
+    std::shared_ptr<TextureDiskCache> disk_cache(nullptr);
+    if (!options.texture_cache_dir.empty()) {
+        disk_cache = std::make_shared<TextureDiskCache>(options.texture_cache_dir);
+    }
+
+    auto find_sampler = [&](const GltfTexture &texture) {
+        return (texture.sampler != -1) ? samplers[texture.sampler] : default_sampler;
+    };
+    for (const GltfTexture &texture : doc.textures) {
+        if (texture.source == -1) {
+            std::cerr << "No texture source provided\n";
+            exit(-1);
         }
-        // Load texture data from image
-        if (texture_j["source"] != nullptr) {
-            unsigned int width;
-            unsigned int height;
-            std::vector<unsigned char> bytes;
-            int image_id = texture_j["source"];
-            std::string uri = images_j[image_id]["uri"];
-            std::string image_path = base_path + uri;
-            unsigned error = lodepng::decode(bytes, width, height, image_path);
-            if (error) {
-                std::cerr << error << "\n";
-                std::cerr << "Unable to open file " << image_path << "\n";
-                exit(-1);
-            }
-            std::vector<float4> colors;
-            for (uint i = 0; i < width*height; i++) {
-                unsigned char r = bytes[i*4 + 0];
-                unsigned char g = bytes[i*4 + 1];
-                unsigned char b = bytes[i*4 + 2];
-                unsigned char a = bytes[i*4 + 3];
-                float4 color = float4(r, g, b, a)/256;
-                colors.push_back(color);
+    }
+
+    ThreadPool &pool = ThreadPool::shared();
+    if (options.texture_streamer != nullptr || pending_images != nullptr) {
+        // Textures sharing an image are loaded together. Only the image
+        // headers are read here, the levels are loaded in the background.
+        std::vector<std::vector<std::shared_ptr<Texture>>> image_textures(doc.images.size());
+        std::vector<std::pair<unsigned int, unsigned int>> image_sizes(doc.images.size());
+        std::vector<ImageLocation> locations(doc.images.size());
+        for (const GltfTexture &gltf_texture : doc.textures) {
+            int image_id = gltf_texture.source;
+            if (image_textures[image_id].empty()) {
+                locations[image_id] = LocateImage(doc.images[image_id], buffers);
+                ReadImageSize(locations[image_id], base_path, image_sizes[image_id].first, image_sizes[image_id].second);
             }
-            auto texture = std::make_shared<Texture>(width, height, colors, sampler);
+            auto texture = std::make_shared<Texture>(TextureStreamer::placeholder(), find_sampler(gltf_texture),
+                                                     image_sizes[image_id].first, image_sizes[image_id].second, 0);
+            image_textures[image_id].push_back(texture);
             textures.push_back(texture);
-        } else {
-            std::cerr << "No texture source provided\n";
-            exit(-1);
+        }
+        for (size_t i = 0; i < doc.images.size(); i++) {
+            if (image_textures[i].empty()) {
+                continue;
+            }
+            ImageLocation location = locations[i];
+            bool compress = options.compress_textures;
+            if (options.texture_streamer == nullptr) {
+                PendingImage pending;
+                pending.textures = image_textures[i];
+                pending.image = pool.submit([location, base_path, disk_cache, compress]() {
+                    return LoadImage(location, base_path, disk_cache.get(), compress);
+                });
+                pending_images->push_back(std::move(pending));
+                continue;
+            }
+            options.texture_streamer->add(image_textures[i], image_sizes[i].first, image_sizes[i].second,
+                                          [location, base_path, disk_cache, compress](int first_level) {
+                ImageSource source = GetImageSource(location, base_path, compress);
+                return LoadOrDecode(source.key, source.stamp, disk_cache.get(), source.decode, first_level);
+            });
+        }
+        return textures;
+    }
+
+    // Decode every image referenced by a texture exactly once, in parallel.
+    // Images shared by several textures (or already cached) are not decoded again.
+    std::vector<std::future<std::shared_ptr<const Image>>> pending(doc.images.size());
+    for (const GltfTexture &gltf_texture : doc.textures) {
+        int image_id = gltf_texture.source;
+        if (!pending[image_id].valid()) {
+            // Buffer views are resolved here, buffers are mapped on this thread
+            ImageLocation location = LocateImage(doc.images[image_id], buffers);
+            bool compress = options.compress_textures;
+            pending[image_id] = pool.submit([location, base_path, disk_cache, compress]() {
+                return LoadImage(location, base_path, disk_cache.get(), compress);
+            });
+        }
+    }
+    std::vector<std::shared_ptr<const Image>> images(doc.images.size());
+    for (size_t i = 0; i < images.size(); i++) {
+        if (pending[i].valid()) {
+            images[i] = pool.wait(pending[i]);
         }
     }
+
+    for (const GltfTexture &gltf_texture : doc.textures) {
+        auto texture = std::make_shared<Texture>(images[gltf_texture.source], find_sampler(gltf_texture));
+        textures.push_back(texture);
+    }
     return textures;
 }
 
-// Create all materials from json object
-std::vector<std::shared_ptr<Material>> CreateMaterials(const json &j, const std::string &base_path) {
+// Create all materials of doc
+std::vector<std::shared_ptr<Material>> CreateMaterials(const GltfDocument &doc, const std::string &base_path,
+                                                       GltfBuffers &buffers, const LoadOptions &options,
+                                                       std::vector<PendingImage> *pending_images) {
     std::vector<std::shared_ptr<Material>> materials;
     // early exit if materials don't exist in the gltf file
-    if (j["materials"] == nullptr) {
+    if (doc.materials.empty()) {
         return materials;
     }
-    auto textures = CreateTextures(j, base_path);
-    for (auto material_j : j["materials"]) {
-        std::cout << "Processing material - " << material_j << "\n";
+    auto textures = CreateTextures(doc, base_path, buffers, options, pending_images);
+    auto find_texture = [&](int texture_id) {
+        return (texture_id != -1) ? textures[texture_id] : nullptr;
+    };
+    for (const GltfMaterial &gltf_material : doc.materials) {
+        std::cout << "Processing material - " << gltf_material.name << "\n";
         auto material = std::make_shared<Material>();
-        // Process pbrMetallicRoughness
-        if (material_j["pbrMetallicRoughness"] != nullptr) {
-            auto pbrMetallicRoughness_j = material_j["pbrMetallicRoughness"];
-            material->metallic_factor = (pbrMetallicRoughness_j["metallicFactor"] == nullptr) ?
-                                            1.0 : pbrMetallicRoughness_j["metallicFactor"].get<float>();
-            material->roughness_factor = (pbrMetallicRoughness_j["roughnessFactor"] == nullptr) ?
-                                            1.0 : pbrMetallicRoughness_j["roughnessFactor"].get<float>();
-            if (pbrMetallicRoughness_j["baseColorTexture"] != nullptr) {
-                auto baseColorTexture_j = pbrMetallicRoughness_j["baseColorTexture"];
-                material->base_color_texture = textures[baseColorTexture_j["index"]];
-            }
-        }
+        material->base_color_factor = gltf_material.base_color_factor;
+        material->metallic_factor = gltf_material.metallic_factor;
+        material->roughness_factor = gltf_material.roughness_factor;
+        material->base_color_texture = find_texture(gltf_material.base_color_texture);
+        material->base_color_transform = gltf_material.base_color_transform;
+        material->metallic_roughness_factor = find_texture(gltf_material.metallic_roughness_texture);
+        material->normal_texture = find_texture(gltf_material.normal_texture);
+        material->occlusion_texture = find_texture(gltf_material.occlusion_texture);
+        material->emissive_factor = gltf_material.emissive_factor;
+        material->emissive_texture = find_texture(gltf_material.emissive_texture);
         materials.push_back(material);
-
     }
     return materials;
 }
-
-float4 Texture::Sample(const float2 &coord) {
-    float x = coord.x;
-    float y = coord.y;
-    int pix_x = x * width;
-    int pix_y = y * height;
-    
-    int pix_location = pix_y*width + pix_x;
-    return colors[pix_location];
-}
\ No newline at end of file
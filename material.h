@@ -1,34 +1,15 @@
 #pragma once
 
+#include <future>
 #include <iostream>
 #include <vector>
 
 // External dependencies
-#include "json.hpp"
 #include "lodepng.h"
 #include "data_types.h"
-
-using json = nlohmann::json;
-
-struct Sampler {
-    Sampler(int _mag_filter, int _min_filter, int _wrap_s, int _wrap_t) : 
-        mag_filter(_mag_filter), min_filter(_min_filter), wrap_s(_wrap_s), wrap_t(_wrap_t) {}
-    Sampler() {}
-    int mag_filter = 9728;  // NEAREST
-    int min_filter = 9728;  // NEAREST
-    int wrap_s = 10497;     // REPEAT
-    int wrap_t = 10497;     // REPEAT
-}; 
-
-struct Texture {
-    Texture(int _width, int _height, std::vector<float4> _colors, std::shared_ptr<Sampler> _sampler) :
-            width(_width), height(_height), colors(_colors), sampler(_sampler) {};
-    unsigned int width;
-    unsigned int height;
-    std::vector<float4> colors;
-    std::shared_ptr<Sampler> sampler;
-    float4 Sample(const float2 &coord);
-};
+#include "texture.h"
+#include "gltf_buffer.h"
+#include "load_options.h"
 
 // https://github.com/KhronosGroup/glTF/blob/master/specification/2.0/schema/material.pbrMetallicRoughness.schema.json
 class Material {
@@ -38,6 +19,7 @@ class Material {
     float metallic_factor = 1.0;
     float roughness_factor = 1.0;
     std::shared_ptr<Texture> base_color_texture = nullptr;
+    TextureTransform base_color_transform;
     std::shared_ptr<Texture> metallic_roughness_factor = nullptr;
     
     // material.normalTextureInfo.schema.json
@@ -51,5 +33,20 @@ class Material {
     std::shared_ptr<Texture> emissive_texture = nullptr;
 };
 
-// Create all materials from json object
-std::vector<std::shared_ptr<Material>> CreateMaterials(const json &j, const std::string &base_path);
\ No newline at end of file
+// An image still decoding on the thread pool and the textures showing
+// TextureStreamer::placeholder() in the meantime
+struct PendingImage {
+    std::vector<std::shared_ptr<Texture>> textures;
+    std::future<std::shared_ptr<const Image>> image;
+};
+
+// Create all materials of doc. Images are read relative to base_path or,
+// when stored in a bufferView, from buffers. If pending_images is given
+// (and textures are not streamed) images are decoded in the background
+// instead of being waited for, the textures start on a placeholder and the
+// caller installs the images once they are done. Images that can't be read
+// or decoded throw std::runtime_error, from the pending image's future or
+// the streamer's loads if they are decoded in the background.
+std::vector<std::shared_ptr<Material>> CreateMaterials(const GltfDocument &doc, const std::string &base_path,
+                                                       GltfBuffers &buffers, const LoadOptions &options,
+                                                       std::vector<PendingImage> *pending_images = nullptr);
\ No newline at end of file
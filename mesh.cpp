@@ -1,5 +1,107 @@
 #include "mesh.h"
 
+#include <algorithm>
+#include <cstring>
+
+size_t ComponentSize(int component_type) {
+    switch (component_type) {
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE:
+            return 1;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+            return 2;
+        case GL_UNSIGNED_INT:
+        case GL_FLOAT:
+            return 4;
+    }
+    std::cerr << "Unknown component type " << component_type << "\n";
+    exit(-1);
+}
+
+size_t VertexAttribute::element_size() const {
+    return ComponentSize(component_type)*num_components;
+}
+
+float VertexAttribute::component(size_t i, int c) const {
+    const uint8_t *ptr = data.data() + i*element_size() + c*ComponentSize(component_type);
+    switch (component_type) {
+        case GL_BYTE:
+            return *reinterpret_cast<const int8_t *>(ptr);
+        case GL_UNSIGNED_BYTE:
+            return *ptr;
+        case GL_SHORT: {
+            int16_t value;
+            memcpy(&value, ptr, sizeof(value));
+            return value;
+        }
+        case GL_UNSIGNED_SHORT: {
+            uint16_t value;
+            memcpy(&value, ptr, sizeof(value));
+            return value;
+        }
+        default: {
+            float value;
+            memcpy(&value, ptr, sizeof(value));
+            return value;
+        }
+    }
+}
+
+// Normalized integers map to [0, 1], or [-1, 1] for signed types
+// https://github.com/KhronosGroup/glTF/tree/main/extensions/2.0/Khronos/KHR_mesh_quantization
+float VertexAttribute::scale() const {
+    if (!normalized) {
+        return 1.0f;
+    }
+    switch (component_type) {
+        case GL_BYTE:
+            return 1.0f/127;
+        case GL_UNSIGNED_BYTE:
+            return 1.0f/255;
+        case GL_SHORT:
+            return 1.0f/32767;
+        case GL_UNSIGNED_SHORT:
+            return 1.0f/65535;
+    }
+    return 1.0f;
+}
+
+float3 Mesh::normal(uint32_t i) const {
+    if (quantized_normals.empty()) {
+        return normals[i];
+    }
+    float3 n = quantized_normals.scale()*quantized_normals.get3(i);
+    return float3(std::max(n.x, -1.0f), std::max(n.y, -1.0f), std::max(n.z, -1.0f));
+}
+
+size_t Mesh::memory_size() const {
+    return indices.size()*sizeof(uint16_t) + indices32.size()*sizeof(uint32_t) +
+           vertices.size()*sizeof(float3) + normals.size()*sizeof(float3) +
+           colors.size()*sizeof(float3) + texcoords.size()*sizeof(float2) +
+           quantized_vertices.data.size() + quantized_normals.data.size() +
+           quantized_texcoords.data.size() + meshlets.size()*sizeof(Meshlet) +
+           meshlet_vertices.size()*sizeof(uint32_t) + meshlet_triangles.size();
+}
+
+std::vector<float3> Mesh::random_colors(size_t count) {
+    std::random_device rd;  //Will be used to obtain a seed for the random number engine
+    std::mt19937 gen(rd()); //Standard mersenne_twister_engine seeded with rd()
+    std::uniform_int_distribution<> distrib(0,5);
+    float3 c0(1.0, 0.0, 0.0);
+    float3 c1(0.0, 1.0, 0.0);
+    float3 c2(0.0, 0.0, 1.0);
+    float3 c3(1.0, 1.0, 0.0);
+    float3 c4(0.0, 1.0, 1.0);
+    float3 c5(1.0, 0.0, 1.0);
+    float3 color_options[6] = {c0, c1, c2, c3, c4, c5};
+    std::vector<float3> colors;
+    for (size_t i = 0; i < count; i++) {
+        colors.push_back(color_options[distrib(gen)]);
+    }
+    return colors;
+}
+
 std::shared_ptr<Mesh> Mesh::createTriangleMesh() {
     int num_triangles = 1;
     std::vector<float3> vertices;
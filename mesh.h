@@ -1,9 +1,54 @@
 #pragma once
 
+#include <memory>
 #include <random>
 #include <chrono>
 
 #include "data_types.h"
+#include "opengl_constants.h"
+
+// Vertex attribute kept in the component type it was stored with
+// (KHR_mesh_quantization), e.g. int16 positions or uint16 texcoords.
+// Elements are tightly packed. get() returns the stored integers as floats,
+// normalized attributes are brought to [0, 1] or [-1, 1] by scale().
+struct VertexAttribute {
+    int component_type = GL_FLOAT;
+    bool normalized = false;
+    int num_components = 0;
+    std::vector<uint8_t> data;
+
+    bool empty() const { return data.empty(); }
+    size_t element_size() const;
+    size_t size() const { return empty() ? 0 : data.size()/element_size(); }
+    float component(size_t i, int c) const;
+    float scale() const;
+    float3 get3(size_t i) const { return float3(component(i, 0), component(i, 1), component(i, 2)); }
+    float2 get2(size_t i) const { return float2(component(i, 0), component(i, 1)); }
+};
+
+// Bytes of one component of an accessor's componentType
+size_t ComponentSize(int component_type);
+
+// Cluster of a mesh's triangles (see BuildMeshlets) with the bounds used to
+// cull it before any of its vertices are transformed. Bounds are in the
+// mesh's stored position units, i.e. before position_scale().
+struct Meshlet {
+    // Mesh vertices used by the meshlet are meshlet_vertices[vertex_offset,
+    // vertex_offset + vertex_count), its triangles are three indices into
+    // those per triangle starting at meshlet_triangles[triangle_offset]
+    uint32_t vertex_offset;
+    uint32_t vertex_count;
+    uint32_t triangle_offset;
+    uint32_t triangle_count;
+    // Bounding sphere
+    float3 center;
+    float radius;
+    // The normals of all triangles are within the cone around cone_axis
+    // whose half angle has the sine cone_cutoff. A cutoff of 1 means the
+    // meshlet is never entirely back facing.
+    float3 cone_axis;
+    float cone_cutoff;
+};
 
 // Mesh represents the geometry of the object in terms of
 // vertices/faces/normals/texcoords etc.
@@ -18,27 +63,45 @@ class Mesh {
         num_triangles(_num_triangles),
         vertices(_vertices) 
         {
-            colors = std::vector<float3>();
-            std::random_device rd;  //Will be used to obtain a seed for the random number engine
-            std::mt19937 gen(rd()); //Standard mersenne_twister_engine seeded with rd()
-            std::uniform_int_distribution<> distrib(0,5);
-            float3 c0(1.0, 0.0, 0.0);
-            float3 c1(0.0, 1.0, 0.0);
-            float3 c2(0.0, 0.0, 1.0);
-            float3 c3(1.0, 1.0, 0.0);
-            float3 c4(0.0, 1.0, 1.0);
-            float3 c5(1.0, 0.0, 1.0);
-            float3 color_options[6] = {c0, c1, c2, c3, c4, c5};
-            for (int i = 0; i < _num_triangles*3; i++) {
-                colors.push_back(color_options[distrib(gen)]);
-            }
+            colors = random_colors(vertices.size());
         }
+    Mesh(int _num_triangles,
+         VertexAttribute _quantized_vertices) :
+        num_triangles(_num_triangles),
+        colors(random_colors(_quantized_vertices.size())),
+        quantized_vertices(std::move(_quantized_vertices)) {}
     int num_triangles;
     std::vector<uint16_t> indices;
+    // Used instead of indices when a mesh needs more than 16 bits
+    std::vector<uint32_t> indices32;
     std::vector<float3> vertices;
     std::vector<float3> normals;
     std::vector<float3> colors;
     std::vector<float2> texcoords;
+    // Quantized attributes, used instead of vertices/normals/texcoords when
+    // not empty
+    VertexAttribute quantized_vertices;
+    VertexAttribute quantized_normals;
+    VertexAttribute quantized_texcoords;
+    // Optional clusters of the triangles, in index order. When present they
+    // are culled as a whole before their vertices are transformed.
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> meshlet_vertices;
+    std::vector<uint8_t> meshlet_triangles;
+
+    size_t vertex_count() const { return quantized_vertices.empty() ? vertices.size() : quantized_vertices.size(); }
+    bool indexed() const { return !indices.empty() || !indices32.empty(); }
+    uint32_t index(int i) const { return indices32.empty() ? indices[i] : indices32[i]; }
+    // Positions and texcoords are not normalized here, the vertex stage
+    // folds position_scale()/texcoord_scale() into its transforms
+    float3 position(uint32_t i) const { return quantized_vertices.empty() ? vertices[i] : quantized_vertices.get3(i); }
+    float2 texcoord(uint32_t i) const { return quantized_texcoords.empty() ? texcoords[i] : quantized_texcoords.get2(i); }
+    float position_scale() const { return quantized_vertices.empty() ? 1.0f : quantized_vertices.scale(); }
+    float texcoord_scale() const { return quantized_texcoords.empty() ? 1.0f : quantized_texcoords.scale(); }
+    float3 normal(uint32_t i) const;
+    // Bytes of vertex and index data
+    size_t memory_size() const;
+    static std::vector<float3> random_colors(size_t count);
     static std::shared_ptr<Mesh> createTriangleMesh();
     static std::shared_ptr<Mesh> createQuadMesh();
     static std::shared_ptr<Mesh> createCubeMesh();
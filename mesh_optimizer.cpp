@@ -0,0 +1,517 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Indices of the triangles of mesh, 0, 1, 2, ... for a non-indexed mesh
+static std::vector<uint32_t> get_indices(const Mesh &mesh) {
+    std::vector<uint32_t> indices(size_t(mesh.num_triangles)*3);
+    for (size_t i = 0; i < indices.size(); i++) {
+        indices[i] = mesh.indexed() ? mesh.index(i) : i;
+    }
+    return indices;
+}
+
+// Store indices in 16 bits if every vertex can be addressed that way.
+// Meshlets no longer match the new indices and are dropped.
+static void set_indices(Mesh &mesh, std::vector<uint32_t> indices) {
+    mesh.num_triangles = indices.size()/3;
+    mesh.meshlets.clear();
+    mesh.meshlet_vertices.clear();
+    mesh.meshlet_triangles.clear();
+    if (mesh.vertex_count() <= size_t(UINT16_MAX) + 1) {
+        mesh.indices.assign(indices.begin(), indices.end());
+        mesh.indices32.clear();
+    } else {
+        mesh.indices.clear();
+        mesh.indices32 = std::move(indices);
+    }
+}
+
+// Move element i of values to remap[i], dropping it for UINT32_MAX
+template <typename T>
+static void remap_values(std::vector<T> &values, const std::vector<uint32_t> &remap, size_t count) {
+    if (values.size() != remap.size()) {
+        return;
+    }
+    std::vector<T> remapped(count);
+    for (size_t i = 0; i < remap.size(); i++) {
+        if (remap[i] != UINT32_MAX) {
+            remapped[remap[i]] = values[i];
+        }
+    }
+    values = std::move(remapped);
+}
+
+static void remap_attribute(VertexAttribute &attribute, const std::vector<uint32_t> &remap, size_t count) {
+    if (attribute.size() != remap.size()) {
+        return;
+    }
+    size_t element_size = attribute.element_size();
+    std::vector<uint8_t> remapped(count*element_size);
+    for (size_t i = 0; i < remap.size(); i++) {
+        if (remap[i] != UINT32_MAX) {
+            memcpy(&remapped[remap[i]*element_size], &attribute.data[i*element_size], element_size);
+        }
+    }
+    attribute.data = std::move(remapped);
+}
+
+// Apply a vertex remap to every attribute of mesh, leaving count vertices
+static void remap_vertices(Mesh &mesh, const std::vector<uint32_t> &remap, size_t count) {
+    remap_values(mesh.vertices, remap, count);
+    remap_values(mesh.normals, remap, count);
+    remap_values(mesh.colors, remap, count);
+    remap_values(mesh.texcoords, remap, count);
+    remap_attribute(mesh.quantized_vertices, remap, count);
+    remap_attribute(mesh.quantized_normals, remap, count);
+    remap_attribute(mesh.quantized_texcoords, remap, count);
+}
+
+// 64 bit FNV-1a
+static uint64_t hash_bytes(const uint8_t *data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i])*1099511628211ull;
+    }
+    return hash;
+}
+
+void DeduplicateVertices(Mesh &mesh) {
+    size_t vertex_count = mesh.vertex_count();
+    if (vertex_count == 0) {
+        return;
+    }
+    // Each vertex is compared as its attributes' bytes packed together
+    std::vector<std::pair<const uint8_t *, size_t>> streams;
+    auto add_stream = [&](const void *data, size_t element_size) {
+        streams.push_back(std::make_pair(static_cast<const uint8_t *>(data), element_size));
+    };
+    if (mesh.quantized_vertices.empty()) {
+        add_stream(mesh.vertices.data(), sizeof(float3));
+    } else {
+        add_stream(mesh.quantized_vertices.data.data(), mesh.quantized_vertices.element_size());
+    }
+    if (!mesh.quantized_normals.empty()) {
+        add_stream(mesh.quantized_normals.data.data(), mesh.quantized_normals.element_size());
+    } else if (!mesh.normals.empty()) {
+        add_stream(mesh.normals.data(), sizeof(float3));
+    }
+    if (!mesh.quantized_texcoords.empty()) {
+        add_stream(mesh.quantized_texcoords.data.data(), mesh.quantized_texcoords.element_size());
+    } else if (!mesh.texcoords.empty()) {
+        add_stream(mesh.texcoords.data(), sizeof(float2));
+    }
+    size_t stride = 0;
+    for (const std::pair<const uint8_t *, size_t> &stream : streams) {
+        stride += stream.second;
+    }
+    std::vector<uint8_t> keys(vertex_count*stride);
+    for (size_t v = 0; v < vertex_count; v++) {
+        uint8_t *key = &keys[v*stride];
+        for (const std::pair<const uint8_t *, size_t> &stream : streams) {
+            memcpy(key, stream.first + v*stream.second, stream.second);
+            key += stream.second;
+        }
+    }
+
+    // Open addressing table of the first vertex with each key
+    size_t table_size = 1;
+    while (table_size < vertex_count*2) {
+        table_size *= 2;
+    }
+    std::vector<uint32_t> table(table_size, UINT32_MAX);
+    std::vector<uint32_t> remap(vertex_count);
+    size_t unique_count = 0;
+    for (size_t v = 0; v < vertex_count; v++) {
+        const uint8_t *key = &keys[v*stride];
+        size_t slot = hash_bytes(key, stride) & (table_size - 1);
+        while (table[slot] != UINT32_MAX && memcmp(&keys[table[slot]*stride], key, stride) != 0) {
+            slot = (slot + 1) & (table_size - 1);
+        }
+        if (table[slot] == UINT32_MAX) {
+            table[slot] = v;
+            remap[v] = unique_count++;
+        } else {
+            remap[v] = remap[table[slot]];
+        }
+    }
+
+    std::vector<uint32_t> indices = get_indices(mesh);
+    for (uint32_t &index : indices) {
+        index = remap[index];
+    }
+    remap_vertices(mesh, remap, unique_count);
+    set_indices(mesh, std::move(indices));
+}
+
+// Forsyth's vertex score: recently used vertices score high, except for the
+// last triangle's which are about to be shared anyway, and vertices with
+// few triangles left are boosted so they don't linger.
+static float vertex_score(int cache_position, uint32_t live_triangles) {
+    if (live_triangles == 0) {
+        return -1;
+    }
+    float score = 0;
+    if (cache_position >= 0) {
+        if (cache_position < 3) {
+            score = 0.75f;
+        } else {
+            float scaled = 1.0f - float(cache_position - 3)/(VERTEX_CACHE_SIZE - 3);
+            score = std::pow(scaled, 1.5f);
+        }
+    }
+    return score + 2.0f/std::sqrt(float(live_triangles));
+}
+
+void OptimizeVertexCache(std::vector<uint32_t> &indices, size_t vertex_count) {
+    size_t triangle_count = indices.size()/3;
+    if (triangle_count == 0) {
+        return;
+    }
+    // Live triangles of vertex v are adjacency[offsets[v]...offsets[v] + live[v])
+    std::vector<uint32_t> live(vertex_count, 0);
+    for (size_t i = 0; i < triangle_count*3; i++) {
+        live[indices[i]]++;
+    }
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; v++) {
+        offsets[v + 1] = offsets[v] + live[v];
+    }
+    std::vector<uint32_t> adjacency(triangle_count*3);
+    std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < triangle_count*3; i++) {
+        adjacency[filled[indices[i]]++] = i/3;
+    }
+
+    std::vector<int> cache_position(vertex_count, -1);
+    std::vector<float> score(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++) {
+        score[v] = vertex_score(-1, live[v]);
+    }
+    auto triangle_score = [&](size_t t) {
+        return score[indices[t*3]] + score[indices[t*3 + 1]] + score[indices[t*3 + 2]];
+    };
+
+    // The triangles with the best scores are found among those of the
+    // cached vertices. The first one is the best overall.
+    size_t best = 0;
+    for (size_t t = 1; t < triangle_count; t++) {
+        if (triangle_score(t) > triangle_score(best)) {
+            best = t;
+        }
+    }
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<uint32_t> output;
+    output.reserve(triangle_count*3);
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> new_cache;
+    size_t next_unemitted = 0;
+    while (output.size() < triangle_count*3) {
+        if (best == SIZE_MAX) {
+            // Dead end, continue with the next triangle in input order
+            while (emitted[next_unemitted]) {
+                next_unemitted++;
+            }
+            best = next_unemitted;
+        }
+        emitted[best] = true;
+        const uint32_t *triangle = &indices[best*3];
+        output.insert(output.end(), triangle, triangle + 3);
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = triangle[k];
+            uint32_t *begin = &adjacency[offsets[v]];
+            uint32_t *end = begin + live[v];
+            uint32_t *it = std::find(begin, end, uint32_t(best));
+            std::swap(*it, *(end - 1));
+            live[v]--;
+        }
+
+        // The triangle's vertices move to the front of the cache
+        new_cache.assign(triangle, triangle + 3);
+        for (uint32_t v : cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                new_cache.push_back(v);
+            }
+        }
+        for (size_t i = 0; i < new_cache.size(); i++) {
+            uint32_t v = new_cache[i];
+            cache_position[v] = (i < VERTEX_CACHE_SIZE) ? int(i) : -1;
+            score[v] = vertex_score(cache_position[v], live[v]);
+        }
+        new_cache.resize(std::min(new_cache.size(), VERTEX_CACHE_SIZE));
+        cache.swap(new_cache);
+
+        best = SIZE_MAX;
+        float best_score = 0;
+        for (uint32_t v : cache) {
+            for (uint32_t i = offsets[v]; i < offsets[v] + live[v]; i++) {
+                float s = triangle_score(adjacency[i]);
+                if (best == SIZE_MAX || s > best_score) {
+                    best = adjacency[i];
+                    best_score = s;
+                }
+            }
+        }
+    }
+    indices = std::move(output);
+}
+
+// FIFO cache simulated with the time each vertex was last loaded, returns
+// the number of vertices of triangle t that missed
+static unsigned int update_cache(const uint32_t *triangle, std::vector<uint32_t> &timestamps, uint32_t &timestamp) {
+    unsigned int misses = 0;
+    for (int k = 0; k < 3; k++) {
+        uint32_t v = triangle[k];
+        if (timestamp - timestamps[v] > VERTEX_CACHE_SIZE) {
+            timestamps[v] = timestamp++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+void OptimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<float3> &positions, float threshold) {
+    size_t triangle_count = indices.size()/3;
+    if (triangle_count == 0) {
+        return;
+    }
+    std::vector<uint32_t> timestamps(positions.size(), 0);
+    uint32_t timestamp = VERTEX_CACHE_SIZE + 1;
+    auto flush_cache = [&]() { timestamp += VERTEX_CACHE_SIZE + 1; };
+
+    // Hard boundaries: triangles sharing no vertex with the cache start a
+    // new cluster, reordering there costs nothing
+    std::vector<size_t> hard_clusters;
+    for (size_t t = 0; t < triangle_count; t++) {
+        if (update_cache(&indices[t*3], timestamps, timestamp) == 3 || t == 0) {
+            hard_clusters.push_back(t);
+        }
+    }
+
+    // Soft boundaries: a hard cluster is split each time the miss ratio
+    // since the last split gets within threshold of the cluster's own
+    std::vector<size_t> clusters;
+    for (size_t c = 0; c < hard_clusters.size(); c++) {
+        size_t begin = hard_clusters[c];
+        size_t end = (c + 1 < hard_clusters.size()) ? hard_clusters[c + 1] : triangle_count;
+        flush_cache();
+        size_t cluster_misses = 0;
+        for (size_t t = begin; t < end; t++) {
+            cluster_misses += update_cache(&indices[t*3], timestamps, timestamp);
+        }
+        float cluster_threshold = threshold*float(cluster_misses)/float(end - begin);
+        clusters.push_back(begin);
+        flush_cache();
+        size_t running_misses = 0;
+        size_t running_triangles = 0;
+        for (size_t t = begin; t < end; t++) {
+            running_misses += update_cache(&indices[t*3], timestamps, timestamp);
+            running_triangles++;
+            if (float(running_misses)/float(running_triangles) <= cluster_threshold && t + 1 < end) {
+                clusters.push_back(t + 1);
+                flush_cache();
+                running_misses = 0;
+                running_triangles = 0;
+            }
+        }
+    }
+
+    // Clusters facing away from the middle of the mesh are drawn first
+    float3 mesh_centroid(0, 0, 0);
+    for (size_t i = 0; i < triangle_count*3; i++) {
+        mesh_centroid = mesh_centroid + positions[indices[i]];
+    }
+    mesh_centroid = (1.0f/(triangle_count*3))*mesh_centroid;
+    std::vector<float> sort_keys(clusters.size());
+    for (size_t c = 0; c < clusters.size(); c++) {
+        size_t begin = clusters[c];
+        size_t end = (c + 1 < clusters.size()) ? clusters[c + 1] : triangle_count;
+        float3 centroid(0, 0, 0);
+        float3 normal(0, 0, 0);
+        float area = 0;
+        for (size_t t = begin; t < end; t++) {
+            const float3 &p0 = positions[indices[t*3]];
+            const float3 &p1 = positions[indices[t*3 + 1]];
+            const float3 &p2 = positions[indices[t*3 + 2]];
+            float3 n = cross(p1 - p0, p2 - p0);
+            float triangle_area = magnitude(n);
+            centroid = centroid + (triangle_area/3)*(p0 + p1 + p2);
+            normal = normal + n;
+            area += triangle_area;
+        }
+        float normal_length = magnitude(normal);
+        if (area == 0 || normal_length == 0) {
+            continue;
+        }
+        centroid = (1.0f/area)*centroid;
+        sort_keys[c] = dot(centroid - mesh_centroid, (1.0f/normal_length)*normal);
+    }
+    std::vector<size_t> order(clusters.size());
+    for (size_t c = 0; c < order.size(); c++) {
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sort_keys[a] > sort_keys[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(triangle_count*3);
+    for (size_t c : order) {
+        size_t begin = clusters[c];
+        size_t end = (c + 1 < clusters.size()) ? clusters[c + 1] : triangle_count;
+        output.insert(output.end(), indices.begin() + begin*3, indices.begin() + end*3);
+    }
+    indices = std::move(output);
+}
+
+size_t OptimizeVertexFetchRemap(const std::vector<uint32_t> &indices, size_t vertex_count,
+                                std::vector<uint32_t> &remap) {
+    remap.assign(vertex_count, UINT32_MAX);
+    size_t used = 0;
+    for (uint32_t index : indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = used++;
+        }
+    }
+    return used;
+}
+
+void OptimizeMesh(Mesh &mesh) {
+    size_t vertex_count = mesh.vertex_count();
+    std::vector<uint32_t> indices = get_indices(mesh);
+    if (indices.empty() || *std::max_element(indices.begin(), indices.end()) >= vertex_count) {
+        return;
+    }
+    DeduplicateVertices(mesh);
+    indices = get_indices(mesh);
+    vertex_count = mesh.vertex_count();
+    OptimizeVertexCache(indices, vertex_count);
+    // Quantized positions are only scaled uniformly, which doesn't change
+    // the cluster order
+    std::vector<float3> positions(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++) {
+        positions[v] = mesh.position(v);
+    }
+    OptimizeOverdraw(indices, positions, 1.05f);
+    std::vector<uint32_t> remap;
+    size_t used = OptimizeVertexFetchRemap(indices, vertex_count, remap);
+    for (uint32_t &index : indices) {
+        index = remap[index];
+    }
+    remap_vertices(mesh, remap, used);
+    set_indices(mesh, std::move(indices));
+}
+
+// Bounding sphere around the center of the bounding box and normal cone of
+// a meshlet whose vertices and triangles have been filled in
+static void compute_meshlet_bounds(const Mesh &mesh, Meshlet &meshlet) {
+    const uint32_t *vertices = &mesh.meshlet_vertices[meshlet.vertex_offset];
+    const uint8_t *triangles = &mesh.meshlet_triangles[meshlet.triangle_offset];
+    float3 bbmin(INFINITY, INFINITY, INFINITY);
+    float3 bbmax(-INFINITY, -INFINITY, -INFINITY);
+    for (uint32_t i = 0; i < meshlet.vertex_count; i++) {
+        float3 p = mesh.position(vertices[i]);
+        bbmin = float3(std::min(bbmin.x, p.x), std::min(bbmin.y, p.y), std::min(bbmin.z, p.z));
+        bbmax = float3(std::max(bbmax.x, p.x), std::max(bbmax.y, p.y), std::max(bbmax.z, p.z));
+    }
+    meshlet.center = 0.5f*(bbmin + bbmax);
+    meshlet.radius = 0;
+    for (uint32_t i = 0; i < meshlet.vertex_count; i++) {
+        meshlet.radius = std::max(meshlet.radius, magnitude(mesh.position(vertices[i]) - meshlet.center));
+    }
+
+    // The axis is the average of the triangle normals, the cone is as wide
+    // as the normal furthest from it. Degenerate triangles cover no pixels
+    // and are ignored.
+    std::vector<float3> normals;
+    float3 axis(0, 0, 0);
+    for (uint32_t t = 0; t < meshlet.triangle_count; t++) {
+        float3 p0 = mesh.position(vertices[triangles[t*3]]);
+        float3 p1 = mesh.position(vertices[triangles[t*3 + 1]]);
+        float3 p2 = mesh.position(vertices[triangles[t*3 + 2]]);
+        float3 n = cross(p1 - p0, p2 - p0);
+        float length = magnitude(n);
+        if (length > 0) {
+            normals.push_back((1.0f/length)*n);
+            axis = axis + normals.back();
+        }
+    }
+    meshlet.cone_axis = float3(0, 0, 0);
+    meshlet.cone_cutoff = 1;
+    float axis_length = magnitude(axis);
+    if (normals.empty() || axis_length == 0) {
+        return;
+    }
+    axis = (1.0f/axis_length)*axis;
+    float min_dot = 1;
+    for (const float3 &n : normals) {
+        min_dot = std::min(min_dot, dot(n, axis));
+    }
+    meshlet.cone_axis = axis;
+    // Cones of 90 degrees or more can always be seen from the front
+    if (min_dot > 0) {
+        meshlet.cone_cutoff = std::sqrt(1 - min_dot*min_dot);
+    }
+}
+
+void BuildMeshlets(Mesh &mesh) {
+    mesh.meshlets.clear();
+    mesh.meshlet_vertices.clear();
+    mesh.meshlet_triangles.clear();
+    std::vector<uint32_t> indices = get_indices(mesh);
+    // Local index of each vertex in the meshlet being built, 0xff if unused
+    std::vector<uint8_t> local(mesh.vertex_count(), 0xff);
+    Meshlet meshlet = {};
+    auto finish_meshlet = [&]() {
+        for (uint32_t i = 0; i < meshlet.vertex_count; i++) {
+            local[mesh.meshlet_vertices[meshlet.vertex_offset + i]] = 0xff;
+        }
+        compute_meshlet_bounds(mesh, meshlet);
+        mesh.meshlets.push_back(meshlet);
+        meshlet = Meshlet();
+        meshlet.vertex_offset = mesh.meshlet_vertices.size();
+        meshlet.triangle_offset = mesh.meshlet_triangles.size();
+    };
+    for (size_t t = 0; t < indices.size()/3; t++) {
+        const uint32_t *triangle = &indices[t*3];
+        uint32_t new_vertices = 0;
+        for (int k = 0; k < 3; k++) {
+            bool repeated = (k > 0 && triangle[k] == triangle[0]) || (k > 1 && triangle[k] == triangle[1]);
+            if (local[triangle[k]] == 0xff && !repeated) {
+                new_vertices++;
+            }
+        }
+        if (meshlet.vertex_count + new_vertices > MESHLET_MAX_VERTICES ||
+            meshlet.triangle_count + 1 > MESHLET_MAX_TRIANGLES) {
+            finish_meshlet();
+        }
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = triangle[k];
+            if (local[v] == 0xff) {
+                local[v] = meshlet.vertex_count++;
+                mesh.meshlet_vertices.push_back(v);
+            }
+            mesh.meshlet_triangles.push_back(local[v]);
+        }
+        meshlet.triangle_count++;
+    }
+    if (meshlet.triangle_count > 0) {
+        finish_meshlet();
+    }
+}
+
+float VertexCacheMissRatio(const std::vector<uint32_t> &indices, size_t vertex_count, size_t cache_size) {
+    if (indices.size() < 3) {
+        return 0;
+    }
+    std::vector<uint32_t> timestamps(vertex_count, 0);
+    uint32_t timestamp = cache_size + 1;
+    size_t misses = 0;
+    for (uint32_t index : indices) {
+        if (timestamp - timestamps[index] > cache_size) {
+            timestamps[index] = timestamp++;
+            misses++;
+        }
+    }
+    return float(misses)/(indices.size()/3);
+}
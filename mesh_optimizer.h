@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+// Load-time reordering of triangle list meshes, after Forsyth's linear-speed
+// vertex cache optimisation and Sander et al.'s "Fast triangle reordering for
+// vertex locality and reduced overdraw". None of it changes what a mesh looks
+// like, only the order its triangles and vertices are stored in.
+
+// FIFO cache size the orderings are tuned for
+constexpr size_t VERTEX_CACHE_SIZE = 16;
+
+// Merge vertices whose positions, normals and texcoords are bitwise equal
+// (vertex colors are generated and not compared) and index the mesh.
+// Non-indexed meshes get their index buffer here.
+void DeduplicateVertices(Mesh &mesh);
+
+// Reorder triangles so consecutive ones share vertices
+void OptimizeVertexCache(std::vector<uint32_t> &indices, size_t vertex_count);
+
+// Reorder clusters of a vertex cache optimized index buffer so triangles
+// likely to be in front are drawn first and hide the ones behind them from
+// shading. Clusters are split while their cache miss ratio stays within
+// threshold (e.g. 1.05) times the original one.
+void OptimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<float3> &positions, float threshold);
+
+// Vertex order in which indices first reference them. remap[old] is the new
+// index of vertex old, or UINT32_MAX if no triangle uses it. Returns the
+// number of vertices used.
+size_t OptimizeVertexFetchRemap(const std::vector<uint32_t> &indices, size_t vertex_count,
+                                std::vector<uint32_t> &remap);
+
+// Deduplicate, then reorder triangles for the vertex cache and overdraw and
+// vertices for fetch locality. Indices are stored in 16 bits when they fit.
+void OptimizeMesh(Mesh &mesh);
+
+// Meshlet limits, small enough that a meshlet's local indices fit in a byte
+constexpr size_t MESHLET_MAX_VERTICES = 64;
+constexpr size_t MESHLET_MAX_TRIANGLES = 124;
+
+// Split the triangles of mesh, in index order, into meshlets and compute
+// their bounding spheres and normal cones. Consecutive triangles should be
+// close to each other, as after OptimizeMesh, for tight bounds.
+void BuildMeshlets(Mesh &mesh);
+
+// Average number of vertices transformed per triangle by a FIFO cache of
+// cache_size vertices, 3 for no reuse at all
+float VertexCacheMissRatio(const std::vector<uint32_t> &indices, size_t vertex_count, size_t cache_size);
@@ -0,0 +1,571 @@
+#include "meshopt.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// The byte group decoder has an SSSE3 path, compiled with a function-level
+// target attribute and only selected when the CPU reports SSSE3 at runtime
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MESHOPT_SSSE3 1
+#define SSSE3_TARGET __attribute__((target("ssse3")))
+#include <immintrin.h>
+#endif
+
+static const unsigned char VERTEX_HEADER = 0xa0;
+static const unsigned char INDEX_HEADER = 0xe0;
+static const unsigned char SEQUENCE_HEADER = 0xd0;
+
+// Vertex data is coded one byte of the vertex at a time, in groups of 16
+// consecutive vertices, each group with 0, 2, 4 or 8 bits per delta
+static const size_t BYTE_GROUP_SIZE = 16;
+// Largest number of bytes a group reads, valid streams always have at least
+// this many bytes left before a group
+static const size_t BYTE_GROUP_DECODE_LIMIT = 24;
+static const size_t VERTEX_BLOCK_SIZE_BYTES = 8192;
+static const size_t VERTEX_BLOCK_MAX_SIZE = 256;
+static const size_t TAIL_MAX_SIZE = 32;
+
+static size_t VertexBlockSize(size_t stride) {
+    size_t result = (VERTEX_BLOCK_SIZE_BYTES/stride) & ~(BYTE_GROUP_SIZE - 1);
+    return (result < VERTEX_BLOCK_MAX_SIZE) ? result : VERTEX_BLOCK_MAX_SIZE;
+}
+
+static unsigned char Unzigzag8(unsigned char v) {
+    return (0 - (v & 1)) ^ (v >> 1);
+}
+
+// Packed 2 or 4 bit deltas, most significant bits first. The all-ones value
+// escapes to a full byte stored after the packed ones.
+static const unsigned char *DecodeBytesGroup(const unsigned char *data, unsigned char *out, int bits_log2) {
+    switch (bits_log2) {
+        case 0:
+            memset(out, 0, BYTE_GROUP_SIZE);
+            return data;
+        case 1:
+        case 2: {
+            unsigned int bits = 1u << bits_log2;
+            unsigned int escape = (1u << bits) - 1;
+            const unsigned char *extra = data + BYTE_GROUP_SIZE*bits/8;
+            for (size_t i = 0; i < BYTE_GROUP_SIZE; i++) {
+                unsigned int v = (data[i*bits/8] >> (8 - bits - (i*bits) % 8)) & escape;
+                out[i] = (v == escape) ? *extra++ : v;
+            }
+            return extra;
+        }
+        default:
+            memcpy(out, data, BYTE_GROUP_SIZE);
+            return data + BYTE_GROUP_SIZE;
+    }
+}
+
+#ifdef MESHOPT_SSSE3
+// For each 8 bit mask of escaped values: the shuffle that moves the escaped
+// bytes into place (0x80 clears a byte) and the number of escaped bytes
+struct ShuffleTables {
+    unsigned char shuffle[256][8];
+    unsigned char count[256];
+    ShuffleTables() {
+        for (int mask = 0; mask < 256; mask++) {
+            unsigned char n = 0;
+            for (int i = 0; i < 8; i++) {
+                bool escaped = (mask >> i) & 1;
+                shuffle[mask][i] = escaped ? n : 0x80;
+                n += escaped;
+            }
+            count[mask] = n;
+        }
+    }
+};
+
+static const ShuffleTables shuffle_tables;
+
+SSSE3_TARGET static __m128i ShuffleMask(unsigned char mask0, unsigned char mask1) {
+    __m128i sm0 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(shuffle_tables.shuffle[mask0]));
+    __m128i sm1 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(shuffle_tables.shuffle[mask1]));
+    // The second half reads after the escaped bytes of the first
+    sm1 = _mm_add_epi8(sm1, _mm_set1_epi8(shuffle_tables.count[mask0]));
+    return _mm_unpacklo_epi64(sm0, sm1);
+}
+
+// Same as DecodeBytesGroup, reads up to BYTE_GROUP_DECODE_LIMIT bytes
+SSSE3_TARGET static const unsigned char *DecodeBytesGroupSSSE3(const unsigned char *data, unsigned char *out,
+                                                              int bits_log2) {
+    switch (bits_log2) {
+        case 0:
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_setzero_si128());
+            return data;
+        case 1: {
+            int packed;
+            memcpy(&packed, data, sizeof(packed));
+            __m128i sel2 = _mm_cvtsi32_si128(packed);
+            __m128i rest = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 4));
+            // Spread the 2 bit fields to one per byte, in stream order
+            __m128i sel22 = _mm_unpacklo_epi8(_mm_srli_epi16(sel2, 4), sel2);
+            __m128i sel2222 = _mm_unpacklo_epi8(_mm_srli_epi16(sel22, 2), sel22);
+            __m128i sel = _mm_and_si128(sel2222, _mm_set1_epi8(3));
+            __m128i mask = _mm_cmpeq_epi8(sel, _mm_set1_epi8(3));
+            int mask16 = _mm_movemask_epi8(mask);
+            unsigned char mask0 = mask16 & 255;
+            unsigned char mask1 = mask16 >> 8;
+            __m128i result = _mm_or_si128(_mm_shuffle_epi8(rest, ShuffleMask(mask0, mask1)), _mm_andnot_si128(mask, sel));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), result);
+            return data + 4 + shuffle_tables.count[mask0] + shuffle_tables.count[mask1];
+        }
+        case 2: {
+            __m128i sel4 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(data));
+            __m128i rest = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 8));
+            __m128i sel44 = _mm_unpacklo_epi8(_mm_srli_epi16(sel4, 4), sel4);
+            __m128i sel = _mm_and_si128(sel44, _mm_set1_epi8(15));
+            __m128i mask = _mm_cmpeq_epi8(sel, _mm_set1_epi8(15));
+            int mask16 = _mm_movemask_epi8(mask);
+            unsigned char mask0 = mask16 & 255;
+            unsigned char mask1 = mask16 >> 8;
+            __m128i result = _mm_or_si128(_mm_shuffle_epi8(rest, ShuffleMask(mask0, mask1)), _mm_andnot_si128(mask, sel));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), result);
+            return data + 8 + shuffle_tables.count[mask0] + shuffle_tables.count[mask1];
+        }
+        default:
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out),
+                             _mm_loadu_si128(reinterpret_cast<const __m128i *>(data)));
+            return data + BYTE_GROUP_SIZE;
+    }
+}
+
+static bool CpuHasSSSE3() {
+    static const bool supported = __builtin_cpu_supports("ssse3");
+    return supported;
+}
+#endif
+
+// One byte of every vertex of a block: a 2 bit header per group followed by
+// the groups
+static const unsigned char *DecodeBytes(const unsigned char *data, const unsigned char *end, unsigned char *out,
+                                        size_t size) {
+    const unsigned char *header = data;
+    size_t header_size = (size/BYTE_GROUP_SIZE + 3)/4;
+    if (size_t(end - data) < header_size) {
+        return nullptr;
+    }
+    data += header_size;
+#ifdef MESHOPT_SSSE3
+    bool ssse3 = CpuHasSSSE3();
+#endif
+    for (size_t i = 0; i < size; i += BYTE_GROUP_SIZE) {
+        if (size_t(end - data) < BYTE_GROUP_DECODE_LIMIT) {
+            return nullptr;
+        }
+        size_t group = i/BYTE_GROUP_SIZE;
+        int bits_log2 = (header[group/4] >> ((group % 4)*2)) & 3;
+#ifdef MESHOPT_SSSE3
+        if (ssse3) {
+            data = DecodeBytesGroupSSSE3(data, out + i, bits_log2);
+            continue;
+        }
+#endif
+        data = DecodeBytesGroup(data, out + i, bits_log2);
+    }
+    return data;
+}
+
+// Bytes are stored as zigzag deltas from the same byte of the previous
+// vertex, last_vertex carries the previous vertex across blocks
+static const unsigned char *DecodeVertexBlock(const unsigned char *data, const unsigned char *end, unsigned char *out,
+                                              size_t count, size_t stride, unsigned char *last_vertex) {
+    unsigned char deltas[VERTEX_BLOCK_MAX_SIZE];
+    size_t aligned_count = (count + BYTE_GROUP_SIZE - 1) & ~(BYTE_GROUP_SIZE - 1);
+    for (size_t k = 0; k < stride; k++) {
+        data = DecodeBytes(data, end, deltas, aligned_count);
+        if (data == nullptr) {
+            return nullptr;
+        }
+        unsigned char p = last_vertex[k];
+        for (size_t i = 0; i < count; i++) {
+            p += Unzigzag8(deltas[i]);
+            out[i*stride + k] = p;
+        }
+        last_vertex[k] = p;
+    }
+    return data;
+}
+
+#ifdef MESHOPT_SSSE3
+// Same as DecodeVertexBlock. All bytes of the block are decoded first, then
+// four bytes of the vertex at a time are transposed to vertex order and
+// their deltas summed, 16 vertices per step.
+SSSE3_TARGET static const unsigned char *DecodeVertexBlockSSSE3(const unsigned char *data, const unsigned char *end,
+                                                                unsigned char *out, size_t count, size_t stride,
+                                                                unsigned char *last_vertex) {
+    alignas(16) unsigned char deltas[VERTEX_BLOCK_SIZE_BYTES];
+    size_t aligned_count = (count + BYTE_GROUP_SIZE - 1) & ~(BYTE_GROUP_SIZE - 1);
+    for (size_t k = 0; k < stride; k++) {
+        data = DecodeBytes(data, end, deltas + k*aligned_count, aligned_count);
+        if (data == nullptr) {
+            return nullptr;
+        }
+    }
+    const __m128i ones = _mm_set1_epi8(1);
+    const __m128i low7 = _mm_set1_epi8(127);
+    for (size_t k = 0; k < stride; k += 4) {
+        int previous;
+        memcpy(&previous, last_vertex + k, 4);
+        __m128i p = _mm_set1_epi32(previous);
+        for (size_t i = 0; i < count; i += BYTE_GROUP_SIZE) {
+            const unsigned char *lanes = deltas + k*aligned_count + i;
+            __m128i r0 = _mm_load_si128(reinterpret_cast<const __m128i *>(lanes));
+            __m128i r1 = _mm_load_si128(reinterpret_cast<const __m128i *>(lanes + aligned_count));
+            __m128i r2 = _mm_load_si128(reinterpret_cast<const __m128i *>(lanes + 2*aligned_count));
+            __m128i r3 = _mm_load_si128(reinterpret_cast<const __m128i *>(lanes + 3*aligned_count));
+            __m128i t0 = _mm_unpacklo_epi8(r0, r1);
+            __m128i t1 = _mm_unpackhi_epi8(r0, r1);
+            __m128i t2 = _mm_unpacklo_epi8(r2, r3);
+            __m128i t3 = _mm_unpackhi_epi8(r2, r3);
+            // Four vertices of four bytes each
+            __m128i v[4] = {_mm_unpacklo_epi16(t0, t2), _mm_unpackhi_epi16(t0, t2),
+                            _mm_unpacklo_epi16(t1, t3), _mm_unpackhi_epi16(t1, t3)};
+            for (int j = 0; j < 4; j++) {
+                __m128i d = v[j];
+                d = _mm_xor_si128(_mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(d, ones)),
+                                  _mm_and_si128(_mm_srli_epi16(d, 1), low7));
+                d = _mm_add_epi8(d, _mm_slli_si128(d, 4));
+                d = _mm_add_epi8(d, _mm_slli_si128(d, 8));
+                d = _mm_add_epi8(d, p);
+                p = _mm_shuffle_epi32(d, 0xff);
+                alignas(16) unsigned char vertices[16];
+                _mm_store_si128(reinterpret_cast<__m128i *>(vertices), d);
+                size_t first = i + j*4;
+                for (size_t m = 0; m < 4 && first + m < count; m++) {
+                    memcpy(out + (first + m)*stride + k, vertices + m*4, 4);
+                }
+            }
+        }
+    }
+    memcpy(last_vertex, out + (count - 1)*stride, stride);
+    return data;
+}
+#endif
+
+static bool DecodeVertexBuffer(unsigned char *out, size_t count, size_t stride, const unsigned char *data,
+                               size_t size) {
+    if (stride == 0 || stride > 256 || stride % 4 != 0) {
+        return false;
+    }
+    const unsigned char *end = data + size;
+    if (size < 1 + stride || (data[0] & 0xf0) != VERTEX_HEADER || (data[0] & 0x0f) != 0) {
+        return false;
+    }
+    data++;
+    // The tail ends with the first vertex, deltas of the first block start
+    // from it
+    unsigned char last_vertex[256];
+    memcpy(last_vertex, end - stride, stride);
+    size_t block_size = VertexBlockSize(stride);
+#ifdef MESHOPT_SSSE3
+    bool ssse3 = CpuHasSSSE3();
+#endif
+    for (size_t offset = 0; offset < count; offset += block_size) {
+        size_t n = (offset + block_size < count) ? block_size : count - offset;
+#ifdef MESHOPT_SSSE3
+        if (ssse3) {
+            data = DecodeVertexBlockSSSE3(data, end, out + offset*stride, n, stride, last_vertex);
+        } else {
+            data = DecodeVertexBlock(data, end, out + offset*stride, n, stride, last_vertex);
+        }
+#else
+        data = DecodeVertexBlock(data, end, out + offset*stride, n, stride, last_vertex);
+#endif
+        if (data == nullptr) {
+            return false;
+        }
+    }
+    size_t tail_size = (stride < TAIL_MAX_SIZE) ? TAIL_MAX_SIZE : stride;
+    return size_t(end - data) == tail_size;
+}
+
+static unsigned int DecodeVByte(const unsigned char *&data) {
+    unsigned char lead = *data++;
+    if (lead < 128) {
+        return lead;
+    }
+    // Up to 4 more bytes of 7 bits, stops on malformed data too
+    unsigned int result = lead & 127;
+    unsigned int shift = 7;
+    for (int i = 0; i < 4; i++) {
+        unsigned char group = *data++;
+        result |= unsigned(group & 127) << shift;
+        shift += 7;
+        if (group < 128) {
+            break;
+        }
+    }
+    return result;
+}
+
+// Zigzag coded delta from last
+static unsigned int DecodeIndex(const unsigned char *&data, unsigned int last) {
+    unsigned int v = DecodeVByte(data);
+    return last + ((v >> 1) ^ -int(v & 1));
+}
+
+static void WriteIndex(unsigned char *out, size_t i, size_t index_size, unsigned int index) {
+    if (index_size == 2) {
+        uint16_t value = index;
+        memcpy(out + i*2, &value, 2);
+    } else {
+        memcpy(out + i*4, &index, 4);
+    }
+}
+
+struct TriangleFifos {
+    unsigned int edges[16][2];
+    unsigned int vertices[16];
+    size_t edge_offset = 0;
+    size_t vertex_offset = 0;
+
+    TriangleFifos() {
+        memset(edges, -1, sizeof(edges));
+        memset(vertices, -1, sizeof(vertices));
+    }
+    void push_edge(unsigned int a, unsigned int b) {
+        edges[edge_offset][0] = a;
+        edges[edge_offset][1] = b;
+        edge_offset = (edge_offset + 1) & 15;
+    }
+    void push_vertex(unsigned int v, bool advance = true) {
+        vertices[vertex_offset] = v;
+        vertex_offset = (vertex_offset + advance) & 15;
+    }
+    // i-th most recent entry, counting from 0
+    const unsigned int *edge(int i) const { return edges[(edge_offset - 1 - i) & 15]; }
+    unsigned int vertex(int i) const { return vertices[(vertex_offset - 1 - i) & 15]; }
+};
+
+// Each triangle has a code byte. Codes below 0xf0 reuse an edge of a recent
+// triangle, its high nibble indexes the edge FIFO and the low nibble says
+// where the third vertex comes from. Other codes start a new strip, their
+// vertex sources come from a 16 entry table at the end of the stream or
+// from an extra byte. Vertices are either the next unseen index, an entry
+// of the vertex FIFO or a varint coded delta.
+static bool DecodeIndexBuffer(unsigned char *out, size_t count, size_t index_size, const unsigned char *data,
+                              size_t size) {
+    if (count % 3 != 0 || (index_size != 2 && index_size != 4)) {
+        return false;
+    }
+    // Header, a code byte per triangle and the code table
+    if (size < 1 + count/3 + 16 || (data[0] & 0xf0) != INDEX_HEADER) {
+        return false;
+    }
+    int version = data[0] & 0x0f;
+    if (version > 1) {
+        return false;
+    }
+    // Version 1 uses vertex sources 13 and 14 for last - 1 and last + 1
+    int fifo_limit = (version >= 1) ? 13 : 15;
+
+    TriangleFifos fifos;
+    unsigned int next = 0;
+    unsigned int last = 0;
+    const unsigned char *code = data + 1;
+    const unsigned char *extra = code + count/3;
+    // A triangle reads at most 16 bytes, so checking extra against the code
+    // table before each one keeps all reads in bounds
+    const unsigned char *extra_end = data + size - 16;
+    const unsigned char *code_table = extra_end;
+
+    for (size_t i = 0; i < count; i += 3) {
+        if (extra > extra_end) {
+            return false;
+        }
+        unsigned char triangle_code = *code++;
+        if (triangle_code < 0xf0) {
+            const unsigned int *edge = fifos.edge(triangle_code >> 4);
+            unsigned int a = edge[0];
+            unsigned int b = edge[1];
+            int fc = triangle_code & 15;
+            unsigned int c;
+            if (fc < fifo_limit) {
+                c = (fc == 0) ? next++ : fifos.vertex(fc);
+                fifos.push_vertex(c, fc == 0);
+            } else {
+                c = (fc == 15) ? DecodeIndex(extra, last) : last + (fc - (fc ^ 3));
+                last = c;
+                fifos.push_vertex(c);
+            }
+            WriteIndex(out, i + 0, index_size, a);
+            WriteIndex(out, i + 1, index_size, b);
+            WriteIndex(out, i + 2, index_size, c);
+            fifos.push_edge(c, b);
+            fifos.push_edge(a, c);
+        } else {
+            unsigned char sources;
+            int fa;
+            if (triangle_code < 0xfe) {
+                sources = code_table[triangle_code & 15];
+                fa = 0;
+            } else {
+                sources = *extra++;
+                fa = (triangle_code == 0xfe) ? 0 : 15;
+                // Restarts index numbering
+                if (sources == 0) {
+                    next = 0;
+                }
+            }
+            int fb = sources >> 4;
+            int fc = sources & 15;
+            // next is taken by a, b and c in order before any delta is read
+            unsigned int a = (fa == 0) ? next++ : 0;
+            unsigned int b = (fb == 0) ? next++ : fifos.vertex(fb - 1);
+            unsigned int c = (fc == 0) ? next++ : fifos.vertex(fc - 1);
+            if (fa == 15) {
+                last = a = DecodeIndex(extra, last);
+            }
+            if (fb == 15) {
+                last = b = DecodeIndex(extra, last);
+            }
+            if (fc == 15) {
+                last = c = DecodeIndex(extra, last);
+            }
+            WriteIndex(out, i + 0, index_size, a);
+            WriteIndex(out, i + 1, index_size, b);
+            WriteIndex(out, i + 2, index_size, c);
+            fifos.push_vertex(a);
+            fifos.push_vertex(b, fb == 0 || fb == 15);
+            fifos.push_vertex(c, fc == 0 || fc == 15);
+            fifos.push_edge(b, a);
+            fifos.push_edge(c, b);
+            fifos.push_edge(a, c);
+        }
+    }
+    return extra == extra_end;
+}
+
+// Varint deltas against one of two baselines, the low bit picks which
+static bool DecodeIndexSequence(unsigned char *out, size_t count, size_t index_size, const unsigned char *data,
+                                size_t size) {
+    if (index_size != 2 && index_size != 4) {
+        return false;
+    }
+    if (size < 1 + count + 4 || (data[0] & 0xf0) != SEQUENCE_HEADER || (data[0] & 0x0f) > 1) {
+        return false;
+    }
+    const unsigned char *end = data + size - 4;
+    data++;
+    unsigned int last[2] = {0, 0};
+    for (size_t i = 0; i < count; i++) {
+        // An index reads at most 5 bytes, the 4 byte tail keeps it in bounds
+        if (data >= end) {
+            return false;
+        }
+        unsigned int v = DecodeVByte(data);
+        unsigned int baseline = v & 1;
+        v >>= 1;
+        unsigned int index = last[baseline] + ((v >> 1) ^ -int(v & 1));
+        last[baseline] = index;
+        WriteIndex(out, i, index_size, index);
+    }
+    return data == end;
+}
+
+template <typename T>
+static T Load(const unsigned char *ptr) {
+    T value;
+    memcpy(&value, ptr, sizeof(T));
+    return value;
+}
+
+template <typename T>
+static void Store(unsigned char *ptr, T value) {
+    memcpy(ptr, &value, sizeof(T));
+}
+
+static int RoundToInt(float v) {
+    return int(v + (v >= 0 ? 0.5f : -0.5f));
+}
+
+// x and y are octahedral coordinates, z holds the scale that maps to 1
+template <typename T>
+static void FilterOctahedral(unsigned char *data, size_t count) {
+    const float max = float((1 << (sizeof(T)*8 - 1)) - 1);
+    for (size_t i = 0; i < count; i++) {
+        unsigned char *v = data + i*4*sizeof(T);
+        float x = Load<T>(v);
+        float y = Load<T>(v + sizeof(T));
+        float z = float(Load<T>(v + 2*sizeof(T))) - std::fabs(x) - std::fabs(y);
+        // Unfold the lower hemisphere
+        float t = (z < 0) ? z : 0;
+        x += (x >= 0) ? t : -t;
+        y += (y >= 0) ? t : -t;
+        float s = max/std::sqrt(x*x + y*y + z*z);
+        Store<T>(v, T(RoundToInt(x*s)));
+        Store<T>(v + sizeof(T), T(RoundToInt(y*s)));
+        Store<T>(v + 2*sizeof(T), T(RoundToInt(z*s)));
+    }
+}
+
+// The low 2 bits of the last component say which component was dropped,
+// the rest is the scale of the other three
+static void FilterQuaternion(unsigned char *data, size_t count) {
+    const float scale = 1/std::sqrt(2.0f);
+    for (size_t i = 0; i < count; i++) {
+        unsigned char *v = data + i*8;
+        int16_t packed = Load<int16_t>(v + 6);
+        float s = scale/float(packed | 3);
+        float x = Load<int16_t>(v)*s;
+        float y = Load<int16_t>(v + 2)*s;
+        float z = Load<int16_t>(v + 4)*s;
+        float ww = 1 - x*x - y*y - z*z;
+        float w = std::sqrt(ww >= 0 ? ww : 0);
+        int dropped = packed & 3;
+        Store<int16_t>(v + ((dropped + 1) & 3)*2, RoundToInt(x*32767));
+        Store<int16_t>(v + ((dropped + 2) & 3)*2, RoundToInt(y*32767));
+        Store<int16_t>(v + ((dropped + 3) & 3)*2, RoundToInt(z*32767));
+        Store<int16_t>(v + ((dropped + 0) & 3)*2, int(w*32767 + 0.5f));
+    }
+}
+
+static void FilterExponential(unsigned char *data, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t v = Load<uint32_t>(data + i*4);
+        int mantissa = int(v << 8) >> 8;
+        int exponent = int(v) >> 24;
+        Store<float>(data + i*4, std::ldexp(float(mantissa), exponent));
+    }
+}
+
+bool DecodeMeshopt(unsigned char *out, size_t count, size_t stride, MeshoptMode mode, MeshoptFilter filter,
+                   const unsigned char *data, size_t size) {
+    switch (mode) {
+        case MeshoptMode::TRIANGLES:
+            return filter == MeshoptFilter::NONE && DecodeIndexBuffer(out, count, stride, data, size);
+        case MeshoptMode::INDICES:
+            return filter == MeshoptFilter::NONE && DecodeIndexSequence(out, count, stride, data, size);
+        case MeshoptMode::ATTRIBUTES:
+            break;
+    }
+    if (!DecodeVertexBuffer(out, count, stride, data, size)) {
+        return false;
+    }
+    switch (filter) {
+        case MeshoptFilter::NONE:
+            return true;
+        case MeshoptFilter::OCTAHEDRAL:
+            if (stride == 4) {
+                FilterOctahedral<int8_t>(out, count);
+            } else if (stride == 8) {
+                FilterOctahedral<int16_t>(out, count);
+            } else {
+                return false;
+            }
+            return true;
+        case MeshoptFilter::QUATERNION:
+            if (stride != 8) {
+                return false;
+            }
+            FilterQuaternion(out, count);
+            return true;
+        case MeshoptFilter::EXPONENTIAL:
+            FilterExponential(out, count*stride/4);
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+
+// Decoders for EXT_meshopt_compression bufferViews, the bitstreams written by
+// meshoptimizer's meshopt_encodeVertexBuffer, meshopt_encodeIndexBuffer and
+// meshopt_encodeIndexSequence, plus the filters applied on top of them.
+// https://github.com/KhronosGroup/glTF/tree/main/extensions/2.0/Vendor/EXT_meshopt_compression
+
+enum class MeshoptMode {
+    // Vertex attributes, byte deltas between consecutive elements
+    ATTRIBUTES,
+    // Triangle list indices, edge and vertex FIFO coded
+    TRIANGLES,
+    // Any other indices, varint deltas
+    INDICES
+};
+
+enum class MeshoptFilter {
+    NONE,
+    // Unit vectors stored as 4 x int8/int16 octahedral coordinates
+    OCTAHEDRAL,
+    // Unit quaternions stored as 4 x int16, largest component dropped
+    QUATERNION,
+    // Floats stored as a 24 bit mantissa and an 8 bit exponent
+    EXPONENTIAL
+};
+
+// Decodes count elements of stride bytes from data into out, which must hold
+// count*stride bytes. Returns false if data is malformed or doesn't match
+// count and stride.
+bool DecodeMeshopt(unsigned char *out, size_t count, size_t stride, MeshoptMode mode, MeshoptFilter filter,
+                   const unsigned char *data, size_t size);
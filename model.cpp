@@ -1,5 +1,7 @@
 #include "model.h"
 
+#include <algorithm>
+
 struct Varyings {
     float4 position;
     float3 color;
@@ -7,26 +9,38 @@ struct Varyings {
     Varyings() = default;
 };
 
-Varyings vertex_shader(const float3 &position,
-                       const float3 &color,
-                       const float2 &texture_coord,
-                       const float4x4 &mvp) {
-    Varyings vout;
-    vout.position.x = position.x;
-    vout.position.y = position.y;
-    vout.position.z = position.z;
-    vout.position.w = 1;
-    vout.position = mvp*vout.position;
-    vout.position = vout.position/vout.position.w;
-    vout.color = color;
-    vout.texture_coord = texture_coord;
-    return vout;
+// Transforms a position to normalized device coordinates
+float4 vertex_shader(const float3 &position, const float4x4 &mvp) {
+    float4 out(position.x, position.y, position.z, 1);
+    out = mvp*out;
+    return out/out.w;
 }
 
-float3 fragment_shader(const Varyings &frag_in, const std::shared_ptr<Texture> &texture) {
-    float2 coord = frag_in.texture_coord;
-    float4 c = texture->Sample(coord);
-    return float3(c.x, c.y, c.z);
+// Shades the four pixels of a 2x2 quad together so the texture fetches can be
+// batched. Texture coordinate derivatives are taken across the quad.
+// Without a base color texture the material's base color is used, or the
+// vertex colors if there is no material either.
+void fragment_shader_quad(const Varyings frag_in[4], const Material *material, float3 colors[4]) {
+    if (material == nullptr || material->base_color_texture == nullptr) {
+        for (int q = 0; q < 4; q++) {
+            colors[q] = (material == nullptr) ? frag_in[q].color :
+                        float3(material->base_color_factor.x, material->base_color_factor.y,
+                               material->base_color_factor.z);
+        }
+        return;
+    }
+    const std::shared_ptr<Texture> &texture = material->base_color_texture;
+    float2 coords[4];
+    for (int q = 0; q < 4; q++) {
+        coords[q] = frag_in[q].texture_coord;
+    }
+    float2 ddx = coords[1] - coords[0];
+    float2 ddy = coords[2] - coords[0];
+    float4 c[4];
+    texture->SampleQuad(coords, ddx, ddy, c);
+    for (int q = 0; q < 4; q++) {
+        colors[q] = float3(c[q].x, c[q].y, c[q].z);
+    }
 }
 
 float edge_function(const float4 &a, const float4 &b, const float4 &c) {
@@ -34,88 +48,268 @@ float edge_function(const float4 &a, const float4 &b, const float4 &c) {
     return w;
 }
 
-void Model::draw(FrameBuffer &fb, const float4x4 &view_transform, const float4x4 &projection_matrix) {
-    float4x4 mvp = projection_matrix*view_transform*transform;
-    std::array<Varyings, 3> vertex_outs;
-    int depth_test_failure_count = 0;
-    for (int i = 0; i < mesh->num_triangles; i++) {    
-        float2 bbmin(INFINITY, INFINITY);
-        float2 bbmax(-INFINITY, -INFINITY);
-        bool use_indices = (mesh->indices.size() != 0);
-        for (int vid = 0; vid < 3; vid++) {
-            // run vertex shading
-            int index = -1;
-            if (use_indices) {
-                index = mesh->indices[i*3 + vid];
-            } else {
-                index = i*3 + vid;
-            }
-            float3 pos_in = mesh->vertices[index];
-            float3 color_in = mesh->colors[index];
-            float2 texture_coord = mesh->texcoords[index];
-            Varyings vertex_out = vertex_shader(pos_in, color_in, texture_coord, mvp);
-            if (vertex_out.position.x < bbmin.x) bbmin.x = vertex_out.position.x;
-            if (vertex_out.position.y < bbmin.y) bbmin.y = vertex_out.position.y;
-            if (vertex_out.position.x > bbmax.x) bbmax.x = vertex_out.position.x;
-            if (vertex_out.position.y > bbmax.y) bbmax.y = vertex_out.position.y;
-            vertex_outs[vid] = vertex_out;
-        }
-        //exit(0);
+// Rasterize and shade one triangle whose vertices are in normalized device
+// coordinates, bbmin/bbmax bounding them
+void rasterize_triangle(FrameBuffer &fb, const std::array<Varyings, 3> &vertex_outs, const float2 &bbmin,
+                        const float2 &bbmax, const Material *material) {
+    // TODO: Clipping
+    // FIXME:Some missing steps here after vertex shader is run...
 
-        // TODO: Clipping
-        // FIXME:Some missing steps here after vertex shader is run...
+    // Rasterize and shade
+    // https://www.scratchapixel.com/lessons/3d-basic-rendering/rasterization-practical-implementation/rasterization-stage
+    float area = edge_function(vertex_outs[0].position, vertex_outs[1].position, vertex_outs[2].position);
+    if (area == 0) {
+        return;
+    }
+    // Pixel x has its center at (x * 2.0/fb.width) - 1.0 + (1.0 / fb.width) in NDC
+    int x_min = std::max(0, int(std::ceil((bbmin.x + 1.0)*fb.width/2 - 0.5)));
+    int x_max = std::min(fb.width - 1, int(std::floor((bbmax.x + 1.0)*fb.width/2 - 0.5)));
+    int y_min = std::max(0, int(std::ceil((bbmin.y + 1.0)*fb.height/2 - 0.5)));
+    int y_max = std::min(fb.height - 1, int(std::floor((bbmax.y + 1.0)*fb.height/2 - 0.5)));
 
-        // Rasterize and shade
-        // https://www.scratchapixel.com/lessons/3d-basic-rendering/rasterization-practical-implementation/rasterization-stage
-        float4 p;
-        for (int x = 0; x < fb.width; x++) {
-            p.x = (x * 2.0/fb.width) - 1.0 + (1.0 / fb.width);
-            if (p.x < bbmin.x || p.x > bbmax.x) {
-                continue;
-            }
-            for (int y = 0; y < fb.height; y++) {
+    // Walk the bounding box in 2x2 pixel quads so texture coordinate
+    // derivatives can be taken between neighbouring pixels. Pixels of a
+    // quad outside the triangle are still interpolated (helper pixels)
+    // but never written.
+    for (int qy = y_min & ~1; qy <= y_max; qy += 2) {
+        for (int qx = x_min & ~1; qx <= x_max; qx += 2) {
+            float w[4][3];
+            float2 uv[4];
+            bool covered[4];
+            bool any_covered = false;
+            for (int q = 0; q < 4; q++) {
+                int x = qx + (q & 1);
+                int y = qy + (q >> 1);
+                float4 p;
+                p.x = (x * 2.0/fb.width) - 1.0 + (1.0 / fb.width);
                 p.y = (y * 2.0/fb.height) - 1.0 + (1.0 / fb.height);
-                if (p.y < bbmin.y || p.y > bbmax.y) {
-                    continue;
-                }
-                // Check if pixel is covered by triangle
-                float area = edge_function(vertex_outs[0].position, vertex_outs[1].position, vertex_outs[2].position);
                 float e01 = edge_function(p, vertex_outs[0].position, vertex_outs[1].position);
                 float e12 = edge_function(p, vertex_outs[1].position, vertex_outs[2].position);
                 float e20 = edge_function(p, vertex_outs[2].position, vertex_outs[0].position);
+                // Compute barycentrics
+                w[q][0] = e12/area;
+                w[q][1] = e20/area;
+                w[q][2] = e01/area;
+                uv[q] = w[q][0]*vertex_outs[0].texture_coord + w[q][1]*vertex_outs[1].texture_coord + w[q][2]*vertex_outs[2].texture_coord;
+                covered[q] = (e01 >= 0) && (e12 >= 0) && (e20 >= 0) &&
+                             x <= x_max && y <= y_max;
+                any_covered = any_covered || covered[q];
+            }
+            if (!any_covered) {
+                continue;
+            }
+            bool passed[4];
+            bool any_passed = false;
+            Varyings varyings[4];
+            for (int q = 0; q < 4; q++) {
+                float w0 = w[q][0];
+                float w1 = w[q][1];
+                float w2 = w[q][2];
 
-                // If pixel is covered
-                if ((e01 >= 0) && (e12 >= 0) && (e20 >= 0)) {
-                    // Compute barycentrics
-                    float w2 = e01/area;
-                    float w0 = e12/area;
-                    float w1 = e20/area;
-
-                    // Compute Z-value
-                    float inverse_z = w0/vertex_outs[0].position.z + w1/vertex_outs[1].position.z + w2/vertex_outs[2].position.z;
-                    float new_z = 1/inverse_z;
-                    
-                    
-                    // Do depth testing
-                    float old_z = fb.readDepth(Coord2D(x, y));
-                    if (new_z < old_z) {         
-                        fb.writeDepth(Coord2D(x, y), new_z);
-
-                        // Interpolate varyings using barycentrics computed above
-                        Varyings varyings;
-                        varyings.position = w0*vertex_outs[0].position + w1*vertex_outs[1].position + w2*vertex_outs[2].position;
-                        varyings.position.z = new_z;
-                        varyings.color = w0*vertex_outs[0].color + w1*vertex_outs[1].color + w2*vertex_outs[2].color;
-                        varyings.texture_coord = w0*vertex_outs[0].texture_coord + w1*vertex_outs[1].texture_coord + w2*vertex_outs[2].texture_coord;
-                        // Run fragment shader
-                        float3 color = fragment_shader(varyings, material->base_color_texture);
-                        fb.writeColor(Coord2D(x, y), color);
-                    } else {
-                        depth_test_failure_count++;
-                    }
+                // Compute Z-value
+                float inverse_z = w0/vertex_outs[0].position.z + w1/vertex_outs[1].position.z + w2/vertex_outs[2].position.z;
+                float new_z = 1/inverse_z;
+
+                // Interpolate varyings using barycentrics computed above,
+                // helper pixels included
+                varyings[q].position = w0*vertex_outs[0].position + w1*vertex_outs[1].position + w2*vertex_outs[2].position;
+                varyings[q].position.z = new_z;
+                varyings[q].color = w0*vertex_outs[0].color + w1*vertex_outs[1].color + w2*vertex_outs[2].color;
+                varyings[q].texture_coord = uv[q];
+
+                // Do depth testing
+                passed[q] = false;
+                if (!covered[q]) {
+                    continue;
+                }
+                Coord2D coord(qx + (q & 1), qy + (q >> 1));
+                if (new_z < fb.readDepth(coord)) {
+                    fb.writeDepth(coord, new_z);
+                    passed[q] = true;
+                    any_passed = true;
+                }
+            }
+            if (!any_passed) {
+                continue;
+            }
+
+            // Run fragment shader
+            float3 colors[4];
+            fragment_shader_quad(varyings, material, colors);
+            for (int q = 0; q < 4; q++) {
+                if (passed[q]) {
+                    fb.writeColor(Coord2D(qx + (q & 1), qy + (q >> 1)), colors[q]);
                 }
             }
         }
     }
-    // std::cout << "Failed depth test " << depth_test_failure_count << " times\n";
-}
\ No newline at end of file
+}
+
+// Rasterize the triangle with vertices triangle[0..2] of mesh, whose
+// positions have been transformed to normalized device coordinates
+static void draw_triangle(FrameBuffer &fb, const Mesh &mesh, const uint32_t triangle[3],
+                          const std::vector<float4> &positions, const std::vector<float2> &texture_coords,
+                          const Material *material) {
+    std::array<Varyings, 3> vertex_outs;
+    float2 bbmin(INFINITY, INFINITY);
+    float2 bbmax(-INFINITY, -INFINITY);
+    for (int vid = 0; vid < 3; vid++) {
+        uint32_t index = triangle[vid];
+        Varyings &vertex_out = vertex_outs[vid];
+        vertex_out.position = positions[index];
+        vertex_out.color = mesh.colors[index];
+        vertex_out.texture_coord = texture_coords[index];
+        if (vertex_out.position.x < bbmin.x) bbmin.x = vertex_out.position.x;
+        if (vertex_out.position.y < bbmin.y) bbmin.y = vertex_out.position.y;
+        if (vertex_out.position.x > bbmax.x) bbmax.x = vertex_out.position.x;
+        if (vertex_out.position.y > bbmax.y) bbmax.y = vertex_out.position.y;
+    }
+    rasterize_triangle(fb, vertex_outs, bbmin, bbmax, material);
+}
+
+// Position of the camera in the space model_view transforms from. model_view
+// is affine, x' = A*x + t, so the camera (the origin) is at -A^-1*t. mirrored
+// is set if A flips the winding of triangles, false if A is singular.
+static float3 camera_position(const float4x4 &model_view, bool &mirrored, bool &singular) {
+    float a = model_view.row0.x, b = model_view.row0.y, c = model_view.row0.z;
+    float d = model_view.row1.x, e = model_view.row1.y, f = model_view.row1.z;
+    float g = model_view.row2.x, h = model_view.row2.y, i = model_view.row2.z;
+    float det = a*(e*i - f*h) - b*(d*i - f*g) + c*(d*h - e*g);
+    mirrored = det < 0;
+    singular = det == 0;
+    if (singular) {
+        return float3(0, 0, 0);
+    }
+    float3 t(model_view.row0.w, model_view.row1.w, model_view.row2.w);
+    float3 inverse0 = (1/det)*float3(e*i - f*h, c*h - b*i, b*f - c*e);
+    float3 inverse1 = (1/det)*float3(f*g - d*i, a*i - c*g, c*d - a*f);
+    float3 inverse2 = (1/det)*float3(d*h - e*g, b*g - a*h, a*e - b*d);
+    return float3(-dot(inverse0, t), -dot(inverse1, t), -dot(inverse2, t));
+}
+
+// Draw the meshlets of mesh that are inside the left, right, bottom and top
+// planes of the view frustum and not entirely back facing. Only the
+// vertices of those meshlets are transformed, positions[v] is valid for the
+// current instance where transformed_instance[v] == instance.
+static void draw_meshlets(FrameBuffer &fb, const Mesh &mesh, const Material *material, const float4x4 &model_view,
+                          const float4x4 &mvp, const std::vector<float2> &texture_coords,
+                          std::vector<float4> &positions, std::vector<uint32_t> &transformed_instance,
+                          uint32_t instance) {
+    // Frustum planes in mesh space, -w <= x <= w and -w <= y <= w in clip space
+    float4 planes[4] = {mvp.row3 + mvp.row0, mvp.row3 - mvp.row0, mvp.row3 + mvp.row1, mvp.row3 - mvp.row1};
+    for (float4 &plane : planes) {
+        float length = magnitude(float3(plane.x, plane.y, plane.z));
+        if (length > 0) {
+            plane = (1/length)*plane;
+        }
+    }
+    bool mirrored;
+    bool singular;
+    float3 camera = camera_position(model_view, mirrored, singular);
+    for (const Meshlet &meshlet : mesh.meshlets) {
+        bool outside = false;
+        for (const float4 &plane : planes) {
+            float distance = plane.x*meshlet.center.x + plane.y*meshlet.center.y + plane.z*meshlet.center.z + plane.w;
+            outside = outside || distance < -meshlet.radius;
+        }
+        if (outside) {
+            continue;
+        }
+        // Front faces wind counter-clockwise, so a mirroring transform
+        // turns the cone around
+        if (!singular) {
+            float3 axis = mirrored ? -1.0f*meshlet.cone_axis : meshlet.cone_axis;
+            float3 to_center = meshlet.center - camera;
+            if (dot(to_center, axis) >= meshlet.cone_cutoff*magnitude(to_center) + meshlet.radius) {
+                continue;
+            }
+        }
+        const uint32_t *vertices = &mesh.meshlet_vertices[meshlet.vertex_offset];
+        for (uint32_t i = 0; i < meshlet.vertex_count; i++) {
+            uint32_t v = vertices[i];
+            if (transformed_instance[v] != instance) {
+                positions[v] = vertex_shader(mesh.position(v), mvp);
+                transformed_instance[v] = instance;
+            }
+        }
+        const uint8_t *triangles = &mesh.meshlet_triangles[meshlet.triangle_offset];
+        for (uint32_t t = 0; t < meshlet.triangle_count; t++) {
+            uint32_t triangle[3] = {vertices[triangles[t*3]], vertices[triangles[t*3 + 1]], vertices[triangles[t*3 + 2]]};
+            draw_triangle(fb, mesh, triangle, positions, texture_coords, material);
+        }
+    }
+}
+
+void Model::draw(FrameBuffer &fb, const float4x4 &view_transform, const float4x4 &projection_matrix) const {
+    if (instances.empty()) {
+        DrawMeshInstances(fb, *mesh, material.get(), &transform, 1, view_transform, projection_matrix);
+        return;
+    }
+    std::vector<float4x4> transforms(instances.size());
+    for (size_t i = 0; i < instances.size(); i++) {
+        transforms[i] = transform*instances[i];
+    }
+    DrawMeshInstances(fb, *mesh, material.get(), transforms.data(), transforms.size(), view_transform, projection_matrix);
+}
+
+void DrawMeshInstances(FrameBuffer &fb, const Mesh &mesh, const Material *material, const float4x4 *transforms,
+                       size_t count, const float4x4 &view_transform, const float4x4 &projection_matrix) {
+    // Texcoords go through the base color texture's transform, with the
+    // dequantization scale folded in: uv' = u*uv_axis_u + v*uv_axis_v + offset
+    TextureTransform uv_transform = (material != nullptr) ? material->base_color_transform : TextureTransform();
+    float texcoord_scale = mesh.texcoord_scale();
+    float uv_cos = std::cos(uv_transform.rotation);
+    float uv_sin = std::sin(uv_transform.rotation);
+    float2 uv_axis_u = (texcoord_scale*uv_transform.scale.x)*float2(uv_cos, -uv_sin);
+    float2 uv_axis_v = (texcoord_scale*uv_transform.scale.y)*float2(uv_sin, uv_cos);
+    // Texture coordinates are the same for all instances, positions are
+    // transformed once per instance and shared by the triangles using them
+    size_t vertex_count = mesh.vertex_count();
+    bool has_texcoords = !mesh.texcoords.empty() || !mesh.quantized_texcoords.empty();
+    std::vector<float2> texture_coords(vertex_count, uv_transform.offset);
+    if (has_texcoords) {
+        for (size_t v = 0; v < vertex_count; v++) {
+            float2 uv = mesh.texcoord(v);
+            texture_coords[v] = uv.x*uv_axis_u + uv.y*uv_axis_v + uv_transform.offset;
+        }
+    }
+    std::vector<float4> positions(vertex_count);
+    // Quantized positions are dequantized by the model matrix
+    float position_scale = mesh.position_scale();
+    float4x4 dequantize = scalingMatrix(position_scale, position_scale, position_scale);
+    bool use_indices = mesh.indexed();
+    // Meshlets transform their vertices on demand, once per instance
+    std::vector<uint32_t> transformed_instance;
+    if (!mesh.meshlets.empty()) {
+        transformed_instance.assign(vertex_count, 0);
+    }
+    for (size_t instance = 0; instance < count; instance++) {
+        float4x4 mvp = projection_matrix*view_transform*transforms[instance]*dequantize;
+        if (!mesh.meshlets.empty()) {
+            float4x4 model_view = view_transform*transforms[instance]*dequantize;
+            draw_meshlets(fb, mesh, material, model_view, mvp, texture_coords, positions, transformed_instance,
+                          instance + 1);
+            continue;
+        }
+        float2 instance_min(INFINITY, INFINITY);
+        float2 instance_max(-INFINITY, -INFINITY);
+        for (size_t v = 0; v < vertex_count; v++) {
+            positions[v] = vertex_shader(mesh.position(v), mvp);
+            instance_min.x = std::min(instance_min.x, positions[v].x);
+            instance_min.y = std::min(instance_min.y, positions[v].y);
+            instance_max.x = std::max(instance_max.x, positions[v].x);
+            instance_max.y = std::max(instance_max.y, positions[v].y);
+        }
+        // Instances entirely off screen cover no pixels
+        if (instance_max.x < -1 || instance_min.x > 1 || instance_max.y < -1 || instance_min.y > 1) {
+            continue;
+        }
+        for (int i = 0; i < mesh.num_triangles; i++) {
+            uint32_t triangle[3];
+            for (int vid = 0; vid < 3; vid++) {
+                triangle[vid] = use_indices ? mesh.index(i*3 + vid) : i*3 + vid;
+            }
+            draw_triangle(fb, mesh, triangle, positions, texture_coords, material);
+        }
+    }
+}
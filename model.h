@@ -8,9 +8,19 @@
 class Model {
     public:
     Model() : mesh(nullptr), transform(identity()), material(nullptr) {}
-    Model(std::shared_ptr<Mesh> _m, float4x4 _transform = identity()) : mesh(_m), transform(_transform) {}
-    std::shared_ptr<Mesh> mesh;
+    Model(std::shared_ptr<const Mesh> _m, float4x4 _transform = identity()) : mesh(_m), transform(_transform) {}
+    std::shared_ptr<const Mesh> mesh;
     float4x4 transform;
     std::shared_ptr<Material> material;
-    void draw(FrameBuffer &fb, const float4x4 &view_transform, const float4x4 &projection_matrix);
-};
\ No newline at end of file
+    // EXT_mesh_gpu_instancing: transforms of the instances relative to
+    // transform, empty to draw the mesh once
+    std::vector<float4x4> instances;
+    void draw(FrameBuffer &fb, const float4x4 &view_transform, const float4x4 &projection_matrix) const;
+};
+
+// Draw mesh once per transform in a single pass: vertex attributes that
+// don't depend on the instance are set up once, each instance's vertices
+// are transformed once and shared by its triangles, and instances entirely
+// off screen are skipped. material may be null.
+void DrawMeshInstances(FrameBuffer &fb, const Mesh &mesh, const Material *material, const float4x4 *transforms,
+                       size_t count, const float4x4 &view_transform, const float4x4 &projection_matrix);
\ No newline at end of file
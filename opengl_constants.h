@@ -1,3 +1,4 @@
+#pragma once
 /*
     GL_BYTE (5120)
     GL_DOUBLE (5130)
@@ -11,4 +12,25 @@
     GL_UNSIGNED_INT (5125)
     GL_UNSIGNED_INT64_AMD (35778)
     GL_UNSIGNED_SHORT (5123)
-*/
\ No newline at end of file
+*/
+
+// Accessor component types (glTF accessor.componentType)
+constexpr int GL_BYTE = 5120;
+constexpr int GL_UNSIGNED_BYTE = 5121;
+constexpr int GL_SHORT = 5122;
+constexpr int GL_UNSIGNED_SHORT = 5123;
+constexpr int GL_UNSIGNED_INT = 5125;
+constexpr int GL_FLOAT = 5126;
+
+// Sampler filters (glTF sampler.magFilter/minFilter)
+constexpr int GL_NEAREST = 9728;
+constexpr int GL_LINEAR = 9729;
+constexpr int GL_NEAREST_MIPMAP_NEAREST = 9984;
+constexpr int GL_LINEAR_MIPMAP_NEAREST = 9985;
+constexpr int GL_NEAREST_MIPMAP_LINEAR = 9986;
+constexpr int GL_LINEAR_MIPMAP_LINEAR = 9987;
+
+// Sampler wrap modes (glTF sampler.wrapS/wrapT)
+constexpr int GL_REPEAT = 10497;
+constexpr int GL_CLAMP_TO_EDGE = 33071;
+constexpr int GL_MIRRORED_REPEAT = 33648;
\ No newline at end of file
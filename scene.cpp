@@ -1,4 +1,13 @@
 #include "scene.h"
+#include "asset_cache.h"
+#include "gltf_buffer.h"
+#include "draco.h"
+#include "mesh_optimizer.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
 
 void Scene::update(const Camera &c) {
     float3 eye(cos(c.yaw) * cos(c.pitch), sin(c.pitch), -sin(c.yaw)*cos(c.pitch));
@@ -8,135 +17,592 @@ void Scene::update(const Camera &c) {
     float3 at(0, 0, 0);
     float3 up(0, 1, 0);
     view_matrix = lookAtMatrix(eye, at, up);
+    graph.update();
+}
+
+void Scene::add(const Scene &other) {
+    models.insert(models.end(), other.models.begin(), other.models.end());
+    graph.append(other.graph);
 }
 
+// Instances of one mesh with one material
+struct DrawBatch {
+    const Mesh *mesh;
+    const Material *material;
+    std::vector<float4x4> transforms;
+};
+
 void Scene::Render(FrameBuffer &fb) {
     fb.clear(); 
+    // Models sharing a mesh and material, e.g. the repeated parts of an
+    // assembly, are drawn together in the order they first appear
+    std::map<std::pair<const Mesh *, const Material *>, size_t> batch_ids;
+    std::vector<DrawBatch> batches;
     for (size_t i = 0; i < models.size(); i++) {
-        std::shared_ptr<Model> &m = models[i];
-        m->draw(fb, view_matrix, projection_matrix);
-    }
-}
-
-template<typename T>
-std::vector<T> access_data(const json &j, std::string base_path, int accessor_id) {
-    std::vector<T> data;
-    auto accessor = j["accessors"][accessor_id];
-    auto buffer_view = j["bufferViews"][int(accessor["bufferView"])];
-    int buffer_index = int(buffer_view["buffer"]);
-    std::string bin_uri = j["buffers"][buffer_index]["uri"];
-    std::string bin_path = base_path + bin_uri;
-    std::ifstream bin_stream(bin_path, std::ios::binary);
-    int count = accessor["count"];
-    int buffer_view_byte_offset = (buffer_view["byteOffset"] == nullptr)
-                                ? 0 : buffer_view["byteOffset"].get<int>();
-    int accessor_byte_offset = (accessor["byteOffset"] == nullptr)
-                                ? 0 : accessor["byteOffset"].get<int>();
-    int byte_offset = buffer_view_byte_offset + accessor_byte_offset;
-    int stride = (buffer_view["byteStride"] == nullptr) 
-                                ? sizeof(T) : int(buffer_view["byteStride"]);
-    bin_stream.seekg(byte_offset);
-    for (int i = 0; i < count; i++) {
-        T d;
-        bin_stream.read(reinterpret_cast<char*>(&d), sizeof(T));
-        data.push_back(d);
-        bin_stream.seekg(int(bin_stream.tellg()) - sizeof(T) + stride);
-    }
-    return data;
-}
-
-std::vector<std::shared_ptr<Model>> process_node(const json &j,
-                                std::string base_path,
-                                int node_id,
-                                std::vector<std::shared_ptr<Material>> materials) {
-    std::vector<std::shared_ptr<Model>> models;
-    json node = j["nodes"][node_id];
-    // Handle all children
-    if (node["children"] != nullptr) {
-        for (int child_id : node["children"]) {
-            std::vector<std::shared_ptr<Model>> child_models = process_node(j, base_path, child_id, materials);
-            models.insert(models.end(), child_models.begin(), child_models.end());
-        }
-    }
-    
-    std::shared_ptr<Model> model(nullptr);
-    std::shared_ptr<Mesh> mesh(nullptr);
-
-    // If node is a mesh node, create a model
-    if (node["mesh"] != nullptr) {
-        int mesh_id = node["mesh"];
-        auto mesh_j = j["meshes"][mesh_id];
-        std::cout << "Mesh = " << mesh << "\n";
-        for (auto primitive : mesh_j["primitives"]) {
-            std::cout << "Primitive = " << primitive << "\n";
-            auto attributes = primitive["attributes"];
-            std::cout << "Attributes = " << attributes << "\n";
-            // Get positions
-            int position_accessor_id = attributes["POSITION"];
-            std::vector<float3> positions_data = access_data<float3>(j, 
-                                                base_path, position_accessor_id);
-            std::cout << "Got positions data\n";
-            mesh = std::make_shared<Mesh>(positions_data.size()/3, positions_data);
-
-            // Get indices
-            if (primitive["indices"] != nullptr) {
-                std::cout << "Indices are present\n";
-                std::vector<uint16_t> indices = access_data<uint16_t>(j, 
-                                                base_path, primitive["indices"]);
-                mesh->indices = indices;
-                // FIXME: Hacking correct num_triangles here
-                mesh->num_triangles = mesh->indices.size()/3;
-            }
+        const Model &m = *models[i];
+        auto key = std::make_pair(m.mesh.get(), m.material.get());
+        auto inserted = batch_ids.emplace(key, batches.size());
+        if (inserted.second) {
+            batches.push_back(DrawBatch{key.first, key.second, {}});
+        }
+        std::vector<float4x4> &transforms = batches[inserted.first->second].transforms;
+        if (m.instances.empty()) {
+            transforms.push_back(m.transform);
+        }
+        for (const float4x4 &instance : m.instances) {
+            transforms.push_back(m.transform*instance);
+        }
+    }
+    for (const DrawBatch &batch : batches) {
+        DrawMeshInstances(fb, *batch.mesh, batch.material, batch.transforms.data(), batch.transforms.size(),
+                          view_matrix, projection_matrix);
+    }
+}
 
-            // Get normals       
-            if (attributes["NORMAL"] != nullptr) {
-                int normal_id = attributes["NORMAL"];
-                auto normals_data = access_data<float3>(j, base_path, normal_id);
-                mesh->normals = normals_data;
+// Read indices of any component type, as 16 bit indices when they fit
+void load_indices(GltfBuffers &buffers, const GltfAccessor &accessor, int accessor_id, Mesh &mesh) {
+    if (accessor.component_type == GL_UNSIGNED_SHORT) {
+        mesh.indices = buffers.accessor<uint16_t>(accessor_id).to_vector();
+    } else if (accessor.component_type == GL_UNSIGNED_BYTE) {
+        AccessorView<uint8_t> view = buffers.accessor<uint8_t>(accessor_id);
+        mesh.indices.resize(view.size());
+        for (size_t i = 0; i < view.size(); i++) {
+            mesh.indices[i] = view[i];
+        }
+    } else {
+        mesh.indices32 = buffers.accessor<uint32_t>(accessor_id).to_vector();
+        if (!mesh.indices32.empty() &&
+            *std::max_element(mesh.indices32.begin(), mesh.indices32.end()) <= UINT16_MAX) {
+            mesh.indices.assign(mesh.indices32.begin(), mesh.indices32.end());
+            mesh.indices32.clear();
+        }
+    }
+}
+
+// Add weight times the displacements of a morph target accessor to values.
+// A sparse target without a bufferView only touches its sparse elements.
+void add_displacements(const GltfDocument &doc, GltfBuffers &buffers, int accessor_id, float weight,
+                       std::vector<float3> &values) {
+    const GltfAccessor &accessor = doc.accessors[accessor_id];
+    if (accessor.count != values.size()) {
+        std::cerr << "Morph target accessor " << accessor_id << " doesn't match the vertex count\n";
+        exit(-1);
+    }
+    if (accessor.component_type != GL_FLOAT) {
+        // Quantized displacements (KHR_mesh_quantization) are rare, they
+        // are read densely
+        VertexAttribute displacements = buffers.attribute(accessor_id);
+        float scale = weight*displacements.scale();
+        for (size_t i = 0; i < values.size(); i++) {
+            values[i] = values[i] + scale*displacements.get3(i);
+        }
+        return;
+    }
+    AccessorView<float3> displacements = buffers.accessor<float3>(accessor_id);
+    if (displacements.data == nullptr) {
+        for (size_t j = 0; j < displacements.sparse_indices.size(); j++) {
+            float3 &value = values[displacements.sparse_indices[j]];
+            value = value + weight*displacements.sparse_values[j];
+        }
+        return;
+    }
+    size_t j = 0;
+    for (size_t i = 0; i < values.size(); i++) {
+        bool is_sparse = j < displacements.sparse_indices.size() && displacements.sparse_indices[j] == i;
+        float3 displacement = is_sparse ? displacements.sparse_values[j++] : displacements.base(i);
+        values[i] = values[i] + weight*displacement;
+    }
+}
+
+// Apply the morph targets of a primitive with the given weights to the
+// positions and normals of mesh. Quantized positions and normals are
+// expanded to floats first if a target with a non-zero weight moves them.
+void apply_morph_targets(const GltfDocument &doc, GltfBuffers &buffers, const GltfPrimitive &primitive,
+                         const std::vector<float> &weights, Mesh &mesh) {
+    bool moved_normals = false;
+    for (size_t target_id = 0; target_id < primitive.targets.size() && target_id < weights.size(); target_id++) {
+        float weight = weights[target_id];
+        if (weight == 0) {
+            continue;
+        }
+        const std::map<std::string, int> &target = primitive.targets[target_id];
+        auto position = target.find("POSITION");
+        if (position != target.end()) {
+            if (!mesh.quantized_vertices.empty()) {
+                float scale = mesh.quantized_vertices.scale();
+                mesh.vertices.resize(mesh.quantized_vertices.size());
+                for (size_t i = 0; i < mesh.vertices.size(); i++) {
+                    mesh.vertices[i] = scale*mesh.quantized_vertices.get3(i);
+                }
+                mesh.quantized_vertices = VertexAttribute();
             }
-            // Get TEXCOORD_0
-            if (attributes["TEXCOORD_0"] != nullptr) {
-                int texcoord_id = attributes["TEXCOORD_0"];
-                auto texture_coord_data = access_data<float2>(j, base_path, texcoord_id);
-                mesh->texcoords = texture_coord_data;
+            add_displacements(doc, buffers, position->second, weight, mesh.vertices);
+        }
+        auto normal = target.find("NORMAL");
+        if (normal != target.end() && (!mesh.normals.empty() || !mesh.quantized_normals.empty())) {
+            if (!mesh.quantized_normals.empty()) {
+                mesh.normals.resize(mesh.quantized_normals.size());
+                for (size_t i = 0; i < mesh.normals.size(); i++) {
+                    mesh.normals[i] = mesh.normal(i);
+                }
+                mesh.quantized_normals = VertexAttribute();
+            }
+            add_displacements(doc, buffers, normal->second, weight, mesh.normals);
+            moved_normals = true;
+        }
+    }
+    if (moved_normals) {
+        for (float3 &n : mesh.normals) {
+            float length = magnitude(n);
+            if (length > 0) {
+                n = n/length;
             }
+        }
+    }
+}
+
+// Read the vertex/index data of a mesh primitive. Float attributes are
+// expanded into the float vectors of the mesh, quantized ones
+// (KHR_mesh_quantization) are kept in their component type. Morph targets
+// are applied with weights.
+std::shared_ptr<Mesh> load_primitive(const GltfDocument &doc, GltfBuffers &buffers, const GltfPrimitive &primitive,
+                                     const std::vector<float> &weights) {
+    // Get positions
+    int position_accessor_id = primitive.attribute("POSITION");
+    const GltfAccessor &position_accessor = doc.accessors[position_accessor_id];
+    int num_triangles = position_accessor.count/3;
+    std::shared_ptr<Mesh> mesh;
+    if (position_accessor.component_type == GL_FLOAT) {
+        std::vector<float3> positions_data = buffers.accessor<float3>(position_accessor_id).to_vector();
+        mesh = std::make_shared<Mesh>(num_triangles, positions_data);
+    } else {
+        mesh = std::make_shared<Mesh>(num_triangles, buffers.attribute(position_accessor_id));
+    }
+    std::cout << "Got positions data\n";
+
+    // Get indices
+    if (primitive.indices != -1) {
+        std::cout << "Indices are present\n";
+        load_indices(buffers, doc.accessors[primitive.indices], primitive.indices, *mesh);
+        // FIXME: Hacking correct num_triangles here
+        mesh->num_triangles = doc.accessors[primitive.indices].count/3;
+    }
 
-            model = std::make_shared<Model>(mesh);
+    // Get normals
+    int normal_id = primitive.attribute("NORMAL");
+    if (normal_id != -1) {
+        if (doc.accessors[normal_id].component_type == GL_FLOAT) {
+            mesh->normals = buffers.accessor<float3>(normal_id).to_vector();
+        } else {
+            mesh->quantized_normals = buffers.attribute(normal_id);
+        }
+    }
+    // Get TEXCOORD_0
+    int texcoord_id = primitive.attribute("TEXCOORD_0");
+    if (texcoord_id != -1) {
+        if (doc.accessors[texcoord_id].component_type == GL_FLOAT) {
+            mesh->texcoords = buffers.accessor<float2>(texcoord_id).to_vector();
+        } else {
+            mesh->quantized_texcoords = buffers.attribute(texcoord_id);
+        }
+    }
+    apply_morph_targets(doc, buffers, primitive, weights, *mesh);
+    return mesh;
+}
 
-            // Get material
-            if (primitive["material"] != nullptr) {
-                int material_id = primitive["material"].get<int>();
-                model->material = materials[material_id];    
-            }    
-            models.push_back(model);
+// EXT_mesh_gpu_instancing transforms of a node, translation * rotation *
+// scale per instance. Rotations may be normalized integers.
+std::vector<float4x4> load_instances(GltfBuffers &buffers, const GltfNode &node) {
+    VertexAttribute attributes[3];
+    const char *names[3] = {"TRANSLATION", "ROTATION", "SCALE"};
+    size_t count = 0;
+    for (int a = 0; a < 3; a++) {
+        auto it = node.instancing_attributes.find(names[a]);
+        if (it != node.instancing_attributes.end()) {
+            attributes[a] = buffers.attribute(it->second);
+            count = std::max(count, attributes[a].size());
         }
-    } else if (node["camera"] != nullptr) {
+    }
+    const VertexAttribute &translations = attributes[0];
+    const VertexAttribute &rotations = attributes[1];
+    const VertexAttribute &scales = attributes[2];
+    std::vector<float4x4> instances(count, identity());
+    for (size_t i = 0; i < count; i++) {
+        float3 t = (i < translations.size()) ? translations.get3(i) : float3(0, 0, 0);
+        float4 r(0, 0, 0, 1);
+        if (i < rotations.size()) {
+            float scale = rotations.scale();
+            r = float4(std::max(scale*rotations.component(i, 0), -1.0f), std::max(scale*rotations.component(i, 1), -1.0f),
+                       std::max(scale*rotations.component(i, 2), -1.0f), std::max(scale*rotations.component(i, 3), -1.0f));
+        }
+        float3 s = (i < scales.size()) ? scales.get3(i) : float3(1, 1, 1);
+        instances[i] = translationMatrix(t.x, t.y, t.z)*rotationMatrix(r)*scalingMatrix(s.x, s.y, s.z);
+    }
+    return instances;
+}
+
+// Asset cache key of a mesh primitive, optimized meshes and meshes split
+// into meshlets get their own
+std::string primitive_key(const std::string &gltf_key, int mesh_id, int primitive_id, const LoadOptions &options) {
+    std::string suffix = options.optimize_meshes ? "#opt" : "";
+    if (options.build_meshlets) {
+        suffix += "#meshlets";
+    }
+    return gltf_key + "#mesh" + std::to_string(mesh_id) + "/" + std::to_string(primitive_id) + suffix;
+}
+
+// Run the load-time passes requested by options on a freshly loaded mesh
+std::shared_ptr<const Mesh> finish_mesh(std::shared_ptr<Mesh> mesh, const LoadOptions &options) {
+    if (mesh == nullptr) {
+        return mesh;
+    }
+    if (options.optimize_meshes) {
+        OptimizeMesh(*mesh);
+    }
+    // Meshlets follow the optimized triangle order
+    if (options.build_meshlets) {
+        BuildMeshlets(*mesh);
+    }
+    return mesh;
+}
+
+// Draco compressed primitives may keep uncompressed accessors as a fallback,
+// the compressed data is always preferred
+bool use_draco(const GltfDocument &, const GltfPrimitive &primitive) {
+    return primitive.draco_buffer_view != -1;
+}
+
+// True if the uncompressed accessors of a Draco compressed primitive hold
+// data, and can be read when the compressed data can't be decoded
+bool has_draco_fallback(const GltfDocument &doc, const GltfPrimitive &primitive) {
+    int position_id = primitive.attribute("POSITION");
+    return position_id != -1 && doc.accessors[position_id].buffer_view != -1;
+}
+
+// A node with a mesh, whose primitives become models of graph_node
+struct MeshNode {
+    int node_id;
+    int graph_node;
+};
+
+// Add node_id and its descendants to graph under parent. Mesh nodes are
+// appended to mesh_nodes children first, the order their models are drawn in.
+void add_nodes(const GltfDocument &doc, int node_id, SceneGraph &graph, int parent, std::vector<MeshNode> &mesh_nodes) {
+    const GltfNode &node = doc.nodes[node_id];
+    int graph_node = graph.add_node(parent, node.name);
+    if (node.has_matrix) {
+        const float *m = node.matrix;
+        graph.set_matrix(graph_node, float4x4(float4(m[0], m[4], m[8], m[12]), float4(m[1], m[5], m[9], m[13]),
+                                              float4(m[2], m[6], m[10], m[14]), float4(m[3], m[7], m[11], m[15])));
+    } else {
+        graph.set_translation(graph_node, float3(node.translation[0], node.translation[1], node.translation[2]));
+        graph.set_rotation(graph_node, float4(node.rotation[0], node.rotation[1], node.rotation[2], node.rotation[3]));
+        graph.set_scale(graph_node, float3(node.scale[0], node.scale[1], node.scale[2]));
+    }
+    // Handle all children
+    for (int child_id : node.children) {
+        add_nodes(doc, child_id, graph, graph_node, mesh_nodes);
+    }
+    if (node.mesh != -1) {
+        mesh_nodes.push_back(MeshNode{node_id, graph_node});
+    } else if (node.camera != -1) {
         std::cout << "Not handling camera ATM\n";
-    } else if (node["skin"] != nullptr) {
+    } else if (node.skin != -1) {
         std::cout << "Not handling skin ATM\n";
     }
+}
+
+// Draco decodes of all compressed primitives, by mesh and primitive.
+// Compressed bufferViews are resolved on this thread, buffers are mapped
+// lazily. The decoded meshes go to the asset cache where load_models finds
+// them.
+std::vector<std::vector<std::future<std::shared_ptr<const Mesh>>>> submit_draco_decodes(
+        const GltfDocument &doc, GltfBuffers &buffers, const std::string &gltf_key, const LoadOptions &options,
+        ThreadPool &pool) {
+    std::vector<std::vector<std::future<std::shared_ptr<const Mesh>>>> decodes(doc.meshes.size());
+    for (size_t mesh_id = 0; mesh_id < doc.meshes.size(); mesh_id++) {
+        const std::vector<GltfPrimitive> &primitives = doc.meshes[mesh_id].primitives;
+        decodes[mesh_id].resize(primitives.size());
+        for (size_t primitive_id = 0; primitive_id < primitives.size(); primitive_id++) {
+            const GltfPrimitive &primitive = primitives[primitive_id];
+            if (!use_draco(doc, primitive)) {
+                continue;
+            }
+            std::string mesh_key = primitive_key(gltf_key, mesh_id, primitive_id, options);
+            BufferData compressed = buffers.buffer_view(primitive.draco_buffer_view);
+            decodes[mesh_id][primitive_id] = pool.submit([mesh_key, compressed, &primitive, options]() {
+                return AssetCache::instance().get_mesh(mesh_key, [&]() {
+                    return finish_mesh(DecodeDracoPrimitive(compressed, primitive), options);
+                });
+            });
+        }
+    }
+    return decodes;
+}
+
+// Models of the primitives of a mesh node. gltf_key is the asset cache key
+// of the glTF file, meshes are cached under it so the same primitive is
+// only read once per process. Buffers are only mapped if a primitive isn't
+// cached yet.
+std::vector<std::shared_ptr<Model>> load_models(const GltfDocument &doc, GltfBuffers &buffers,
+                                                const std::string &gltf_key, int node_id,
+                                                const std::vector<std::shared_ptr<Material>> &materials,
+                                                const LoadOptions &options) {
+    std::vector<std::shared_ptr<Model>> models;
+    const GltfNode &node = doc.nodes[node_id];
+    int mesh_id = node.mesh;
+    std::cout << "Mesh = " << mesh_id << "\n";
+    // Node weights override the mesh's, such primitives are cached per node
+    const std::vector<float> &mesh_weights = doc.meshes[mesh_id].weights;
+    bool node_weights = !node.weights.empty() && node.weights != mesh_weights;
+    const std::vector<float> &weights = node_weights ? node.weights : mesh_weights;
+    std::vector<float4x4> instances;
+    if (!node.instancing_attributes.empty()) {
+        instances = load_instances(buffers, node);
+    }
+    int primitive_id = 0;
+    for (const GltfPrimitive &primitive : doc.meshes[mesh_id].primitives) {
+        std::string mesh_key = primitive_key(gltf_key, mesh_id, primitive_id++, options);
+        if (node_weights && !primitive.targets.empty()) {
+            mesh_key += "#node" + std::to_string(node_id);
+        }
+        std::shared_ptr<const Mesh> mesh = AssetCache::instance().get_mesh(mesh_key, [&]() {
+            if (use_draco(doc, primitive)) {
+                return finish_mesh(DecodeDracoPrimitive(buffers.buffer_view(primitive.draco_buffer_view), primitive),
+                                   options);
+            }
+            return finish_mesh(load_primitive(doc, buffers, primitive, weights), options);
+        });
+        // The failed decode stays cached as nullptr, the fallback has its own key
+        if (mesh == nullptr && use_draco(doc, primitive) && has_draco_fallback(doc, primitive)) {
+            std::cerr << "Reading the uncompressed accessors of mesh " << mesh_id << " instead\n";
+            mesh = AssetCache::instance().get_mesh(mesh_key + "#fallback", [&]() {
+                return finish_mesh(load_primitive(doc, buffers, primitive, weights), options);
+            });
+        }
+        if (mesh == nullptr) {
+            continue;
+        }
+        std::shared_ptr<Model> model = std::make_shared<Model>(mesh);
+        model->instances = instances;
+        // Get material
+        if (primitive.material != -1) {
+            model->material = materials[primitive.material];
+        }
+        models.push_back(model);
+    }
     return models;
 }
 
-Scene create_scene_from_gltf(const std::string&& base_path, const std::string&& gltf_file_name) {
-    json j;
+Scene create_scene_from_gltf(const std::string&& base_path, const std::string&& gltf_file_name,
+                             const LoadOptions &options) {
+    // .gltf or .glb, detected from the file contents
+    GltfDocument doc;
+    BufferData glb_bin;
     std::string gltf_path = base_path + gltf_file_name;
-    
-    std::ifstream gltf(gltf_path);
-    gltf >> j;
+    ReadGltfFile(gltf_path, doc, glb_bin);
     Scene scn;
+    std::string gltf_key = AssetCache::path_key(gltf_path);
+    GltfBuffers buffers(doc, base_path, glb_bin);
+
+    // Pre-Create all materials. Images decode on the pool and throw if they
+    // can't be loaded, the error is reported here rather than on a worker.
+    std::vector<std::shared_ptr<Material>> materials;
+    try {
+        materials = CreateMaterials(doc, base_path, buffers, options);
+    } catch (const std::exception &error) {
+        std::cerr << error.what() << "\n";
+        exit(-1);
+    }
 
-    // Pre-Create all materials
-    std::vector<std::shared_ptr<Material>> materials = CreateMaterials(j, base_path);
+    // Decode all Draco compressed primitives in parallel
+    ThreadPool &pool = ThreadPool::shared();
+    std::vector<std::vector<std::future<std::shared_ptr<const Mesh>>>> decodes =
+        submit_draco_decodes(doc, buffers, gltf_key, options, pool);
+    for (std::vector<std::future<std::shared_ptr<const Mesh>>> &mesh_decodes : decodes) {
+        for (std::future<std::shared_ptr<const Mesh>> &pending : mesh_decodes) {
+            if (pending.valid()) {
+                pool.wait(pending);
+            }
+        }
+    }
 
-    auto scenes = j["scenes"];
-    auto nodes = j["nodes"];
-    for (auto scene : scenes) {
-        std::cout << "Scene = " << scene << "\n";
-        for (int node_id : scene["nodes"]) {
-            std::vector<std::shared_ptr<Model>> models = process_node(j, base_path, node_id, materials);
-            scn.models.insert(scn.models.end(), models.begin(), models.end());
+    int root = scn.graph.add_node(-1, gltf_file_name);
+    std::vector<MeshNode> mesh_nodes;
+    for (size_t scene_id = 0; scene_id < doc.scenes.size(); scene_id++) {
+        std::cout << "Scene = " << scene_id << "\n";
+        for (int node_id : doc.scenes[scene_id].nodes) {
+            add_nodes(doc, node_id, scn.graph, root, mesh_nodes);
+        }
+    }
+    for (const MeshNode &mesh_node : mesh_nodes) {
+        std::vector<std::shared_ptr<Model>> models =
+            load_models(doc, buffers, gltf_key, mesh_node.node_id, materials, options);
+        for (std::shared_ptr<Model> &model : models) {
+            scn.graph.add_model(mesh_node.graph_node, model);
+            scn.models.push_back(model);
         }
     }
+    scn.graph.update();
     return scn;
-}
\ No newline at end of file
+}
+
+// State of one file loading in the background, shared with its task
+struct SceneLoader::FileLoad {
+    int root;
+    std::future<void> task;
+    std::mutex mutex;
+    // Published by the task, guarded by mutex. Nodes come first, then the
+    // models of one mesh node at a time.
+    bool parsed = false;
+    // The glTF file and every file it references
+    std::vector<std::string> sources;
+    SceneGraph graph;
+    std::vector<PendingImage> pending_images;
+    std::vector<std::pair<int, std::vector<std::shared_ptr<Model>>>> models;
+    // Render thread only: id of the file's first node in the scene graph,
+    // -1 until the nodes are added
+    int node_offset = -1;
+    std::vector<PendingImage> images;
+};
+
+int SceneLoader::load(const std::string &base_path, const std::string &gltf_file_name, const LoadOptions &options) {
+    std::shared_ptr<FileLoad> file = std::make_shared<FileLoad>();
+    file->root = scene.graph.add_node(-1, gltf_file_name);
+    ThreadPool *task_pool = &pool;
+    file->task = pool.submit([file, base_path, gltf_file_name, options, task_pool]() {
+        GltfDocument doc;
+        BufferData glb_bin;
+        std::string gltf_path = base_path + gltf_file_name;
+        ReadGltfFile(gltf_path, doc, glb_bin);
+        std::string gltf_key = AssetCache::path_key(gltf_path);
+        GltfBuffers buffers(doc, base_path, glb_bin);
+        // Textures start on a placeholder, images decode on the pool
+        std::vector<PendingImage> pending_images;
+        std::vector<std::shared_ptr<Material>> materials =
+            CreateMaterials(doc, base_path, buffers, options, &pending_images);
+        std::vector<std::vector<std::future<std::shared_ptr<const Mesh>>>> decodes =
+            submit_draco_decodes(doc, buffers, gltf_key, options, *task_pool);
+
+        SceneGraph graph;
+        std::vector<MeshNode> mesh_nodes;
+        for (const GltfScene &gltf_scene : doc.scenes) {
+            for (int node_id : gltf_scene.nodes) {
+                add_nodes(doc, node_id, graph, -1, mesh_nodes);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(file->mutex);
+            file->sources.push_back(gltf_path);
+            for (std::string &source : GltfReferencedFiles(doc, base_path)) {
+                file->sources.push_back(std::move(source));
+            }
+            file->graph = std::move(graph);
+            file->pending_images = std::move(pending_images);
+            file->parsed = true;
+        }
+        for (const MeshNode &mesh_node : mesh_nodes) {
+            // Running other queued tasks while a decode is outstanding
+            for (std::future<std::shared_ptr<const Mesh>> &pending : decodes[doc.nodes[mesh_node.node_id].mesh]) {
+                if (pending.valid()) {
+                    task_pool->wait(pending);
+                }
+            }
+            std::vector<std::shared_ptr<Model>> models =
+                load_models(doc, buffers, gltf_key, mesh_node.node_id, materials, options);
+            std::lock_guard<std::mutex> lock(file->mutex);
+            file->models.push_back(std::make_pair(mesh_node.graph_node, std::move(models)));
+        }
+        // Decodes of meshes no node uses still reference doc
+        for (std::vector<std::future<std::shared_ptr<const Mesh>>> &mesh_decodes : decodes) {
+            for (std::future<std::shared_ptr<const Mesh>> &pending : mesh_decodes) {
+                if (pending.valid()) {
+                    task_pool->wait(pending);
+                }
+            }
+        }
+    });
+    files.push_back(file);
+    return file->root;
+}
+
+size_t SceneLoader::update() {
+    size_t added = 0;
+    for (const std::shared_ptr<FileLoad> &file : files) {
+        // A failed load is reported here, its task doesn't exit on a worker
+        if (file->task.valid() && file->task.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            pool.wait_or_exit(file->task);
+        }
+        std::vector<std::pair<int, std::vector<std::shared_ptr<Model>>>> models;
+        {
+            std::lock_guard<std::mutex> lock(file->mutex);
+            if (file->parsed && file->node_offset == -1) {
+                file->node_offset = scene.graph.size();
+                scene.graph.append(file->graph, file->root);
+                file->graph = SceneGraph();
+                file->images = std::move(file->pending_images);
+            }
+            models.swap(file->models);
+        }
+        for (std::pair<int, std::vector<std::shared_ptr<Model>>> &node_models : models) {
+            for (std::shared_ptr<Model> &model : node_models.second) {
+                scene.graph.add_model(file->node_offset + node_models.first, model);
+                scene.models.push_back(model);
+                added++;
+            }
+        }
+        // Swap decoded images in for the placeholders
+        auto decoded = std::remove_if(file->images.begin(), file->images.end(), [this](PendingImage &pending) {
+            if (pending.image.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                return false;
+            }
+            std::shared_ptr<const Image> image = pool.wait_or_exit(pending.image);
+            for (const std::shared_ptr<Texture> &texture : pending.textures) {
+                texture->set_image(image, 0);
+            }
+            return true;
+        });
+        file->images.erase(decoded, file->images.end());
+    }
+    return added;
+}
+
+void SceneLoader::flush() {
+    for (const std::shared_ptr<FileLoad> &file : files) {
+        if (file->task.valid()) {
+            pool.wait_or_exit(file->task);
+        }
+    }
+    update();
+    for (const std::shared_ptr<FileLoad> &file : files) {
+        for (PendingImage &pending : file->images) {
+            std::shared_ptr<const Image> image = pool.wait_or_exit(pending.image);
+            for (const std::shared_ptr<Texture> &texture : pending.textures) {
+                texture->set_image(image, 0);
+            }
+        }
+        file->images.clear();
+    }
+}
+
+std::vector<std::string> SceneLoader::sources() const {
+    std::vector<std::string> paths;
+    for (const std::shared_ptr<FileLoad> &file : files) {
+        std::lock_guard<std::mutex> lock(file->mutex);
+        paths.insert(paths.end(), file->sources.begin(), file->sources.end());
+    }
+    return paths;
+}
+
+bool SceneLoader::done() const {
+    for (const std::shared_ptr<FileLoad> &file : files) {
+        if (file->task.valid() && file->task.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(file->mutex);
+        if (file->node_offset == -1 || !file->models.empty() || !file->images.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
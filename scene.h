@@ -9,6 +9,8 @@
 
 #include "window.h"
 #include "model.h"
+#include "scene_graph.h"
+#include "thread_pool.h"
 
 struct Camera {
     Camera() : yaw(M_PI_2), pitch(0) {}
@@ -28,10 +30,16 @@ class Scene {
     Scene(std::vector<std::shared_ptr<Model>> _models) : models(_models),
                                                          projection_matrix(identity()),
                                                          view_matrix(identity()){};
+    // Draw list, every model also belongs to a node of graph which sets its
+    // transform
     std::vector<std::shared_ptr<Model>> models;
+    SceneGraph graph;
     float4x4 projection_matrix;
     float4x4 view_matrix;
+    // Updates the view matrix and the world transforms of changed nodes
     void update(const Camera &c);
+    // Add the models and nodes of other, its roots become roots of this scene
+    void add(const Scene &other);
     void Render(FrameBuffer &fb);
 
     // Constructors
@@ -41,4 +49,46 @@ class Scene {
     static Scene CreateCubeScene();
 };
 
-Scene create_scene_from_gltf(const std::string&& base_path, const std::string&& gltf_file_name);
\ No newline at end of file
+// The scene has a single root node for the file, under which are the root
+// nodes of the glTF scenes
+Scene create_scene_from_gltf(const std::string&& base_path, const std::string&& gltf_file_name,
+                             const LoadOptions &options = LoadOptions());
+
+// Loads glTF files into a scene in the background. A file's root node is
+// added right away so the file can be placed before anything is loaded. Its
+// nodes follow once the file is parsed, then its models one mesh node at a
+// time, so the first geometry is drawn long before the whole file is
+// loaded. Textures show TextureStreamer::placeholder() until their image is
+// decoded, or are streamed if options.texture_streamer is set.
+//
+// update() must be called between frames on the render thread; it is the
+// only place the scene changes. Images that fail to load are reported by
+// update() or flush(), which exit, never by the tasks on the pool.
+class SceneLoader {
+    public:
+    explicit SceneLoader(Scene &_scene, ThreadPool &_pool = ThreadPool::shared()) : scene(_scene), pool(_pool) {}
+    SceneLoader(const SceneLoader &) = delete;
+    SceneLoader &operator=(const SceneLoader &) = delete;
+
+    // Start loading a file, returns its root node
+    int load(const std::string &base_path, const std::string &gltf_file_name,
+             const LoadOptions &options = LoadOptions());
+    // Add the nodes, models and images loaded since the last call to the
+    // scene, returns the number of models added
+    size_t update();
+    // Block until every file is loaded and added to the scene
+    void flush();
+    // True once every file is loaded and added to the scene, streamed
+    // textures may still be loading finer levels
+    bool done() const;
+    // Paths of the loaded glTF files and of the buffers and images they
+    // reference, e.g. to stamp a baked scene with. Complete once done().
+    std::vector<std::string> sources() const;
+
+    private:
+    struct FileLoad;
+
+    Scene &scene;
+    ThreadPool &pool;
+    std::vector<std::shared_ptr<FileLoad>> files;
+};
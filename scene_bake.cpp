@@ -0,0 +1,724 @@
+#include "scene_bake.h"
+#include "mapped_file.h"
+#include "texture_cache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <thread>
+
+static const char MAGIC[8] = {'B', 'S', 'N', 'S', 'C', 'E', 'N', 0};
+static const uint32_t VERSION = 2;
+// Data chunks are aligned so texture tiles start on cache lines in the
+// mapping
+static const uint64_t ALIGNMENT = 64;
+
+// Bytes of the data section, offset is relative to BakedHeader::data_offset
+struct BakedRange {
+    uint64_t offset;
+    uint64_t size;
+};
+
+// The header is followed by one table per object type, in the order of the
+// counts, then by the data section
+struct BakedHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_sources;
+    uint32_t num_images;
+    uint32_t num_levels;
+    uint32_t num_textures;
+    uint32_t num_materials;
+    uint32_t num_meshes;
+    uint32_t num_nodes;
+    uint32_t num_models;
+    uint32_t reserved;
+    uint64_t data_offset;
+    uint64_t data_size;
+};
+
+struct BakedSource {
+    BakedRange path;
+    uint64_t size;
+    int64_t mtime;
+};
+
+// Levels first_level to first_level + num_levels - 1 of the level table
+struct BakedImage {
+    uint32_t first_level;
+    uint32_t num_levels;
+    uint32_t srgb;
+    uint32_t reserved;
+};
+
+struct BakedLevel {
+    uint32_t width;
+    uint32_t height;
+    // TexelFormat
+    uint32_t format;
+    uint32_t reserved;
+    BakedRange data;
+};
+
+struct BakedTexture {
+    uint32_t image;
+    int32_t base_level;
+    uint32_t width;
+    uint32_t height;
+    int32_t mag_filter;
+    int32_t min_filter;
+    int32_t wrap_s;
+    int32_t wrap_t;
+};
+
+// Texture ids are -1 for none
+struct BakedMaterial {
+    float base_color_factor[4];
+    float metallic_factor;
+    float roughness_factor;
+    float emissive_factor[3];
+    float uv_offset[2];
+    float uv_rotation;
+    float uv_scale[2];
+    int32_t base_color_texture;
+    int32_t metallic_roughness_texture;
+    int32_t normal_texture;
+    int32_t occlusion_texture;
+    int32_t emissive_texture;
+};
+
+struct BakedAttribute {
+    int32_t component_type;
+    uint32_t normalized;
+    int32_t num_components;
+    uint32_t reserved;
+    BakedRange data;
+};
+
+// Arrays in the layout of the Mesh members they are read into
+struct BakedMesh {
+    int32_t num_triangles;
+    uint32_t reserved;
+    BakedRange indices;
+    BakedRange indices32;
+    BakedRange vertices;
+    BakedRange normals;
+    BakedRange colors;
+    BakedRange texcoords;
+    BakedAttribute quantized_vertices;
+    BakedAttribute quantized_normals;
+    BakedAttribute quantized_texcoords;
+    BakedRange meshlets;
+    BakedRange meshlet_vertices;
+    BakedRange meshlet_triangles;
+};
+
+// Nodes are stored parents first, matrices row-major
+struct BakedNode {
+    int32_t parent;
+    uint32_t has_matrix;
+    float matrix[16];
+    float translation[3];
+    float rotation[4];
+    float scale[3];
+    BakedRange name;
+};
+
+// node is -1 for models outside the graph, which keep transform
+struct BakedModel {
+    int32_t mesh;
+    int32_t material;
+    int32_t node;
+    uint32_t reserved;
+    float transform[16];
+    BakedRange instances;
+};
+
+static uint64_t align(uint64_t offset) {
+    return (offset + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+static void store_matrix(const float4x4 &m, float out[16]) {
+    const float4 *rows[4] = {&m.row0, &m.row1, &m.row2, &m.row3};
+    for (int r = 0; r < 4; r++) {
+        out[r*4 + 0] = rows[r]->x;
+        out[r*4 + 1] = rows[r]->y;
+        out[r*4 + 2] = rows[r]->z;
+        out[r*4 + 3] = rows[r]->w;
+    }
+}
+
+static float4x4 load_matrix(const float m[16]) {
+    return float4x4(float4(m[0], m[1], m[2], m[3]), float4(m[4], m[5], m[6], m[7]),
+                    float4(m[8], m[9], m[10], m[11]), float4(m[12], m[13], m[14], m[15]));
+}
+
+// Memory to write to the data section. Chunks point into the scene being
+// baked, which outlives the writer.
+struct DataChunks {
+    std::vector<std::pair<const void *, BakedRange>> chunks;
+    uint64_t size = 0;
+
+    BakedRange add(const void *data, uint64_t bytes) {
+        BakedRange range = {0, 0};
+        if (bytes == 0) {
+            return range;
+        }
+        range.offset = align(size);
+        range.size = bytes;
+        chunks.emplace_back(data, range);
+        size = range.offset + bytes;
+        return range;
+    }
+    template <typename T>
+    BakedRange add(const std::vector<T> &values) {
+        return add(values.data(), values.size()*sizeof(T));
+    }
+    BakedRange add(const std::string &text) {
+        return add(text.data(), text.size());
+    }
+};
+
+template <typename T>
+static void write_table(std::ofstream &out, const std::vector<T> &table) {
+    out.write(reinterpret_cast<const char *>(table.data()), table.size()*sizeof(T));
+}
+
+static void write_padding(std::ofstream &out, uint64_t offset) {
+    std::vector<char> padding(offset - out.tellp(), 0);
+    out.write(padding.data(), padding.size());
+}
+
+static BakedAttribute bake_attribute(const VertexAttribute &attribute, DataChunks &data) {
+    BakedAttribute file_attribute;
+    memset(&file_attribute, 0, sizeof(file_attribute));
+    file_attribute.component_type = attribute.component_type;
+    file_attribute.normalized = attribute.normalized;
+    file_attribute.num_components = attribute.num_components;
+    file_attribute.data = data.add(attribute.data);
+    return file_attribute;
+}
+
+bool BakeScene(const Scene &scene, const std::string &path, const std::vector<std::string> &sources) {
+    DataChunks data;
+    std::vector<BakedSource> file_sources;
+    for (const std::string &source : sources) {
+        TextureDiskCache::SourceStamp stamp = TextureDiskCache::stamp_file(source);
+        BakedSource file_source;
+        memset(&file_source, 0, sizeof(file_source));
+        file_source.path = data.add(source);
+        file_source.size = stamp.size;
+        file_source.mtime = stamp.mtime;
+        file_sources.push_back(file_source);
+    }
+
+    // Images, textures, materials and meshes are shared between models,
+    // each is written once
+    std::vector<BakedImage> file_images;
+    std::vector<BakedLevel> file_levels;
+    std::map<const Image *, int32_t> image_ids;
+    auto add_image = [&](const Image &image) {
+        auto found = image_ids.find(&image);
+        if (found != image_ids.end()) {
+            return found->second;
+        }
+        BakedImage file_image;
+        memset(&file_image, 0, sizeof(file_image));
+        file_image.first_level = file_levels.size();
+        file_image.num_levels = image.levels.size();
+        file_image.srgb = image.srgb;
+        for (const MipLevel &level : image.levels) {
+            BakedLevel file_level;
+            memset(&file_level, 0, sizeof(file_level));
+            file_level.width = level.width;
+            file_level.height = level.height;
+            file_level.format = uint32_t(level.format);
+            file_level.data = data.add(level.data(), level.memory_size());
+            file_levels.push_back(file_level);
+        }
+        int32_t id = file_images.size();
+        file_images.push_back(file_image);
+        image_ids[&image] = id;
+        return id;
+    };
+
+    std::vector<BakedTexture> file_textures;
+    std::map<const Texture *, int32_t> texture_ids;
+    bool resident = true;
+    auto add_texture = [&](const std::shared_ptr<Texture> &texture) {
+        if (texture == nullptr) {
+            return -1;
+        }
+        auto found = texture_ids.find(texture.get());
+        if (found != texture_ids.end()) {
+            return found->second;
+        }
+        resident = resident && texture->base_level == 0;
+        BakedTexture file_texture;
+        memset(&file_texture, 0, sizeof(file_texture));
+        file_texture.image = add_image(*texture->image);
+        file_texture.base_level = texture->base_level;
+        file_texture.width = texture->width;
+        file_texture.height = texture->height;
+        file_texture.mag_filter = texture->sampler->mag_filter;
+        file_texture.min_filter = texture->sampler->min_filter;
+        file_texture.wrap_s = texture->sampler->wrap_s;
+        file_texture.wrap_t = texture->sampler->wrap_t;
+        int32_t id = file_textures.size();
+        file_textures.push_back(file_texture);
+        texture_ids[texture.get()] = id;
+        return id;
+    };
+
+    std::vector<BakedMaterial> file_materials;
+    std::map<const Material *, int32_t> material_ids;
+    auto add_material = [&](const std::shared_ptr<Material> &material) {
+        if (material == nullptr) {
+            return -1;
+        }
+        auto found = material_ids.find(material.get());
+        if (found != material_ids.end()) {
+            return found->second;
+        }
+        BakedMaterial file_material;
+        memset(&file_material, 0, sizeof(file_material));
+        const float4 &base_color = material->base_color_factor;
+        float base_color_factor[4] = {base_color.x, base_color.y, base_color.z, base_color.w};
+        memcpy(file_material.base_color_factor, base_color_factor, sizeof(base_color_factor));
+        file_material.metallic_factor = material->metallic_factor;
+        file_material.roughness_factor = material->roughness_factor;
+        file_material.emissive_factor[0] = material->emissive_factor.x;
+        file_material.emissive_factor[1] = material->emissive_factor.y;
+        file_material.emissive_factor[2] = material->emissive_factor.z;
+        const TextureTransform &uv_transform = material->base_color_transform;
+        file_material.uv_offset[0] = uv_transform.offset.x;
+        file_material.uv_offset[1] = uv_transform.offset.y;
+        file_material.uv_rotation = uv_transform.rotation;
+        file_material.uv_scale[0] = uv_transform.scale.x;
+        file_material.uv_scale[1] = uv_transform.scale.y;
+        file_material.base_color_texture = add_texture(material->base_color_texture);
+        file_material.metallic_roughness_texture = add_texture(material->metallic_roughness_factor);
+        file_material.normal_texture = add_texture(material->normal_texture);
+        file_material.occlusion_texture = add_texture(material->occlusion_texture);
+        file_material.emissive_texture = add_texture(material->emissive_texture);
+        int32_t id = file_materials.size();
+        file_materials.push_back(file_material);
+        material_ids[material.get()] = id;
+        return id;
+    };
+
+    std::vector<BakedMesh> file_meshes;
+    std::map<const Mesh *, int32_t> mesh_ids;
+    auto add_mesh = [&](const Mesh &mesh) {
+        auto found = mesh_ids.find(&mesh);
+        if (found != mesh_ids.end()) {
+            return found->second;
+        }
+        BakedMesh file_mesh;
+        memset(&file_mesh, 0, sizeof(file_mesh));
+        file_mesh.num_triangles = mesh.num_triangles;
+        file_mesh.indices = data.add(mesh.indices);
+        file_mesh.indices32 = data.add(mesh.indices32);
+        file_mesh.vertices = data.add(mesh.vertices);
+        file_mesh.normals = data.add(mesh.normals);
+        file_mesh.colors = data.add(mesh.colors);
+        file_mesh.texcoords = data.add(mesh.texcoords);
+        file_mesh.quantized_vertices = bake_attribute(mesh.quantized_vertices, data);
+        file_mesh.quantized_normals = bake_attribute(mesh.quantized_normals, data);
+        file_mesh.quantized_texcoords = bake_attribute(mesh.quantized_texcoords, data);
+        file_mesh.meshlets = data.add(mesh.meshlets);
+        file_mesh.meshlet_vertices = data.add(mesh.meshlet_vertices);
+        file_mesh.meshlet_triangles = data.add(mesh.meshlet_triangles);
+        int32_t id = file_meshes.size();
+        file_meshes.push_back(file_mesh);
+        mesh_ids[&mesh] = id;
+        return id;
+    };
+
+    std::vector<BakedNode> file_nodes;
+    std::map<const Model *, int32_t> model_nodes;
+    for (size_t node_id = 0; node_id < scene.graph.size(); node_id++) {
+        const SceneNode &node = scene.graph.node(node_id);
+        BakedNode file_node;
+        memset(&file_node, 0, sizeof(file_node));
+        file_node.parent = node.parent;
+        file_node.has_matrix = node.has_matrix;
+        store_matrix(node.matrix, file_node.matrix);
+        float translation[3] = {node.translation.x, node.translation.y, node.translation.z};
+        float rotation[4] = {node.rotation.x, node.rotation.y, node.rotation.z, node.rotation.w};
+        float scale[3] = {node.scale.x, node.scale.y, node.scale.z};
+        memcpy(file_node.translation, translation, sizeof(translation));
+        memcpy(file_node.rotation, rotation, sizeof(rotation));
+        memcpy(file_node.scale, scale, sizeof(scale));
+        file_node.name = data.add(node.name);
+        file_nodes.push_back(file_node);
+        for (const std::shared_ptr<Model> &model : node.models) {
+            model_nodes[model.get()] = node_id;
+        }
+    }
+
+    std::vector<BakedModel> file_models;
+    for (const std::shared_ptr<Model> &model : scene.models) {
+        BakedModel file_model;
+        memset(&file_model, 0, sizeof(file_model));
+        file_model.mesh = add_mesh(*model->mesh);
+        file_model.material = add_material(model->material);
+        auto node = model_nodes.find(model.get());
+        file_model.node = (node != model_nodes.end()) ? node->second : -1;
+        store_matrix(model->transform, file_model.transform);
+        file_model.instances = data.add(model->instances);
+        file_models.push_back(file_model);
+    }
+    if (!resident) {
+        std::cerr << "Unable to bake " << path << ", some textures are streamed and not fully resident\n";
+        return false;
+    }
+
+    BakedHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.num_sources = file_sources.size();
+    header.num_images = file_images.size();
+    header.num_levels = file_levels.size();
+    header.num_textures = file_textures.size();
+    header.num_materials = file_materials.size();
+    header.num_meshes = file_meshes.size();
+    header.num_nodes = file_nodes.size();
+    header.num_models = file_models.size();
+    header.data_offset = align(sizeof(BakedHeader) + file_sources.size()*sizeof(BakedSource) +
+                               file_images.size()*sizeof(BakedImage) + file_levels.size()*sizeof(BakedLevel) +
+                               file_textures.size()*sizeof(BakedTexture) +
+                               file_materials.size()*sizeof(BakedMaterial) + file_meshes.size()*sizeof(BakedMesh) +
+                               file_nodes.size()*sizeof(BakedNode) + file_models.size()*sizeof(BakedModel));
+    header.data_size = data.size;
+
+    // Write to a temporary file and rename, like the texture cache, so a
+    // reader never maps a partially written scene
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%zx.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+    std::string tmp_path = path + suffix;
+    std::error_code error;
+    {
+        std::ofstream out(tmp_path, std::ios::binary);
+        if (!out.is_open()) {
+            std::cerr << "Unable to write baked scene " << tmp_path << "\n";
+            return false;
+        }
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        write_table(out, file_sources);
+        write_table(out, file_images);
+        write_table(out, file_levels);
+        write_table(out, file_textures);
+        write_table(out, file_materials);
+        write_table(out, file_meshes);
+        write_table(out, file_nodes);
+        write_table(out, file_models);
+        for (const std::pair<const void *, BakedRange> &chunk : data.chunks) {
+            write_padding(out, header.data_offset + chunk.second.offset);
+            out.write(static_cast<const char *>(chunk.first), chunk.second.size);
+        }
+        if (!out.good()) {
+            std::cerr << "Unable to write baked scene " << tmp_path << "\n";
+            out.close();
+            std::filesystem::remove(tmp_path, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(tmp_path, path, error);
+    if (error) {
+        std::cerr << "Unable to write baked scene " << path << "\n";
+        std::filesystem::remove(tmp_path, error);
+        return false;
+    }
+    return true;
+}
+
+// Bounds checked reads from a mapped baked scene
+class BakedSceneFile {
+    public:
+    BakedSceneFile(std::shared_ptr<MappedFile> _file, const BakedHeader &_header) :
+        file(_file), header(_header), table_offset(sizeof(BakedHeader)) {}
+
+    // Next table, count elements of T. Tables are read in file order.
+    template <typename T>
+    std::vector<T> table(uint32_t count) {
+        std::vector<T> elements(count);
+        memcpy(elements.data(), file->data() + table_offset, count*sizeof(T));
+        table_offset += count*sizeof(T);
+        return elements;
+    }
+    bool valid(const BakedRange &range) const {
+        return range.offset <= header.data_size && range.size <= header.data_size - range.offset;
+    }
+    const unsigned char *at(const BakedRange &range) const {
+        return file->data() + header.data_offset + range.offset;
+    }
+    template <typename T>
+    bool read(const BakedRange &range, std::vector<T> &values) const {
+        if (!valid(range) || range.size % sizeof(T) != 0) {
+            return false;
+        }
+        values.resize(range.size/sizeof(T));
+        memcpy(values.data(), at(range), range.size);
+        return true;
+    }
+    bool read(const BakedRange &range, std::string &text) const {
+        if (!valid(range)) {
+            return false;
+        }
+        text.assign(reinterpret_cast<const char *>(at(range)), range.size);
+        return true;
+    }
+    bool read(const BakedAttribute &file_attribute, VertexAttribute &attribute) const {
+        attribute.component_type = file_attribute.component_type;
+        attribute.normalized = file_attribute.normalized != 0;
+        attribute.num_components = file_attribute.num_components;
+        int type = attribute.component_type;
+        bool known_type = type == GL_BYTE || type == GL_UNSIGNED_BYTE || type == GL_SHORT ||
+                          type == GL_UNSIGNED_SHORT || type == GL_UNSIGNED_INT || type == GL_FLOAT;
+        if (file_attribute.data.size != 0 && (!known_type || attribute.num_components <= 0)) {
+            return false;
+        }
+        return read(file_attribute.data, attribute.data);
+    }
+
+    std::shared_ptr<MappedFile> file;
+    BakedHeader header;
+
+    private:
+    uint64_t table_offset;
+};
+
+// Vertex arrays are empty or have one element per vertex
+static bool attribute_valid(size_t size, size_t vertex_count) {
+    return size == 0 || size == vertex_count;
+}
+
+static bool attribute_valid(const VertexAttribute &attribute, size_t vertex_count, int min_components) {
+    if (attribute.empty()) {
+        return true;
+    }
+    return attribute.num_components >= min_components && attribute.data.size() % attribute.element_size() == 0 &&
+           attribute.size() == vertex_count;
+}
+
+// Meshes are drawn without further checks, so the index and vertex arrays
+// have to agree with num_triangles and each other
+static bool mesh_valid(const Mesh &mesh) {
+    size_t vertex_count = mesh.vertex_count();
+    size_t index_count = size_t(mesh.num_triangles)*3;
+    if (mesh.num_triangles < 0 || (!mesh.indices.empty() && !mesh.indices32.empty()) ||
+        !attribute_valid(mesh.quantized_vertices, vertex_count, 3) ||
+        !attribute_valid(mesh.quantized_normals, vertex_count, 3) ||
+        !attribute_valid(mesh.quantized_texcoords, vertex_count, 2) ||
+        !attribute_valid(mesh.vertices.size(), vertex_count) || !attribute_valid(mesh.normals.size(), vertex_count) ||
+        !attribute_valid(mesh.texcoords.size(), vertex_count) || mesh.colors.size() != vertex_count) {
+        return false;
+    }
+    if (!mesh.indexed()) {
+        return vertex_count >= index_count;
+    }
+    if (mesh.indices.size() + mesh.indices32.size() != index_count) {
+        return false;
+    }
+    for (size_t i = 0; i < index_count; i++) {
+        if (mesh.index(i) >= vertex_count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Meshlets are drawn without further checks, so every range and index in
+// them has to be inside the mesh
+static bool meshlets_valid(const Mesh &mesh) {
+    for (const Meshlet &meshlet : mesh.meshlets) {
+        if (meshlet.vertex_offset > mesh.meshlet_vertices.size() ||
+            meshlet.vertex_count > mesh.meshlet_vertices.size() - meshlet.vertex_offset ||
+            meshlet.triangle_offset > mesh.meshlet_triangles.size() ||
+            meshlet.triangle_count > (mesh.meshlet_triangles.size() - meshlet.triangle_offset)/3) {
+            return false;
+        }
+        for (uint32_t i = 0; i < meshlet.triangle_count*3; i++) {
+            if (mesh.meshlet_triangles[meshlet.triangle_offset + i] >= meshlet.vertex_count) {
+                return false;
+            }
+        }
+    }
+    for (uint32_t vertex : mesh.meshlet_vertices) {
+        if (vertex >= mesh.vertex_count()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LoadBakedScene(const std::string &path, Scene &scene) {
+    std::shared_ptr<MappedFile> file = MappedFile::open(path);
+    if (file == nullptr || file->size() < sizeof(BakedHeader)) {
+        return false;
+    }
+    BakedHeader header;
+    memcpy(&header, file->data(), sizeof(header));
+    uint64_t tables_end = sizeof(BakedHeader) + uint64_t(header.num_sources)*sizeof(BakedSource) +
+                          uint64_t(header.num_images)*sizeof(BakedImage) +
+                          uint64_t(header.num_levels)*sizeof(BakedLevel) +
+                          uint64_t(header.num_textures)*sizeof(BakedTexture) +
+                          uint64_t(header.num_materials)*sizeof(BakedMaterial) +
+                          uint64_t(header.num_meshes)*sizeof(BakedMesh) +
+                          uint64_t(header.num_nodes)*sizeof(BakedNode) +
+                          uint64_t(header.num_models)*sizeof(BakedModel);
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        header.data_offset < tables_end || header.data_offset % ALIGNMENT != 0 ||
+        header.data_offset > file->size() || header.data_size > file->size() - header.data_offset) {
+        return false;
+    }
+    BakedSceneFile baked(file, header);
+
+    for (const BakedSource &source : baked.table<BakedSource>(header.num_sources)) {
+        std::string source_path;
+        if (!baked.read(source.path, source_path)) {
+            return false;
+        }
+        std::error_code error;
+        if (!std::filesystem::exists(source_path, error)) {
+            continue;
+        }
+        TextureDiskCache::SourceStamp stamp = TextureDiskCache::stamp_file(source_path);
+        if (stamp.size != source.size || stamp.mtime != source.mtime) {
+            return false;
+        }
+    }
+
+    // Levels are used in place, the mapping stays alive with them
+    std::vector<BakedImage> file_images = baked.table<BakedImage>(header.num_images);
+    std::vector<BakedLevel> file_levels = baked.table<BakedLevel>(header.num_levels);
+    std::vector<std::shared_ptr<const Image>> images;
+    for (const BakedImage &file_image : file_images) {
+        if (file_image.num_levels == 0 || file_image.first_level > file_levels.size() ||
+            file_image.num_levels > file_levels.size() - file_image.first_level) {
+            return false;
+        }
+        std::vector<MipLevel> levels;
+        for (uint32_t i = 0; i < file_image.num_levels; i++) {
+            const BakedLevel &file_level = file_levels[file_image.first_level + i];
+            if (file_level.format > uint32_t(TexelFormat::BC3) || file_level.data.offset % ALIGNMENT != 0) {
+                return false;
+            }
+            MipLevel level(file_level.width, file_level.height, TexelFormat(file_level.format),
+                           baked.at(file_level.data), file);
+            if (!baked.valid(file_level.data) || file_level.data.size != level.memory_size()) {
+                return false;
+            }
+            levels.push_back(std::move(level));
+        }
+        images.push_back(std::make_shared<Image>(std::move(levels), file_image.srgb != 0));
+    }
+
+    std::vector<std::shared_ptr<Texture>> textures;
+    for (const BakedTexture &file_texture : baked.table<BakedTexture>(header.num_textures)) {
+        if (file_texture.image >= images.size()) {
+            return false;
+        }
+        auto sampler = std::make_shared<Sampler>(file_texture.mag_filter, file_texture.min_filter,
+                                                 file_texture.wrap_s, file_texture.wrap_t);
+        textures.push_back(std::make_shared<Texture>(images[file_texture.image], sampler, file_texture.width,
+                                                     file_texture.height, file_texture.base_level));
+    }
+
+    std::vector<std::shared_ptr<Material>> materials;
+    bool textures_valid = true;
+    auto find_texture = [&](int32_t texture_id) -> std::shared_ptr<Texture> {
+        if (texture_id == -1) {
+            return nullptr;
+        }
+        if (texture_id < 0 || size_t(texture_id) >= textures.size()) {
+            textures_valid = false;
+            return nullptr;
+        }
+        return textures[texture_id];
+    };
+    for (const BakedMaterial &file_material : baked.table<BakedMaterial>(header.num_materials)) {
+        auto material = std::make_shared<Material>();
+        const float *base_color = file_material.base_color_factor;
+        material->base_color_factor = float4(base_color[0], base_color[1], base_color[2], base_color[3]);
+        material->metallic_factor = file_material.metallic_factor;
+        material->roughness_factor = file_material.roughness_factor;
+        const float *emissive = file_material.emissive_factor;
+        material->emissive_factor = float3(emissive[0], emissive[1], emissive[2]);
+        material->base_color_transform.offset = float2(file_material.uv_offset[0], file_material.uv_offset[1]);
+        material->base_color_transform.rotation = file_material.uv_rotation;
+        material->base_color_transform.scale = float2(file_material.uv_scale[0], file_material.uv_scale[1]);
+        material->base_color_texture = find_texture(file_material.base_color_texture);
+        material->metallic_roughness_factor = find_texture(file_material.metallic_roughness_texture);
+        material->normal_texture = find_texture(file_material.normal_texture);
+        material->occlusion_texture = find_texture(file_material.occlusion_texture);
+        material->emissive_texture = find_texture(file_material.emissive_texture);
+        materials.push_back(material);
+    }
+    if (!textures_valid) {
+        return false;
+    }
+
+    std::vector<std::shared_ptr<const Mesh>> meshes;
+    for (const BakedMesh &file_mesh : baked.table<BakedMesh>(header.num_meshes)) {
+        auto mesh = std::make_shared<Mesh>(file_mesh.num_triangles, std::vector<float3>(), std::vector<float3>());
+        if (!baked.read(file_mesh.indices, mesh->indices) || !baked.read(file_mesh.indices32, mesh->indices32) ||
+            !baked.read(file_mesh.vertices, mesh->vertices) || !baked.read(file_mesh.normals, mesh->normals) ||
+            !baked.read(file_mesh.colors, mesh->colors) || !baked.read(file_mesh.texcoords, mesh->texcoords) ||
+            !baked.read(file_mesh.quantized_vertices, mesh->quantized_vertices) ||
+            !baked.read(file_mesh.quantized_normals, mesh->quantized_normals) ||
+            !baked.read(file_mesh.quantized_texcoords, mesh->quantized_texcoords) ||
+            !baked.read(file_mesh.meshlets, mesh->meshlets) ||
+            !baked.read(file_mesh.meshlet_vertices, mesh->meshlet_vertices) ||
+            !baked.read(file_mesh.meshlet_triangles, mesh->meshlet_triangles) || !mesh_valid(*mesh) ||
+            !meshlets_valid(*mesh)) {
+            return false;
+        }
+        meshes.push_back(mesh);
+    }
+
+    Scene loaded;
+    std::vector<BakedNode> file_nodes = baked.table<BakedNode>(header.num_nodes);
+    for (size_t node_id = 0; node_id < file_nodes.size(); node_id++) {
+        const BakedNode &file_node = file_nodes[node_id];
+        std::string name;
+        if (file_node.parent < -1 || file_node.parent >= int32_t(node_id) || !baked.read(file_node.name, name)) {
+            return false;
+        }
+        loaded.graph.add_node(file_node.parent, name);
+        if (file_node.has_matrix) {
+            loaded.graph.set_matrix(node_id, load_matrix(file_node.matrix));
+        } else {
+            const float *t = file_node.translation;
+            const float *r = file_node.rotation;
+            const float *s = file_node.scale;
+            loaded.graph.set_translation(node_id, float3(t[0], t[1], t[2]));
+            loaded.graph.set_rotation(node_id, float4(r[0], r[1], r[2], r[3]));
+            loaded.graph.set_scale(node_id, float3(s[0], s[1], s[2]));
+        }
+    }
+    for (const BakedModel &file_model : baked.table<BakedModel>(header.num_models)) {
+        if (file_model.mesh < 0 || size_t(file_model.mesh) >= meshes.size() ||
+            file_model.material < -1 || file_model.material >= int32_t(materials.size()) ||
+            file_model.node < -1 || file_model.node >= int32_t(file_nodes.size())) {
+            return false;
+        }
+        auto model = std::make_shared<Model>(meshes[file_model.mesh], load_matrix(file_model.transform));
+        if (file_model.material != -1) {
+            model->material = materials[file_model.material];
+        }
+        if (!baked.read(file_model.instances, model->instances)) {
+            return false;
+        }
+        if (file_model.node != -1) {
+            loaded.graph.add_model(file_model.node, model);
+        }
+        loaded.models.push_back(model);
+    }
+    loaded.graph.update();
+    scene = std::move(loaded);
+    return true;
+}
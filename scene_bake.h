@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "scene.h"
+
+// Baked scenes: a fully loaded Scene (node graph, models, meshes, materials,
+// textures with their mip chains) written to one versioned binary file. A
+// baked scene is memory mapped on load, texture levels are used in place
+// from the mapping and mesh arrays are copied out with one memcpy each, so
+// loading skips JSON parsing, buffer reads and image decoding.
+//
+// The sources a scene was loaded from (e.g. its .gltf files) are recorded
+// with their size and modification time. A baked scene whose recorded
+// sources changed is stale and not loaded, sources that don't exist (a
+// deployment shipping only the baked file) are not checked.
+
+// Write scene to path. Textures must be fully resident, i.e. not loaded
+// through a TextureStreamer. Returns false if the file can't be written.
+bool BakeScene(const Scene &scene, const std::string &path, const std::vector<std::string> &sources);
+
+// Replace scene with the baked scene at path. Returns false, leaving scene
+// untouched, if the file doesn't exist, is invalid, was written by another
+// version or is stale.
+bool LoadBakedScene(const std::string &path, Scene &scene);
@@ -0,0 +1,122 @@
+#include "scene_graph.h"
+
+#include <algorithm>
+
+float4x4 SceneNode::local_matrix() const {
+    if (has_matrix) {
+        return matrix;
+    }
+    return translationMatrix(translation.x, translation.y, translation.z)*rotationMatrix(rotation)*
+           scalingMatrix(scale.x, scale.y, scale.z);
+}
+
+int SceneGraph::add_node(int parent, const std::string &name) {
+    int node_id = nodes.size();
+    SceneNode node;
+    node.name = name;
+    node.parent = parent;
+    if (parent == -1) {
+        root_nodes.push_back(node_id);
+    } else {
+        nodes[parent].children.push_back(node_id);
+        node.depth = nodes[parent].depth + 1;
+    }
+    nodes.push_back(std::move(node));
+    dirty_nodes.push_back(node_id);
+    return node_id;
+}
+
+void SceneGraph::append(const SceneGraph &other, int parent) {
+    int offset = nodes.size();
+    int depth = (parent == -1) ? 0 : nodes[parent].depth + 1;
+    for (const SceneNode &other_node : other.nodes) {
+        SceneNode node = other_node;
+        node.parent = (node.parent == -1) ? parent : node.parent + offset;
+        node.depth += depth;
+        for (int &child : node.children) {
+            child += offset;
+        }
+        node.dirty = false;
+        nodes.push_back(std::move(node));
+    }
+    for (int root : other.root_nodes) {
+        if (parent == -1) {
+            root_nodes.push_back(root + offset);
+        } else {
+            // World matrices of other are relative to parent from now on
+            nodes[parent].children.push_back(root + offset);
+            mark_dirty(root + offset);
+        }
+    }
+    for (int node_id : other.dirty_nodes) {
+        mark_dirty(node_id + offset);
+    }
+}
+
+void SceneGraph::add_model(int node_id, std::shared_ptr<Model> model) {
+    model->transform = nodes[node_id].world;
+    nodes[node_id].models.push_back(std::move(model));
+}
+
+void SceneGraph::set_matrix(int node_id, const float4x4 &matrix) {
+    nodes[node_id].has_matrix = true;
+    nodes[node_id].matrix = matrix;
+    mark_dirty(node_id);
+}
+
+// Setting one of translation, rotation or scale switches the node to TRS
+void SceneGraph::set_translation(int node_id, const float3 &translation) {
+    nodes[node_id].has_matrix = false;
+    nodes[node_id].translation = translation;
+    mark_dirty(node_id);
+}
+
+void SceneGraph::set_rotation(int node_id, const float4 &rotation) {
+    nodes[node_id].has_matrix = false;
+    nodes[node_id].rotation = rotation;
+    mark_dirty(node_id);
+}
+
+void SceneGraph::set_scale(int node_id, const float3 &scale) {
+    nodes[node_id].has_matrix = false;
+    nodes[node_id].scale = scale;
+    mark_dirty(node_id);
+}
+
+void SceneGraph::mark_dirty(int node_id) {
+    if (!nodes[node_id].dirty) {
+        nodes[node_id].dirty = true;
+        dirty_nodes.push_back(node_id);
+    }
+}
+
+size_t SceneGraph::update() {
+    if (dirty_nodes.empty()) {
+        return 0;
+    }
+    // Shallowest first: a dirty node below another is recomputed with its
+    // ancestor's subtree and skipped afterwards
+    std::stable_sort(dirty_nodes.begin(), dirty_nodes.end(),
+                     [this](int a, int b) { return nodes[a].depth < nodes[b].depth; });
+    size_t updated = 0;
+    std::vector<int> stack;
+    for (int dirty_id : dirty_nodes) {
+        if (!nodes[dirty_id].dirty) {
+            continue;
+        }
+        stack.push_back(dirty_id);
+        while (!stack.empty()) {
+            SceneNode &node = nodes[stack.back()];
+            stack.pop_back();
+            node.world = (node.parent == -1) ? node.local_matrix() : nodes[node.parent].world*node.local_matrix();
+            node.dirty = false;
+            for (std::shared_ptr<Model> &model : node.models) {
+                model->transform = node.world;
+            }
+            stack.insert(stack.end(), node.children.begin(), node.children.end());
+            updated++;
+        }
+    }
+    dirty_nodes.clear();
+    return updated;
+}
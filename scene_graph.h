@@ -0,0 +1,68 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "data_types.h"
+#include "model.h"
+
+// Node of a SceneGraph. The local transform is either matrix or
+// translation * rotation * scale, rotation being a unit quaternion
+// (x, y, z, w) as in glTF.
+struct SceneNode {
+    std::string name;
+    int parent = -1;
+    std::vector<int> children;
+    // 0 for roots, parents are always updated before their children
+    int depth = 0;
+    bool has_matrix = false;
+    float4x4 matrix = identity();
+    float3 translation = float3(0, 0, 0);
+    float4 rotation = float4(0, 0, 0, 1);
+    float3 scale = float3(1, 1, 1);
+    // Parent's world matrix times the local one, valid after update()
+    float4x4 world = identity();
+    // Drawn with world as their transform
+    std::vector<std::shared_ptr<Model>> models;
+    // Queued for update()
+    bool dirty = true;
+
+    float4x4 local_matrix() const;
+};
+
+// Node hierarchy of a scene. Changing the local transform of a node marks it
+// dirty, update() then recomputes the world matrices of the dirty subtrees
+// only and copies them to the transforms of their models, so a frame where
+// a few nodes move costs the size of their subtrees rather than the whole
+// graph.
+class SceneGraph {
+    public:
+    // Add a node under parent, -1 for a root, and return its id
+    int add_node(int parent = -1, const std::string &name = "");
+    // Append the nodes of other, its roots become children of parent or,
+    // for -1, roots of this graph
+    void append(const SceneGraph &other, int parent = -1);
+
+    size_t size() const { return nodes.size(); }
+    const SceneNode &node(int node_id) const { return nodes[node_id]; }
+    const std::vector<int> &roots() const { return root_nodes; }
+
+    void add_model(int node_id, std::shared_ptr<Model> model);
+    void set_matrix(int node_id, const float4x4 &matrix);
+    void set_translation(int node_id, const float3 &translation);
+    void set_rotation(int node_id, const float4 &rotation);
+    void set_scale(int node_id, const float3 &scale);
+
+    // Recompute the world matrices of the dirty nodes and their
+    // descendants, returns the number of nodes recomputed
+    size_t update();
+
+    private:
+    void mark_dirty(int node_id);
+
+    std::vector<SceneNode> nodes;
+    std::vector<int> root_nodes;
+    // Nodes marked dirty since the last update, possibly below one another
+    std::vector<int> dirty_nodes;
+};
@@ -0,0 +1,89 @@
+#include "swapchain.h"
+
+SwapChain::SwapChain(int _width, int _height, int num_buffers, PresentMode _mode,
+                     std::function<void(const FrameBuffer &)> _present_fn) :
+    width(_width), height(_height), mode(_mode), present_fn(_present_fn) {
+    if (num_buffers < 2) {
+        std::cerr << "SwapChain needs at least 2 buffers, got " << num_buffers << "\n";
+        exit(-1);
+    }
+    for (int i = 0; i < num_buffers; i++) {
+        buffers.push_back(FrameBuffer(width, height));
+        free_buffers.push_back(i);
+    }
+    present_thread = std::thread(&SwapChain::present_loop, this);
+}
+
+SwapChain::~SwapChain() {
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    cv.notify_all();
+    present_thread.join();
+}
+
+FrameBuffer &SwapChain::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (acquired != -1) {
+        return buffers[acquired];
+    }
+    if (mode == PresentMode::MAILBOX && free_buffers.empty() && !queued_buffers.empty()) {
+        // Steal the oldest frame that has not started presenting yet
+        acquired = queued_buffers.front();
+        queued_buffers.pop_front();
+        dropped_frames++;
+        return buffers[acquired];
+    }
+    cv.wait(lock, [this] { return !free_buffers.empty(); });
+    acquired = free_buffers.front();
+    free_buffers.pop_front();
+    return buffers[acquired];
+}
+
+void SwapChain::submit() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (acquired == -1) {
+            return;
+        }
+        if (mode == PresentMode::MAILBOX) {
+            // Newer frame replaces anything still waiting in the mailbox
+            while (!queued_buffers.empty()) {
+                free_buffers.push_back(queued_buffers.front());
+                queued_buffers.pop_front();
+                dropped_frames++;
+            }
+        }
+        queued_buffers.push_back(acquired);
+        acquired = -1;
+    }
+    cv.notify_all();
+}
+
+void SwapChain::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this] { return queued_buffers.empty() && presenting == -1; });
+}
+
+void SwapChain::present_loop() {
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return stop || !queued_buffers.empty(); });
+        if (queued_buffers.empty()) {
+            return;
+        }
+        presenting = queued_buffers.front();
+        queued_buffers.pop_front();
+        lock.unlock();
+
+        present_fn(buffers[presenting]);
+
+        lock.lock();
+        free_buffers.push_back(presenting);
+        presenting = -1;
+        lock.unlock();
+        cv.notify_all();
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "framebuffer.h"
+
+enum class PresentMode {
+    // Every submitted frame is presented in order. acquire() blocks while
+    // all buffers are waiting to be presented.
+    FIFO,
+    // Only the newest submitted frame is presented. Frames that are still
+    // queued when a newer one is submitted are dropped and reused.
+    MAILBOX
+};
+
+// SwapChain owns N framebuffers. The render thread acquires a free buffer,
+// renders into it and submits it; a dedicated present thread hands submitted
+// buffers to present_fn (copy to window surface, encode to file etc.) so the
+// next frame can be rendered while the previous one is being presented.
+class SwapChain {
+    public:
+    SwapChain(int width, int height, int num_buffers, PresentMode mode,
+              std::function<void(const FrameBuffer &)> present_fn);
+    ~SwapChain();
+    SwapChain(const SwapChain &) = delete;
+    SwapChain &operator=(const SwapChain &) = delete;
+
+    // Returns a buffer that is not queued or being presented
+    FrameBuffer &acquire();
+    // Queue the buffer returned by the last acquire() for presentation
+    void submit();
+    // Block until every submitted frame has been presented
+    void flush();
+
+    int width;
+    int height;
+    PresentMode mode;
+    // Number of frames dropped by MAILBOX before they were presented
+    int dropped_frames = 0;
+
+    private:
+    void present_loop();
+
+    std::vector<FrameBuffer> buffers;
+    std::function<void(const FrameBuffer &)> present_fn;
+    std::deque<int> free_buffers;
+    std::deque<int> queued_buffers;
+    int acquired = -1;
+    int presenting = -1;
+    bool stop = false;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread present_thread;
+};
@@ -0,0 +1,452 @@
+#include "texture.h"
+#include "block_compression.h"
+
+#include <algorithm>
+#include <atomic>
+
+// The AVX2 paths are compiled with a function-level target attribute and only
+// selected when the CPU reports AVX2 at runtime, so the rest of the binary
+// keeps the default instruction set
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define TEXTURE_AVX2 1
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+#include <immintrin.h>
+#endif
+
+// 8 bit to float conversion tables, indexed by the stored byte
+struct DecodeTables {
+    float unorm[256];
+    float srgb[256];
+    DecodeTables() {
+        for (int i = 0; i < 256; i++) {
+            float c = i/255.0f;
+            unorm[i] = c;
+            srgb[i] = (c <= 0.04045f) ? c/12.92f : std::pow((c + 0.055f)/1.055f, 2.4f);
+        }
+    }
+};
+
+static const DecodeTables decode_tables;
+
+static uint8_t encode_unorm8(float c) {
+    return uint8_t(std::clamp(c, 0.0f, 1.0f)*255.0f + 0.5f);
+}
+
+static uint8_t encode_srgb8(float c) {
+    c = std::clamp(c, 0.0f, 1.0f);
+    c = (c <= 0.0031308f) ? c*12.92f : 1.055f*std::pow(c, 1/2.4f) - 0.055f;
+    return uint8_t(c*255.0f + 0.5f);
+}
+
+std::vector<MipLevel> GenerateMipChain(MipLevel base, bool srgb) {
+    const float *rgb_table = srgb ? decode_tables.srgb : decode_tables.unorm;
+    std::vector<MipLevel> levels;
+    levels.push_back(std::move(base));
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        const MipLevel &prev = levels.back();
+        unsigned int width = std::max(1u, prev.width/2);
+        unsigned int height = std::max(1u, prev.height/2);
+        MipLevel level(width, height);
+        for (unsigned int y = 0; y < height; y++) {
+            // Clamp so 1 texel wide/high levels average the same texel twice
+            unsigned int y0 = std::min(2*y, prev.height - 1);
+            unsigned int y1 = std::min(2*y + 1, prev.height - 1);
+            for (unsigned int x = 0; x < width; x++) {
+                unsigned int x0 = std::min(2*x, prev.width - 1);
+                unsigned int x1 = std::min(2*x + 1, prev.width - 1);
+                const RGBA8 *quad[4] = {&prev.at(x0, y0), &prev.at(x1, y0),
+                                        &prev.at(x0, y1), &prev.at(x1, y1)};
+                float r = 0, g = 0, b = 0, a = 0;
+                for (const RGBA8 *t : quad) {
+                    r += rgb_table[t->r];
+                    g += rgb_table[t->g];
+                    b += rgb_table[t->b];
+                    a += decode_tables.unorm[t->a];
+                }
+                RGBA8 &texel = level.at(x, y);
+                texel.r = srgb ? encode_srgb8(0.25f*r) : encode_unorm8(0.25f*r);
+                texel.g = srgb ? encode_srgb8(0.25f*g) : encode_unorm8(0.25f*g);
+                texel.b = srgb ? encode_srgb8(0.25f*b) : encode_unorm8(0.25f*b);
+                texel.a = encode_unorm8(0.25f*a);
+            }
+        }
+        levels.push_back(std::move(level));
+    }
+    return levels;
+}
+
+size_t Image::memory_size() const {
+    size_t size = 0;
+    for (const MipLevel &level : levels) {
+        size += level.memory_size();
+    }
+    return size;
+}
+
+uint32_t MipLevel::next_storage_id() {
+    static std::atomic<uint32_t> next_id(1);
+    return next_id++;
+}
+
+// Small direct-mapped cache of decoded tiles of block-compressed levels, per
+// thread so lookups need no locking. Neighbouring samples mostly hit the tile
+// decoded for the previous one.
+struct DecodedTileCache {
+    static constexpr size_t NUM_ENTRIES = 256;
+    struct Entry {
+        // storage_id in the high, tile index in the low 32 bits
+        uint64_t key = ~0ull;
+        RGBA8 texels[16];
+    };
+    Entry entries[NUM_ENTRIES];
+};
+
+static const RGBA8 &CompressedTexel(const MipLevel &level, unsigned int x, unsigned int y) {
+    static thread_local DecodedTileCache cache;
+    size_t tile = (y/MipLevel::TILE_SIZE)*level.tiles_x + x/MipLevel::TILE_SIZE;
+    uint64_t key = (uint64_t(level.storage_id) << 32) | tile;
+    DecodedTileCache::Entry &entry = cache.entries[(tile ^ (level.storage_id*0x9e3779b1u)) % DecodedTileCache::NUM_ENTRIES];
+    if (entry.key != key) {
+        DecodeTile(level, tile, entry.texels);
+        entry.key = key;
+    }
+    return entry.texels[(y % MipLevel::TILE_SIZE)*MipLevel::TILE_SIZE + x % MipLevel::TILE_SIZE];
+}
+
+static float4 Texel(const Image &image, const MipLevel &level, int x, int y) {
+    const float *rgb_table = image.srgb ? decode_tables.srgb : decode_tables.unorm;
+    const RGBA8 &t = (level.format == TexelFormat::RGBA8) ? level.at(x, y) : CompressedTexel(level, x, y);
+    return float4(rgb_table[t.r], rgb_table[t.g], rgb_table[t.b], decode_tables.unorm[t.a]);
+}
+
+enum class Wrap { REPEAT, CLAMP_TO_EDGE, MIRRORED_REPEAT };
+
+// Maps an integer texel coordinate into [0, size). For power-of-two sizes
+// repeat and mirror reduce to bit masks.
+template <Wrap WRAP, bool POT>
+static inline int WrapTexel(int i, int size) {
+    if constexpr (WRAP == Wrap::CLAMP_TO_EDGE) {
+        return std::clamp(i, 0, size - 1);
+    } else if constexpr (WRAP == Wrap::REPEAT) {
+        if constexpr (POT) {
+            return i & (size - 1);
+        } else {
+            int m = i % size;
+            return (m < 0) ? m + size : m;
+        }
+    } else {
+        int m;
+        if constexpr (POT) {
+            m = i & (2*size - 1);
+        } else {
+            m = i % (2*size);
+            m = (m < 0) ? m + 2*size : m;
+        }
+        return (m < size) ? m : 2*size - 1 - m;
+    }
+}
+
+template <Wrap WRAP_S, Wrap WRAP_T, bool POT>
+static float4 Nearest(const Image &image, const MipLevel &level, const float2 &coord) {
+    int x = WrapTexel<WRAP_S, POT>(int(std::floor(coord.x * level.width)), level.width);
+    int y = WrapTexel<WRAP_T, POT>(int(std::floor(coord.y * level.height)), level.height);
+    return Texel(image, level, x, y);
+}
+
+template <Wrap WRAP_S, Wrap WRAP_T, bool POT>
+static float4 Bilinear(const Image &image, const MipLevel &level, const float2 &coord) {
+    // Texel centers are at half-integer coordinates
+    float u = coord.x * level.width - 0.5f;
+    float v = coord.y * level.height - 0.5f;
+    float fu = std::floor(u);
+    float fv = std::floor(v);
+    float a = u - fu;
+    float b = v - fv;
+    int x0 = WrapTexel<WRAP_S, POT>(int(fu), level.width);
+    int y0 = WrapTexel<WRAP_T, POT>(int(fv), level.height);
+    int x1 = WrapTexel<WRAP_S, POT>(int(fu) + 1, level.width);
+    int y1 = WrapTexel<WRAP_T, POT>(int(fv) + 1, level.height);
+    float4 c00 = Texel(image, level, x0, y0);
+    float4 c10 = Texel(image, level, x1, y0);
+    float4 c01 = Texel(image, level, x0, y1);
+    float4 c11 = Texel(image, level, x1, y1);
+    float4 top = (1 - a)*c00 + a*c10;
+    float4 bottom = (1 - a)*c01 + a*c11;
+    return (1 - b)*top + b*bottom;
+}
+
+template <Wrap WRAP_S, Wrap WRAP_T, bool POT, bool LINEAR>
+static inline float4 Filter(const Image &image, const MipLevel &level, const float2 &coord) {
+    if constexpr (LINEAR) {
+        return Bilinear<WRAP_S, WRAP_T, POT>(image, level, coord);
+    } else {
+        return Nearest<WRAP_S, WRAP_T, POT>(image, level, coord);
+    }
+}
+
+template <Wrap WRAP_S, Wrap WRAP_T, bool POT, int MAG_FILTER, int MIN_FILTER>
+static float4 SampleImpl(const Texture &texture, const float2 &coord, float lod) {
+    const Image &image = *texture.image;
+    const std::vector<MipLevel> &levels = image.levels;
+    if (lod <= 0) {
+        return Filter<WRAP_S, WRAP_T, POT, MAG_FILTER == GL_LINEAR>(image, levels[0], coord);
+    }
+    // Minified, levels[0] is level base_level of the chain
+    lod = std::max(lod - texture.base_level, 0.0f);
+    int max_level = int(levels.size()) - 1;
+    if constexpr (MIN_FILTER == GL_NEAREST || MIN_FILTER == GL_LINEAR) {
+        return Filter<WRAP_S, WRAP_T, POT, MIN_FILTER == GL_LINEAR>(image, levels[0], coord);
+    } else if constexpr (MIN_FILTER == GL_NEAREST_MIPMAP_NEAREST || MIN_FILTER == GL_LINEAR_MIPMAP_NEAREST) {
+        const MipLevel &level = levels[std::min(int(lod + 0.5f), max_level)];
+        return Filter<WRAP_S, WRAP_T, POT, MIN_FILTER == GL_LINEAR_MIPMAP_NEAREST>(image, level, coord);
+    } else {
+        constexpr bool linear = (MIN_FILTER == GL_LINEAR_MIPMAP_LINEAR);
+        int l0 = std::min(int(lod), max_level);
+        int l1 = std::min(l0 + 1, max_level);
+        float4 c0 = Filter<WRAP_S, WRAP_T, POT, linear>(image, levels[l0], coord);
+        if (l0 == l1) {
+            return c0;
+        }
+        float t = std::min(lod - l0, 1.0f);
+        float4 c1 = Filter<WRAP_S, WRAP_T, POT, linear>(image, levels[l1], coord);
+        return (1 - t)*c0 + t*c1;
+    }
+}
+
+// The selectors below turn the runtime sampler state into template
+// arguments one parameter at a time
+template <Wrap WRAP_S, Wrap WRAP_T, bool POT, int MAG_FILTER>
+static SampleFn SelectMinFilter(int min_filter) {
+    switch (min_filter) {
+        case GL_NEAREST: return &SampleImpl<WRAP_S, WRAP_T, POT, MAG_FILTER, GL_NEAREST>;
+        case GL_LINEAR: return &SampleImpl<WRAP_S, WRAP_T, POT, MAG_FILTER, GL_LINEAR>;
+        case GL_NEAREST_MIPMAP_NEAREST: return &SampleImpl<WRAP_S, WRAP_T, POT, MAG_FILTER, GL_NEAREST_MIPMAP_NEAREST>;
+        case GL_LINEAR_MIPMAP_NEAREST: return &SampleImpl<WRAP_S, WRAP_T, POT, MAG_FILTER, GL_LINEAR_MIPMAP_NEAREST>;
+        case GL_NEAREST_MIPMAP_LINEAR: return &SampleImpl<WRAP_S, WRAP_T, POT, MAG_FILTER, GL_NEAREST_MIPMAP_LINEAR>;
+        default: return &SampleImpl<WRAP_S, WRAP_T, POT, MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR>;
+    }
+}
+
+template <Wrap WRAP_S, Wrap WRAP_T, bool POT>
+static SampleFn SelectMagFilter(const Sampler &sampler) {
+    if (sampler.mag_filter == GL_NEAREST) {
+        return SelectMinFilter<WRAP_S, WRAP_T, POT, GL_NEAREST>(sampler.min_filter);
+    }
+    return SelectMinFilter<WRAP_S, WRAP_T, POT, GL_LINEAR>(sampler.min_filter);
+}
+
+template <Wrap WRAP_S, Wrap WRAP_T>
+static SampleFn SelectPowerOfTwo(const Sampler &sampler, bool power_of_two) {
+    if (power_of_two) {
+        return SelectMagFilter<WRAP_S, WRAP_T, true>(sampler);
+    }
+    return SelectMagFilter<WRAP_S, WRAP_T, false>(sampler);
+}
+
+template <Wrap WRAP_S>
+static SampleFn SelectWrapT(const Sampler &sampler, bool power_of_two) {
+    switch (sampler.wrap_t) {
+        case GL_CLAMP_TO_EDGE: return SelectPowerOfTwo<WRAP_S, Wrap::CLAMP_TO_EDGE>(sampler, power_of_two);
+        case GL_MIRRORED_REPEAT: return SelectPowerOfTwo<WRAP_S, Wrap::MIRRORED_REPEAT>(sampler, power_of_two);
+        default: return SelectPowerOfTwo<WRAP_S, Wrap::REPEAT>(sampler, power_of_two);
+    }
+}
+
+SampleFn SelectSampleFn(const Sampler &sampler, bool power_of_two) {
+    switch (sampler.wrap_s) {
+        case GL_CLAMP_TO_EDGE: return SelectWrapT<Wrap::CLAMP_TO_EDGE>(sampler, power_of_two);
+        case GL_MIRRORED_REPEAT: return SelectWrapT<Wrap::MIRRORED_REPEAT>(sampler, power_of_two);
+        default: return SelectWrapT<Wrap::REPEAT>(sampler, power_of_two);
+    }
+}
+
+static void SampleQuadScalar(const Texture &texture, const float2 coords[4], float lod, float4 out[4]) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = texture.sample_fn(texture, coords[i], lod);
+    }
+}
+
+#ifdef TEXTURE_AVX2
+// Four lanes of texel coordinates wrapped into [0, size). Only clamp and
+// power-of-two repeat are vectorized, other modes use the scalar path.
+template <Wrap WRAP>
+AVX2_TARGET static inline __m128i WrapTexel4(__m128i i, int size) {
+    if constexpr (WRAP == Wrap::CLAMP_TO_EDGE) {
+        return _mm_min_epi32(_mm_max_epi32(i, _mm_setzero_si128()), _mm_set1_epi32(size - 1));
+    } else {
+        static_assert(WRAP == Wrap::REPEAT);
+        return _mm_and_si128(i, _mm_set1_epi32(size - 1));
+    }
+}
+
+// Gathers the texels at (x, y) of four lanes and decodes them into one
+// register per channel
+AVX2_TARGET static inline void Texel4(const Image &image, const MipLevel &level, __m128i x, __m128i y, __m128 c[4]) {
+    // Same addressing as MipLevel::index
+    __m128i tile = _mm_add_epi32(_mm_mullo_epi32(_mm_srli_epi32(y, 2), _mm_set1_epi32(int(level.tiles_x))),
+                                 _mm_srli_epi32(x, 2));
+    __m128i three = _mm_set1_epi32(3);
+    __m128i index = _mm_or_si128(_mm_slli_epi32(tile, 4),
+                                 _mm_or_si128(_mm_slli_epi32(_mm_and_si128(y, three), 2), _mm_and_si128(x, three)));
+    __m128i texels = _mm_i32gather_epi32(reinterpret_cast<const int *>(level.texels.get()), index, 4);
+    __m128i mask = _mm_set1_epi32(0xff);
+    __m128i r = _mm_and_si128(texels, mask);
+    __m128i g = _mm_and_si128(_mm_srli_epi32(texels, 8), mask);
+    __m128i b = _mm_and_si128(_mm_srli_epi32(texels, 16), mask);
+    __m128 scale = _mm_set1_ps(1/255.0f);
+    if (image.srgb) {
+        c[0] = _mm_i32gather_ps(decode_tables.srgb, r, 4);
+        c[1] = _mm_i32gather_ps(decode_tables.srgb, g, 4);
+        c[2] = _mm_i32gather_ps(decode_tables.srgb, b, 4);
+    } else {
+        c[0] = _mm_mul_ps(_mm_cvtepi32_ps(r), scale);
+        c[1] = _mm_mul_ps(_mm_cvtepi32_ps(g), scale);
+        c[2] = _mm_mul_ps(_mm_cvtepi32_ps(b), scale);
+    }
+    c[3] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(texels, 24)), scale);
+}
+
+template <Wrap WRAP_S, Wrap WRAP_T, bool LINEAR>
+AVX2_TARGET static void Filter4(const Image &image, const MipLevel &level, __m128 u, __m128 v, __m128 c[4]) {
+    int w = int(level.width);
+    int h = int(level.height);
+    u = _mm_mul_ps(u, _mm_set1_ps(float(w)));
+    v = _mm_mul_ps(v, _mm_set1_ps(float(h)));
+    if constexpr (!LINEAR) {
+        __m128i x = WrapTexel4<WRAP_S>(_mm_cvttps_epi32(_mm_floor_ps(u)), w);
+        __m128i y = WrapTexel4<WRAP_T>(_mm_cvttps_epi32(_mm_floor_ps(v)), h);
+        Texel4(image, level, x, y, c);
+        return;
+    }
+    // Texel centers are at half-integer coordinates
+    __m128 half = _mm_set1_ps(0.5f);
+    u = _mm_sub_ps(u, half);
+    v = _mm_sub_ps(v, half);
+    __m128 fu = _mm_floor_ps(u);
+    __m128 fv = _mm_floor_ps(v);
+    __m128 a = _mm_sub_ps(u, fu);
+    __m128 b = _mm_sub_ps(v, fv);
+    __m128i iu = _mm_cvttps_epi32(fu);
+    __m128i iv = _mm_cvttps_epi32(fv);
+    __m128i one = _mm_set1_epi32(1);
+    __m128i x0 = WrapTexel4<WRAP_S>(iu, w);
+    __m128i y0 = WrapTexel4<WRAP_T>(iv, h);
+    __m128i x1 = WrapTexel4<WRAP_S>(_mm_add_epi32(iu, one), w);
+    __m128i y1 = WrapTexel4<WRAP_T>(_mm_add_epi32(iv, one), h);
+    __m128 c00[4], c10[4], c01[4], c11[4];
+    Texel4(image, level, x0, y0, c00);
+    Texel4(image, level, x1, y0, c10);
+    Texel4(image, level, x0, y1, c01);
+    Texel4(image, level, x1, y1, c11);
+    for (int i = 0; i < 4; i++) {
+        __m128 top = _mm_fmadd_ps(a, _mm_sub_ps(c10[i], c00[i]), c00[i]);
+        __m128 bottom = _mm_fmadd_ps(a, _mm_sub_ps(c11[i], c01[i]), c01[i]);
+        c[i] = _mm_fmadd_ps(b, _mm_sub_ps(bottom, top), top);
+    }
+}
+
+// Filter modes only change once per quad, so unlike SampleImpl they are
+// not template arguments here
+template <Wrap WRAP_S, Wrap WRAP_T>
+AVX2_TARGET static void SampleQuadAVX2(const Texture &texture, const float2 coords[4], float lod, float4 out[4]) {
+    const Image &image = *texture.image;
+    const std::vector<MipLevel> &levels = image.levels;
+    const Sampler &sampler = *texture.sampler;
+    __m128 u = _mm_setr_ps(coords[0].x, coords[1].x, coords[2].x, coords[3].x);
+    __m128 v = _mm_setr_ps(coords[0].y, coords[1].y, coords[2].y, coords[3].y);
+    __m128 c[4];
+    int max_level = int(levels.size()) - 1;
+    int filter = (lod <= 0) ? sampler.mag_filter : sampler.min_filter;
+    bool magnified = (lod <= 0);
+    lod = std::max(lod - texture.base_level, 0.0f);
+    bool linear = (filter == GL_LINEAR || filter == GL_LINEAR_MIPMAP_NEAREST || filter == GL_LINEAR_MIPMAP_LINEAR);
+    auto filter4 = [&](const MipLevel &level, __m128 result[4]) {
+        if (linear) {
+            Filter4<WRAP_S, WRAP_T, true>(image, level, u, v, result);
+        } else {
+            Filter4<WRAP_S, WRAP_T, false>(image, level, u, v, result);
+        }
+    };
+    if (magnified || filter == GL_NEAREST || filter == GL_LINEAR) {
+        filter4(levels[0], c);
+    } else if (filter == GL_NEAREST_MIPMAP_NEAREST || filter == GL_LINEAR_MIPMAP_NEAREST) {
+        filter4(levels[std::min(int(lod + 0.5f), max_level)], c);
+    } else {
+        int l0 = std::min(int(lod), max_level);
+        int l1 = std::min(l0 + 1, max_level);
+        filter4(levels[l0], c);
+        if (l0 != l1) {
+            __m128 c1[4];
+            filter4(levels[l1], c1);
+            __m128 t = _mm_set1_ps(std::min(lod - l0, 1.0f));
+            for (int i = 0; i < 4; i++) {
+                c[i] = _mm_fmadd_ps(t, _mm_sub_ps(c1[i], c[i]), c[i]);
+            }
+        }
+    }
+    // Channels to lanes
+    _MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+    for (int i = 0; i < 4; i++) {
+        float values[4];
+        _mm_storeu_ps(values, c[i]);
+        out[i] = float4(values[0], values[1], values[2], values[3]);
+    }
+}
+
+static bool CpuHasAVX2() {
+    static const bool has_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return has_avx2;
+}
+
+template <Wrap WRAP_S>
+static SampleQuadFn SelectQuadWrapT(int wrap_t) {
+    if (wrap_t == GL_CLAMP_TO_EDGE) {
+        return &SampleQuadAVX2<WRAP_S, Wrap::CLAMP_TO_EDGE>;
+    }
+    return &SampleQuadAVX2<WRAP_S, Wrap::REPEAT>;
+}
+#endif
+
+SampleQuadFn SelectSampleQuadFn(const Sampler &sampler, bool power_of_two, TexelFormat format) {
+#ifdef TEXTURE_AVX2
+    // Repeat needs power-of-two sizes to be a mask, mirrored repeat and
+    // compressed blocks are not vectorized
+    auto vectorized = [&](int wrap) {
+        return wrap == GL_CLAMP_TO_EDGE || (wrap != GL_MIRRORED_REPEAT && power_of_two);
+    };
+    if (CpuHasAVX2() && format == TexelFormat::RGBA8 && vectorized(sampler.wrap_s) && vectorized(sampler.wrap_t)) {
+        if (sampler.wrap_s == GL_CLAMP_TO_EDGE) {
+            return SelectQuadWrapT<Wrap::CLAMP_TO_EDGE>(sampler.wrap_t);
+        }
+        return SelectQuadWrapT<Wrap::REPEAT>(sampler.wrap_t);
+    }
+#endif
+    return &SampleQuadScalar;
+}
+
+void Texture::set_image(std::shared_ptr<const Image> _image, int _base_level) {
+    image = _image;
+    base_level = _base_level;
+    // Streamed images may change format once the real levels replace a placeholder
+    sample_quad_fn = SelectSampleQuadFn(*sampler, is_power_of_two(width) && is_power_of_two(height),
+                                        image->levels[0].format);
+}
+
+float Texture::ComputeLod(const float2 &ddx, const float2 &ddy) const {
+    // Derivatives in texels of level 0
+    float2 dx(ddx.x * width, ddx.y * height);
+    float2 dy(ddy.x * width, ddy.y * height);
+    float rho2 = std::max(dot(dx, dx), dot(dy, dy));
+    if (rho2 <= 0) {
+        return 0;
+    }
+    return 0.5f*std::log2(rho2);
+}
+
+float4 Texture::Sample(const float2 &coord) const {
+    return SampleLevel(coord, 0);
+}
+
+float4 Texture::Sample(const float2 &coord, const float2 &ddx, const float2 &ddy) const {
+    return SampleLevel(coord, ComputeLod(ddx, ddy));
+}
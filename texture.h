@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <memory>
+#include <vector>
+
+#include "data_types.h"
+#include "opengl_constants.h"
+
+// https://github.com/KhronosGroup/glTF/blob/master/specification/2.0/schema/sampler.schema.json
+struct Sampler {
+    Sampler(int _mag_filter, int _min_filter, int _wrap_s, int _wrap_t) :
+        mag_filter(_mag_filter), min_filter(_min_filter), wrap_s(_wrap_s), wrap_t(_wrap_t) {}
+    Sampler() {}
+    int mag_filter = GL_LINEAR;
+    int min_filter = GL_LINEAR_MIPMAP_LINEAR;
+    int wrap_s = GL_REPEAT;
+    int wrap_t = GL_REPEAT;
+};
+
+// KHR_texture_transform of a texture reference: texcoords are scaled, then
+// rotated (counter-clockwise, radians) and then offset
+struct TextureTransform {
+    float2 offset = float2(0, 0);
+    float rotation = 0;
+    float2 scale = float2(1, 1);
+};
+
+// Packed 8 bit per channel texel, same byte order as lodepng's RGBA output
+struct RGBA8 {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t a;
+};
+
+// Storage format of the 4x4 tiles of a mip level
+enum class TexelFormat {
+    // 16 RGBA8 texels, 64 bytes per tile
+    RGBA8,
+    // One BC1 block per tile, 8 bytes, opaque RGB
+    BC1,
+    // One BC3 block per tile, 16 bytes, RGB plus interpolated alpha
+    BC3
+};
+
+// One level of a mip chain. Texels are stored in 4x4 tiles (64 bytes, one
+// cache line) laid out row-major, and row-major inside each tile, so texels
+// that are close in both u and v share a cache line. Levels are padded up to
+// a multiple of 4 in each direction. Block-compressed levels store one block
+// per tile in the same order and have no directly addressable texels.
+struct MipLevel {
+    static constexpr unsigned int TILE_SIZE = 4;
+    MipLevel(unsigned int _width, unsigned int _height, TexelFormat _format = TexelFormat::RGBA8) :
+        width(_width), height(_height), format(_format),
+        tiles_x((_width + TILE_SIZE - 1)/TILE_SIZE),
+        num_texels(size_t(tiles_x)*((_height + TILE_SIZE - 1)/TILE_SIZE)*TILE_SIZE*TILE_SIZE) {
+        if (format == TexelFormat::RGBA8) {
+            texels = std::shared_ptr<RGBA8>(new RGBA8[num_texels](), std::default_delete<RGBA8[]>());
+        } else {
+            blocks = std::shared_ptr<uint8_t>(new uint8_t[memory_size()](), std::default_delete<uint8_t[]>());
+            storage_id = next_storage_id();
+        }
+    }
+    // Builds a tiled level from tightly packed row-major texels
+    MipLevel(unsigned int _width, unsigned int _height, const RGBA8 *row_major) :
+        MipLevel(_width, _height) {
+        for (unsigned int y = 0; y < height; y++) {
+            for (unsigned int x = 0; x < width; x++) {
+                at(x, y) = row_major[y*width + x];
+            }
+        }
+    }
+    // Wraps already tiled texels or blocks owned by storage (e.g. a mapped
+    // cache file). Such levels are read-only.
+    MipLevel(unsigned int _width, unsigned int _height, TexelFormat _format, const void *tiled,
+             std::shared_ptr<const void> storage) :
+        width(_width), height(_height), format(_format),
+        tiles_x((_width + TILE_SIZE - 1)/TILE_SIZE),
+        num_texels(size_t(tiles_x)*((_height + TILE_SIZE - 1)/TILE_SIZE)*TILE_SIZE*TILE_SIZE) {
+        if (format == TexelFormat::RGBA8) {
+            texels = std::shared_ptr<RGBA8>(storage, static_cast<RGBA8 *>(const_cast<void *>(tiled)));
+        } else {
+            blocks = std::shared_ptr<uint8_t>(storage, static_cast<uint8_t *>(const_cast<void *>(tiled)));
+            storage_id = next_storage_id();
+        }
+    }
+    size_t index(unsigned int x, unsigned int y) const {
+        size_t tile = (y/TILE_SIZE)*tiles_x + x/TILE_SIZE;
+        return tile*TILE_SIZE*TILE_SIZE + (y%TILE_SIZE)*TILE_SIZE + x%TILE_SIZE;
+    }
+    // Only valid for RGBA8 levels
+    const RGBA8 &at(unsigned int x, unsigned int y) const { return texels.get()[index(x, y)]; }
+    RGBA8 &at(unsigned int x, unsigned int y) { return texels.get()[index(x, y)]; }
+    static size_t block_size(TexelFormat format) {
+        switch (format) {
+            case TexelFormat::BC1: return 8;
+            case TexelFormat::BC3: return 16;
+            default: return TILE_SIZE*TILE_SIZE*sizeof(RGBA8);
+        }
+    }
+    size_t num_tiles() const { return num_texels/(TILE_SIZE*TILE_SIZE); }
+    // Texels or blocks, whichever the format uses
+    const void *data() const {
+        if (format == TexelFormat::RGBA8) {
+            return texels.get();
+        }
+        return blocks.get();
+    }
+    size_t memory_size() const { return num_tiles()*block_size(format); }
+    unsigned int width;
+    unsigned int height;
+    TexelFormat format;
+    unsigned int tiles_x;
+    // Including padding
+    size_t num_texels;
+    std::shared_ptr<RGBA8> texels;
+    std::shared_ptr<uint8_t> blocks;
+    // Identifies the block storage in the sampler's decoded tile cache. Unlike
+    // the blocks' address it is never reused after the storage is freed.
+    uint32_t storage_id = 0;
+
+    private:
+    static uint32_t next_storage_id();
+};
+
+// Box filter base level down to 1x1, returns the full chain including base.
+// sRGB levels are averaged in linear space.
+std::vector<MipLevel> GenerateMipChain(MipLevel base, bool srgb);
+
+// Decoded image with its mip chain. Images are immutable once created so they
+// can be shared between textures, materials and scenes (see AssetCache).
+struct Image {
+    Image(std::vector<MipLevel> _levels, bool _srgb = false) :
+            width(_levels[0].width), height(_levels[0].height), levels(std::move(_levels)), srgb(_srgb) {}
+    unsigned int width;
+    unsigned int height;
+    std::vector<MipLevel> levels;
+    // Texels are sRGB encoded and decoded to linear when sampled
+    bool srgb;
+    // Bytes of texel storage of all levels
+    size_t memory_size() const;
+};
+
+struct Texture;
+// Samples texture at coord with the given level of detail, relative to the
+// full mip chain. The filter is chosen from it, the level index is clamped
+// to the resident levels.
+using SampleFn = float4 (*)(const Texture &texture, const float2 &coord, float lod);
+// Returns the sampling function specialized for the sampler's wrap modes and
+// filters and for power-of-two or arbitrary image sizes
+SampleFn SelectSampleFn(const Sampler &sampler, bool power_of_two);
+// Samples the four coordinates of a 2x2 pixel quad, which share one level of detail
+using SampleQuadFn = void (*)(const Texture &texture, const float2 coords[4], float lod, float4 out[4]);
+// Like SelectSampleFn, picks a SIMD (AVX2 gather) implementation when the CPU,
+// sampler state and texel format allow it and a scalar loop otherwise
+SampleQuadFn SelectSampleQuadFn(const Sampler &sampler, bool power_of_two, TexelFormat format);
+
+// A glTF texture: an image paired with the sampler used to read it. The
+// sampling function is selected once here, so later changes to sampler have
+// no effect on this texture.
+//
+// A streamed texture (see TextureStreamer) holds only the coarse end of its
+// mip chain: image->levels[0] is level base_level of the full chain, whose
+// level 0 is width x height. Sampling records the finest level it asked for
+// in requested_level as feedback for the streamer. Images are only swapped
+// between frames, on the render thread.
+struct Texture {
+    Texture(std::shared_ptr<const Image> _image, std::shared_ptr<Sampler> _sampler) :
+            Texture(_image, _sampler, _image->width, _image->height, 0) {}
+    Texture(std::shared_ptr<const Image> _image, std::shared_ptr<Sampler> _sampler,
+            unsigned int _width, unsigned int _height, int _base_level) :
+            width(_width), height(_height), image(_image), sampler(_sampler), base_level(_base_level),
+            sample_fn(SelectSampleFn(*_sampler, is_power_of_two(width) && is_power_of_two(height))),
+            sample_quad_fn(SelectSampleQuadFn(*_sampler, is_power_of_two(width) && is_power_of_two(height),
+                                              _image->levels[0].format)) {};
+    unsigned int width;
+    unsigned int height;
+    std::shared_ptr<const Image> image;
+    std::shared_ptr<Sampler> sampler;
+    int base_level;
+    // Finest level sampled since the streamer last reset it, INT_MAX if none
+    mutable int requested_level = INT_MAX;
+    SampleFn sample_fn;
+    SampleQuadFn sample_quad_fn;
+    // Replace the resident part of the mip chain
+    void set_image(std::shared_ptr<const Image> _image, int _base_level);
+    // Sample level 0 using the magnification filter
+    float4 Sample(const float2 &coord) const;
+    // Sample with the level of detail derived from the screen-space derivatives
+    // of coord (difference to the horizontal/vertical neighbour in a 2x2 quad)
+    float4 Sample(const float2 &coord, const float2 &ddx, const float2 &ddy) const;
+    // Level of detail for the given derivatives, <= 0 means magnification
+    float ComputeLod(const float2 &ddx, const float2 &ddy) const;
+    // lod is relative to the full chain. Levels finer than base_level fall
+    // back to the finest resident one, minified with the min filter.
+    float4 SampleLevel(const float2 &coord, float lod) const {
+        record_lod(lod);
+        return sample_fn(*this, coord, lod);
+    }
+    // Batched version of Sample for the four pixels of a quad (top-left,
+    // top-right, bottom-left, bottom-right) with the quad's derivatives
+    void SampleQuad(const float2 coords[4], const float2 &ddx, const float2 &ddy, float4 out[4]) const {
+        float lod = ComputeLod(ddx, ddy);
+        record_lod(lod);
+        sample_quad_fn(*this, coords, lod, out);
+    }
+
+    private:
+    static bool is_power_of_two(unsigned int x) { return x != 0 && (x & (x - 1)) == 0; }
+    void record_lod(float lod) const {
+        // Trilinear filtering reads floor(lod) and the level after it
+        int level = (lod > 0) ? int(lod) : 0;
+        requested_level = std::min(requested_level, level);
+    }
+};
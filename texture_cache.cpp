@@ -0,0 +1,157 @@
+#include "texture_cache.h"
+#include "asset_cache.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+static const char MAGIC[8] = {'B', 'S', 'N', 'T', 'E', 'X', 0, 0};
+static const uint32_t VERSION = 2;
+// Level data is aligned so tiles start on cache lines in the mapping
+static const uint64_t ALIGNMENT = 64;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t srgb;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint32_t width;
+    uint32_t height;
+    uint32_t num_levels;
+    // Length of the key string stored after the level table
+    uint32_t key_length;
+    // TexelFormat of all levels
+    uint32_t format;
+};
+
+struct FileLevel {
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;
+};
+
+static uint64_t align(uint64_t offset) {
+    return (offset + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+TextureDiskCache::SourceStamp TextureDiskCache::stamp_file(const std::string &path) {
+    SourceStamp stamp;
+    std::error_code error;
+    stamp.size = std::filesystem::file_size(path, error);
+    if (error) {
+        return SourceStamp();
+    }
+    stamp.mtime = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+    return stamp;
+}
+
+std::string TextureDiskCache::entry_path(const std::string &key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.tex", (unsigned long long)AssetCache::hash(key.data(), key.size()));
+    return directory + "/" + name;
+}
+
+std::shared_ptr<const Image> TextureDiskCache::load(const std::string &key, const SourceStamp &stamp,
+                                                    int first_level) const {
+    std::shared_ptr<MappedFile> file = MappedFile::open(entry_path(key));
+    if (file == nullptr || file->size() < sizeof(FileHeader)) {
+        return nullptr;
+    }
+    FileHeader header;
+    memcpy(&header, file->data(), sizeof(header));
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        header.source_size != stamp.size || header.source_mtime != stamp.mtime ||
+        header.num_levels == 0 || header.format > uint32_t(TexelFormat::BC3)) {
+        return nullptr;
+    }
+    uint64_t key_offset = sizeof(FileHeader) + uint64_t(header.num_levels)*sizeof(FileLevel);
+    if (key_offset + header.key_length > file->size() ||
+        header.key_length != key.size() ||
+        memcmp(file->data() + key_offset, key.data(), key.size()) != 0) {
+        return nullptr;
+    }
+    std::vector<MipLevel> levels;
+    uint32_t first = std::min(uint32_t(std::max(first_level, 0)), header.num_levels - 1);
+    for (uint32_t i = first; i < header.num_levels; i++) {
+        FileLevel file_level;
+        memcpy(&file_level, file->data() + sizeof(FileHeader) + i*sizeof(FileLevel), sizeof(file_level));
+        MipLevel level(file_level.width, file_level.height, TexelFormat(header.format),
+                       file->data() + file_level.offset, file);
+        if (file_level.offset % ALIGNMENT != 0 || file_level.offset + level.memory_size() > file->size()) {
+            return nullptr;
+        }
+        levels.push_back(std::move(level));
+    }
+    return std::make_shared<Image>(std::move(levels), header.srgb != 0);
+}
+
+void TextureDiskCache::store(const std::string &key, const SourceStamp &stamp, const Image &image) const {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Unable to create texture cache directory " << directory << "\n";
+        return;
+    }
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.srgb = image.srgb;
+    header.source_size = stamp.size;
+    header.source_mtime = stamp.mtime;
+    header.width = image.width;
+    header.height = image.height;
+    header.num_levels = image.levels.size();
+    header.key_length = key.size();
+    header.format = uint32_t(image.levels[0].format);
+
+    std::vector<FileLevel> file_levels;
+    uint64_t offset = align(sizeof(FileHeader) + image.levels.size()*sizeof(FileLevel) + key.size());
+    for (const MipLevel &level : image.levels) {
+        FileLevel file_level;
+        file_level.width = level.width;
+        file_level.height = level.height;
+        file_level.offset = offset;
+        file_levels.push_back(file_level);
+        offset = align(offset + level.memory_size());
+    }
+
+    // Write to a temporary file and rename so concurrent readers never see
+    // a partially written entry
+    std::string path = entry_path(key);
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%zx.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+    std::string tmp_path = path + suffix;
+    {
+        std::ofstream out(tmp_path, std::ios::binary);
+        if (!out.is_open()) {
+            std::cerr << "Unable to write texture cache entry " << tmp_path << "\n";
+            return;
+        }
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(file_levels.data()), file_levels.size()*sizeof(FileLevel));
+        out.write(key.data(), key.size());
+        for (size_t i = 0; i < image.levels.size(); i++) {
+            const MipLevel &level = image.levels[i];
+            std::vector<char> padding(file_levels[i].offset - out.tellp(), 0);
+            out.write(padding.data(), padding.size());
+            out.write(static_cast<const char *>(level.data()), level.memory_size());
+        }
+        if (!out.good()) {
+            std::cerr << "Unable to write texture cache entry " << tmp_path << "\n";
+            out.close();
+            std::filesystem::remove(tmp_path, error);
+            return;
+        }
+    }
+    std::filesystem::rename(tmp_path, path, error);
+    if (error) {
+        std::filesystem::remove(tmp_path, error);
+    }
+}
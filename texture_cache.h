@@ -0,0 +1,31 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "texture.h"
+
+// Persistent cache of decoded images. Each entry is a raw file holding the
+// full tiled (or block-compressed) mip chain, keyed by the image's cache key (see AssetCache) and
+// validated against the size and modification time of its source. Entries
+// are memory mapped on load so a warm start doesn't inflate any PNGs.
+class TextureDiskCache {
+    public:
+    // Identifies the version of a source file. Embedded images have no
+    // file and use a default stamp, their key already covers the content.
+    struct SourceStamp {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+    };
+    static SourceStamp stamp_file(const std::string &path);
+
+    explicit TextureDiskCache(const std::string &_directory) : directory(_directory) {}
+    // Returns nullptr if there is no up to date entry for key. Only the
+    // levels from first_level on are returned, finer ones are not touched.
+    std::shared_ptr<const Image> load(const std::string &key, const SourceStamp &stamp, int first_level = 0) const;
+    void store(const std::string &key, const SourceStamp &stamp, const Image &image) const;
+
+    private:
+    std::string entry_path(const std::string &key) const;
+    std::string directory;
+};
@@ -0,0 +1,241 @@
+#include "texture_streamer.h"
+
+#include <algorithm>
+#include <climits>
+
+static int NumLevels(unsigned int width, unsigned int height) {
+    int num_levels = 1;
+    while (width > 1 || height > 1) {
+        width = std::max(1u, width/2);
+        height = std::max(1u, height/2);
+        num_levels++;
+    }
+    return num_levels;
+}
+
+std::shared_ptr<const Image> TextureStreamer::placeholder() {
+    static const std::shared_ptr<const Image> image = []() {
+        std::vector<MipLevel> levels;
+        levels.push_back(MipLevel(1, 1));
+        levels[0].at(0, 0) = RGBA8{128, 128, 128, 255};
+        return std::make_shared<const Image>(std::move(levels));
+    }();
+    return image;
+}
+
+void TextureStreamer::add(std::vector<std::shared_ptr<Texture>> textures, unsigned int width, unsigned int height,
+                          LoadFn load) {
+    Entry entry;
+    entry.textures = std::move(textures);
+    entry.load = std::move(load);
+    entry.width = width;
+    entry.height = height;
+    entry.num_levels = NumLevels(width, height);
+    entry.min_level = 0;
+    while (entry.min_level < entry.num_levels - 1 &&
+           std::max(width >> entry.min_level, height >> entry.min_level) > resident_size) {
+        entry.min_level++;
+    }
+    entry.resident_level = entry.num_levels;
+    for (const std::shared_ptr<Texture> &texture : entry.textures) {
+        texture->set_image(placeholder(), entry.num_levels - 1);
+    }
+    start_load(entry, entry.min_level);
+    std::lock_guard<std::mutex> lock(added_mutex);
+    added.push_back(std::move(entry));
+}
+
+void TextureStreamer::take_added() {
+    std::lock_guard<std::mutex> lock(added_mutex);
+    for (Entry &entry : added) {
+        entry.last_used = frame;
+        entries.push_back(std::move(entry));
+    }
+    added.clear();
+}
+
+size_t TextureStreamer::level_bytes(const Entry &entry, int level) const {
+    unsigned int width = std::max(1u, entry.width >> level);
+    unsigned int height = std::max(1u, entry.height >> level);
+    size_t tiles = size_t((width + MipLevel::TILE_SIZE - 1)/MipLevel::TILE_SIZE)*
+                   ((height + MipLevel::TILE_SIZE - 1)/MipLevel::TILE_SIZE);
+    // Until the first load the format is unknown, assume uncompressed
+    TexelFormat format = (entry.image != nullptr) ? entry.image->levels[0].format : TexelFormat::RGBA8;
+    return tiles*MipLevel::block_size(format);
+}
+
+size_t TextureStreamer::tail_bytes(const Entry &entry, int level) const {
+    size_t bytes = 0;
+    for (int i = level; i < entry.num_levels; i++) {
+        bytes += level_bytes(entry, i);
+    }
+    return bytes;
+}
+
+size_t TextureStreamer::entry_bytes(const Entry &entry) const {
+    size_t bytes = (entry.image != nullptr) ? entry.image->memory_size() : 0;
+    if (entry.source != nullptr) {
+        for (int level = entry.source_level; level < entry.resident_level; level++) {
+            bytes += entry.source->levels[level - entry.source_level].memory_size();
+        }
+    }
+    return bytes;
+}
+
+void TextureStreamer::install(Entry &entry, std::shared_ptr<const Image> loaded, int level) {
+    // loaded ends with the coarsest level, the levels it starts with may be
+    // finer than the ones asked for
+    int loaded_level = std::max(0, entry.num_levels - int(loaded->levels.size()));
+    int first = std::min(std::max(level - loaded_level, 0), int(loaded->levels.size()) - 1);
+    level = loaded_level + first;
+    std::vector<MipLevel> levels(loaded->levels.begin() + first, loaded->levels.end());
+    entry.image = std::make_shared<Image>(std::move(levels), loaded->srgb);
+    entry.resident_level = level;
+    entry.source = (loaded_level < level) ? loaded : nullptr;
+    entry.source_level = loaded_level;
+    for (const std::shared_ptr<Texture> &texture : entry.textures) {
+        texture->set_image(entry.image, level);
+    }
+}
+
+void TextureStreamer::start_load(Entry &entry, int level) {
+    LoadFn load = entry.load;
+    entry.pending = pool.submit([load, level]() { return load(level); });
+    entry.pending_level = level;
+}
+
+void TextureStreamer::evict_level(Entry &entry) {
+    // Loaded levels that were never installed go first
+    if (entry.source != nullptr) {
+        entry.source = nullptr;
+        return;
+    }
+    // Levels of the current image are shared, dropping the first one only
+    // releases its storage
+    std::vector<MipLevel> levels(entry.image->levels.begin() + 1, entry.image->levels.end());
+    entry.image = std::make_shared<Image>(std::move(levels), entry.image->srgb);
+    entry.resident_level++;
+    for (const std::shared_ptr<Texture> &texture : entry.textures) {
+        texture->set_image(entry.image, entry.resident_level);
+    }
+}
+
+size_t TextureStreamer::resident_bytes() const {
+    size_t bytes = 0;
+    for (const Entry &entry : entries) {
+        bytes += entry_bytes(entry);
+    }
+    return bytes;
+}
+
+void TextureStreamer::update() {
+    frame++;
+    take_added();
+
+    // Install finished loads, only the levels that were asked for are used
+    for (Entry &entry : entries) {
+        if (entry.pending.valid() &&
+            entry.pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            std::shared_ptr<const Image> loaded = pool.wait_or_exit(entry.pending);
+            if (entry.pending_level < entry.resident_level) {
+                install(entry, loaded, entry.pending_level);
+            }
+            entry.pending_level = -1;
+        }
+    }
+
+    // Collect feedback from the last frame
+    std::vector<std::pair<Entry *, int>> requests;
+    for (Entry &entry : entries) {
+        int requested = INT_MAX;
+        for (const std::shared_ptr<Texture> &texture : entry.textures) {
+            requested = std::min(requested, texture->requested_level);
+            texture->requested_level = INT_MAX;
+        }
+        // Loaded levels are only kept while finer ones are still wanted
+        if (requested >= entry.resident_level) {
+            entry.source = nullptr;
+        }
+        if (requested == INT_MAX) {
+            continue;
+        }
+        entry.last_used = frame;
+        if (requested < entry.resident_level && entry.image != nullptr && !entry.pending.valid()) {
+            requests.push_back(std::make_pair(&entry, requested));
+        }
+    }
+
+    // Least recently used first, larger levels first among equally old ones
+    auto pick_victim = [this](bool only_unused) -> Entry * {
+        Entry *victim = nullptr;
+        for (Entry &entry : entries) {
+            if (entry.image == nullptr || (entry.resident_level >= entry.min_level && entry.source == nullptr) ||
+                (only_unused && entry.last_used == frame)) {
+                continue;
+            }
+            if (victim == nullptr || entry.last_used < victim->last_used ||
+                (entry.last_used == victim->last_used &&
+                 level_bytes(entry, entry.resident_level) > level_bytes(*victim, victim->resident_level))) {
+                victim = &entry;
+            }
+        }
+        return victim;
+    };
+
+    auto evict = [this](Entry &victim) {
+        size_t bytes = entry_bytes(victim);
+        evict_level(victim);
+        return bytes - entry_bytes(victim);
+    };
+    size_t resident = resident_bytes();
+    while (resident > budget) {
+        Entry *victim = pick_victim(false);
+        if (victim == nullptr) {
+            break;
+        }
+        resident -= evict(*victim);
+    }
+
+    // Start loads for finer levels. Room is only made by evicting textures
+    // that were not sampled in the last frame, so two visible textures never
+    // keep evicting each other. If the requested level doesn't fit, the
+    // finest one that does is loaded instead.
+    size_t in_flight = 0;
+    for (const std::pair<Entry *, int> &request : requests) {
+        Entry &entry = *request.first;
+        // Levels already loaded, and counted as resident, need no load
+        if (entry.source != nullptr) {
+            install(entry, entry.source, std::max(request.second, entry.source_level));
+            continue;
+        }
+        size_t needed = tail_bytes(entry, request.second) - tail_bytes(entry, entry.resident_level);
+        while (resident + in_flight + needed > budget) {
+            Entry *victim = pick_victim(true);
+            if (victim == nullptr) {
+                break;
+            }
+            resident -= evict(*victim);
+        }
+        for (int level = request.second; level < entry.resident_level; level++) {
+            needed = tail_bytes(entry, level) - tail_bytes(entry, entry.resident_level);
+            if (resident + in_flight + needed <= budget) {
+                start_load(entry, level);
+                in_flight += needed;
+                break;
+            }
+        }
+    }
+}
+
+void TextureStreamer::flush() {
+    take_added();
+    for (Entry &entry : entries) {
+        if (entry.pending.valid()) {
+            std::shared_ptr<const Image> loaded = pool.wait_or_exit(entry.pending);
+            if (entry.pending_level < entry.resident_level) {
+                install(entry, loaded, entry.pending_level);
+            }
+            entry.pending_level = -1;
+        }
+    }
+}
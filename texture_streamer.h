@@ -0,0 +1,92 @@
+#pragma once
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "texture.h"
+#include "thread_pool.h"
+
+// Keeps the mip chains of streamed textures partially resident. Textures
+// start with the coarse levels (up to resident_size texels on a side) and
+// finer levels are loaded on the thread pool once sampling feedback shows
+// they are needed. When resident levels exceed the budget the finest levels
+// of the least recently sampled textures are dropped again.
+//
+// update() must be called between frames on the render thread; it is the
+// only place textures change. add() may be called from any thread, e.g. by
+// a scene loading in the background, its textures take part from the next
+// update() on.
+class TextureStreamer {
+    public:
+    // Loads the mip chain of an image from first_level on, runs on the
+    // thread pool. It may return finer levels as well if it had to produce
+    // them anyway (e.g. by decoding the whole chain). Those are kept, and
+    // counted as resident, while sampling asks for finer levels than are
+    // installed, so they are not loaded again one level at a time. A load
+    // that fails throws, update() or flush() report it and exit.
+    using LoadFn = std::function<std::shared_ptr<const Image>(int first_level)>;
+
+    explicit TextureStreamer(size_t _budget, unsigned int _resident_size = 64,
+                             ThreadPool &_pool = ThreadPool::shared()) :
+        budget(_budget), resident_size(_resident_size), pool(_pool) {}
+    TextureStreamer(const TextureStreamer &) = delete;
+    TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+    // 1x1 grey image for textures whose coarse levels are still loading
+    static std::shared_ptr<const Image> placeholder();
+
+    // Stream the image shared by textures, whose level 0 is width x height.
+    // The textures show placeholder() until the coarse levels are loaded.
+    void add(std::vector<std::shared_ptr<Texture>> textures, unsigned int width, unsigned int height, LoadFn load);
+    // Read feedback, install finished loads, start new ones and evict
+    void update();
+    // Block until all loads have finished and install them
+    void flush();
+
+    // Bytes of texel storage of all resident levels
+    size_t resident_bytes() const;
+    size_t budget;
+
+    private:
+    struct Entry {
+        std::vector<std::shared_ptr<Texture>> textures;
+        LoadFn load;
+        unsigned int width;
+        unsigned int height;
+        int num_levels;
+        // Coarsest level that is always kept resident
+        int min_level;
+        // Level the real image starts at, num_levels while only the
+        // placeholder is resident
+        int resident_level;
+        std::shared_ptr<const Image> image;
+        // Last load, if it returned levels finer than resident_level.
+        // Its levels start at source_level.
+        std::shared_ptr<const Image> source;
+        int source_level = 0;
+        std::future<std::shared_ptr<const Image>> pending;
+        int pending_level = -1;
+        uint64_t last_used = 0;
+    };
+
+    size_t level_bytes(const Entry &entry, int level) const;
+    size_t tail_bytes(const Entry &entry, int level) const;
+    // Bytes of the resident levels and of the loaded ones not installed yet
+    size_t entry_bytes(const Entry &entry) const;
+    void install(Entry &entry, std::shared_ptr<const Image> loaded, int level);
+    void start_load(Entry &entry, int level);
+    void evict_level(Entry &entry);
+    // Move the entries added since the last call to entries
+    void take_added();
+
+    unsigned int resident_size;
+    ThreadPool &pool;
+    std::vector<Entry> entries;
+    std::mutex added_mutex;
+    // Guarded by added_mutex
+    std::vector<Entry> added;
+    uint64_t frame = 0;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed size pool of worker threads running queued tasks in FIFO order
+class ThreadPool {
+    public:
+    explicit ThreadPool(unsigned int num_threads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Process-wide pool with one worker per hardware thread
+    static ThreadPool &shared();
+
+    template <typename F>
+    auto submit(F f) -> std::future<decltype(f())> {
+        using R = decltype(f());
+        auto task = std::make_shared<std::packaged_task<R()>>(std::move(f));
+        std::future<R> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back([task]() { (*task)(); });
+        }
+        cv.notify_one();
+        return result;
+    }
+
+    // Wait for a task submitted to this pool. Queued tasks are run on the
+    // calling thread while waiting, so tasks may wait on other tasks
+    // without starving the pool.
+    template <typename T>
+    T wait(std::future<T> &future) {
+        while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if (!run_one()) {
+                future.wait_for(std::chrono::milliseconds(1));
+            }
+        }
+        return future.get();
+    }
+
+    // wait() for a task that reports failure by throwing. The error is
+    // printed and the process exits on the calling thread. Tasks must not
+    // exit() themselves, on a worker that destroys the pool from one of its
+    // own threads.
+    template <typename T>
+    T wait_or_exit(std::future<T> &future) {
+        try {
+            return wait(future);
+        } catch (const std::exception &error) {
+            std::cerr << error.what() << "\n";
+            exit(-1);
+        }
+    }
+
+    // Run one queued task on the calling thread, false if the queue is empty
+    bool run_one();
+
+    unsigned int size() const { return workers.size(); }
+
+    private:
+    void worker_loop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stop = false;
+};
@@ -0,0 +1,43 @@
+#include "uri.h"
+
+#include <iostream>
+
+bool is_data_uri(const std::string &uri) {
+    return uri.compare(0, 5, "data:") == 0;
+}
+
+static int base64_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+std::vector<unsigned char> decode_data_uri(const std::string &uri) {
+    size_t comma = uri.find(',');
+    if (!is_data_uri(uri) || comma == std::string::npos || comma < 7 ||
+        uri.compare(comma - 7, 7, ";base64") != 0) {
+        std::cerr << "Unsupported data URI " << uri.substr(0, 64) << "\n";
+        exit(-1);
+    }
+    std::vector<unsigned char> bytes;
+    bytes.reserve((uri.size() - comma)/4*3);
+    unsigned int bits = 0;
+    int num_bits = 0;
+    for (size_t i = comma + 1; i < uri.size(); i++) {
+        int value = base64_value(uri[i]);
+        if (value < 0) {
+            // Padding ('=') or whitespace
+            continue;
+        }
+        bits = (bits << 6) | value;
+        num_bits += 6;
+        if (num_bits >= 8) {
+            num_bits -= 8;
+            bytes.push_back((bits >> num_bits) & 0xff);
+        }
+    }
+    return bytes;
+}
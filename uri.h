@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// glTF buffers and images can embed their payload as a base64 data URI
+// ("data:application/octet-stream;base64,....") instead of a relative path
+bool is_data_uri(const std::string &uri);
+// Decodes the payload of a base64 data URI
+std::vector<unsigned char> decode_data_uri(const std::string &uri);
@@ -1,5 +1,6 @@
 #pragma once
 #include <stdlib.h>
+#include <mutex>
 
 struct EventRecord {
     EventRecord() : left(0), right(0), up(0), down(0) {}
@@ -14,6 +15,7 @@ class Window {
 public:
     Window(int _width, int _height) : width(_width), height(_height) {
         surface = (unsigned char *)malloc(width*height*4);
+        back_surface = (unsigned char *)malloc(width*height*4);
     };
     
     // Create the window
@@ -26,7 +28,11 @@ public:
     EventRecord process_events();
     // Check if window was closed
     //bool is_window_closed();
-    // Sets flags required to tell NSView that framebuffer is ready to be displayed
+    // Makes back_surface, into which a finished frame was written, the
+    // surface the view displays. Safe to call from a present thread.
+    void swap_surfaces();
+    // Sets flags required to tell NSView that framebuffer is ready to be displayed,
+    // if a new surface was swapped in since the last call
     void present();
     // Boolean indicating if window should close.
     bool should_close = false;
@@ -36,5 +42,10 @@ public:
     int width;
     int height;
     EventRecord record;
+    // Displayed by the view, which reads it while holding surface_mutex
     unsigned char *surface;
+    // Written by whoever presents frames, the view never reads it
+    unsigned char *back_surface;
+    std::mutex surface_mutex;
+    bool surface_changed = false;
 };
\ No newline at end of file